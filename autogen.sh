@@ -13,3 +13,12 @@ fi
 which autoreconf >/dev/null || \
   (echo "configuration failed, please install autoconf first" && exit 1)
 autoreconf --install --force --warnings=all
+
+# Changes to the EVM library that are not in the submodule commit yet, see contrib/cpp-ethereum-fab
+if [ -e src/cpp-ethereum-fab/.git ]; then
+  for patch in "$PWD"/contrib/cpp-ethereum-fab/patches/*.patch; do
+    git -C src/cpp-ethereum-fab apply --reverse --check "$patch" 2>/dev/null && continue
+    echo "Applying $(basename "$patch") to src/cpp-ethereum-fab"
+    git -C src/cpp-ethereum-fab apply "$patch"
+  done
+fi
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 
+#include <chainparams.h>
 #include <crypto/sha256.h>
 #include <key.h>
 #include <validation.h>
@@ -51,6 +52,7 @@ main(int argc, char** argv)
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::MAIN); // benchmarks needing another chain select it, then restore this one
 
     int64_t evaluations = gArgs.GetArg("-evals", DEFAULT_BENCH_EVALUATIONS);
     std::string regex_filter = gArgs.GetArg("-filter", DEFAULT_BENCH_FILTER);
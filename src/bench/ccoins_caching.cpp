@@ -5,8 +5,10 @@
 #include <bench/bench.h>
 #include <coins.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <wallet/crypter.h>
 
+#include <iostream>
 #include <vector>
 
 void avoidCompilerWarningsDefinedButNotUsedCCoinsCaching() {
@@ -89,3 +91,40 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// Lookups of random outpoints in a cache of COINS_CACHE_LOOKUP_SIZE coins, one per
+// iteration: the iteration time gives the lookups per second. The bytes per cached coin,
+// CCoinsViewCache::DynamicMemoryUsage() over the number of coins, go to stderr.
+static const uint32_t COINS_CACHE_LOOKUP_SIZE = 1000 * 1000;
+
+static void CCoinsCacheLookup(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    FastRandomContext rng(true);
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(COINS_CACHE_LOOKUP_SIZE);
+    for (uint32_t i = 0; i < COINS_CACHE_LOOKUP_SIZE; i++) {
+        COutPoint outpoint(rng.rand256(), rng.randrange(4));
+        std::vector<unsigned char> keyid = rng.randbytes(20);
+        CTxOut txout(rng.randrange(50 * COIN), CScript() << OP_DUP << OP_HASH160 << keyid << OP_EQUALVERIFY << OP_CHECKSIG);
+        coins.AddCoin(outpoint, Coin(std::move(txout), 1, false), false);
+        outpoints.push_back(outpoint);
+    }
+
+    static bool fReported = false;
+    if (!fReported) {
+        std::cerr << "CCoinsCacheLookup: " << coins.GetCacheSize() << " coins, "
+                  << (double)coins.DynamicMemoryUsage() / coins.GetCacheSize() << " bytes per coin" << std::endl;
+        fReported = true;
+    }
+
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        const Coin& coin = coins.AccessCoin(outpoints[n]);
+        assert(!coin.IsSpent());
+        n = (n + 7919) % COINS_CACHE_LOOKUP_SIZE;
+    }
+}
+
+BENCHMARK(CCoinsCacheLookup, 5 * 1000 * 1000);
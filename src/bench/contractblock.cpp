@@ -0,0 +1,360 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <arith_uint256.h>
+#include <chainparams.h>
+#include <consensus/consensus.h>
+#include <consensus/validation.h>
+#include <crypto/ripemd160.h>
+#include <crypto/sha256.h>
+#include <fs.h>
+#include <key.h>
+#include <miner.h>
+#include <pow.h>
+#include <random.h>
+#include <scheduler.h>
+#include <script/standard.h>
+#include <script/sigcache.h>
+#include <streams.h>
+#include <txdb.h>
+#include <txmempool.h>
+#include <utilstrencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <libethashseal/GenesisInfo.h>
+#include <libethereum/ChainParams.h>
+
+void avoidCompilerWarningsDefinedButNotUsedContractBlock() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+// Benchmarks of the consensus path on Fabcoin blocks: a regtest chain is mined on first
+// use, and the block under test carries contract creations and calls executed by the EVM.
+
+namespace {
+
+/*
+    contract Factory {
+        bytes32[] Names;
+        address[] newContracts;
+
+        function createContract (bytes32 name) {
+            address newContract = new Contract(name);
+            newContracts.push(newContract);
+        }
+        ...
+    }
+    (the same contract as in fasctests/bytecodeexec_tests.cpp)
+*/
+const char* FACTORY_CODE = "606060405234610000575b61034a806100196000396000f30060606040526000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680633f811b80146100495780636b8ff5741461006a575b610000565b3461000057610068600480803560001916906020019091905050610087565b005b3461000057610085600480803590602001909190505061015b565b005b60008160405160e18061023e833901808260001916600019168152602001915050604051809103906000f08015610000579050600180548060010182818154818355818115116101035781836000526020600020918201910161010291905b808211156100fe5760008160009055506001016100e6565b5090565b5b505050916000526020600020900160005b83909190916101000a81548173ffffffffffffffffffffffffffffffffffffffff021916908373ffffffffffffffffffffffffffffffffffffffff160217905550505b5050565b6000600182815481101561000057906000526020600020900160005b9054906101000a900473ffffffffffffffffffffffffffffffffffffffff1690508073ffffffffffffffffffffffffffffffffffffffff16638052474d6000604051602001526040518163ffffffff167c0100000000000000000000000000000000000000000000000000000000028152600401809050602060405180830381600087803b156100005760325a03f1156100005750505060405180519050600083815481101561000057906000526020600020900160005b5081600019169055505b50505600606060405234610000576040516020806100e1833981016040528080519060200190919050505b80600081600019169055505b505b609f806100426000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680638052474d146045575b60435b5b565b005b34600057604f606d565b60405180826000191660001916815260200191505060405180910390f35b600054815600a165627a7a72305820fe28ec2b77f3b306095bda73561b85d147a1026db2e5714aeeb2f29246cffcbb0029a165627a7a7230582086cf938db13cf2aa8bca8ad6e720861683ef2cc971ad66dad68708438a5e4a9b0029";
+const char* FACTORY_CREATE_CONTRACT = "3f811b80";
+/*
+    contract Temp {
+        function () payable {}
+    }
+*/
+const char* TEMP_CODE = "6060604052346000575b60398060166000396000f30060606040525b600b5b5b565b0000a165627a7a723058209cedb722bf57a30e3eb00eeefc392103ea791a2001deed29f5c3809ff10eb1dd0029";
+
+const int64_t GAS_LIMIT = 500000;
+const int64_t GAS_PRICE = 40;
+const int CONTRACT_CALLS = 20;
+const int CONTRACT_CREATES = 2;
+const int PAYMENTS = 8;
+
+class ContractChainFixture
+{
+public:
+    static ContractChainFixture& Get()
+    {
+        static ContractChainFixture fixture;
+        return fixture;
+    }
+
+    std::vector<unsigned char> serializedBlock; //<- contract block on top of the tip, not connected
+    std::unique_ptr<const CChainParams> mainParams;
+
+private:
+    ContractChainFixture();
+    ~ContractChainFixture();
+
+    CBlock MineBlock();
+    void ConnectBlock(const CBlock& block);
+    void AddToMempool(const CMutableTransaction& tx);
+    CMutableTransaction SpendCoinbase(size_t index, const std::vector<CTxOut>& outputs, CAmount gasFee);
+    static CScript ContractOutputScript(const std::string& data, opcodetype opcode, const std::vector<unsigned char>& address = std::vector<unsigned char>());
+
+    // The chain, databases and contract state in place before the fixture, put back by its destructor
+    std::string prevNetwork;
+    std::string prevDataDir;
+    CBlockTreeDB* prevBlockTree;
+    CCoinsViewDB* prevCoinsDBView;
+    CCoinsViewCache* prevCoinsTip;
+    std::unique_ptr<FascState> prevGlobalState;
+    std::shared_ptr<dev::eth::SealEngineFace> prevSealEngine;
+    StorageResults* prevStorageResult;
+
+    CScheduler scheduler;
+    fs::path pathTemp;
+    CKey key;
+    CScript scriptPubKey;
+    std::vector<CTransactionRef> coinbases;
+};
+
+ContractChainFixture::ContractChainFixture() :
+    prevNetwork(Params().NetworkIDString()),
+    prevDataDir(gArgs.GetArg("-datadir", "")),
+    prevBlockTree(pblocktree),
+    prevCoinsDBView(pcoinsdbview),
+    prevCoinsTip(pcoinsTip),
+    prevGlobalState(std::move(globalState)),
+    prevSealEngine(std::move(globalSealEngine)),
+    prevStorageResult(pstorageresult)
+{
+    InitSignatureCache();
+    InitScriptExecutionCache();
+    SelectParams(CBaseChainParams::UNITTEST);
+    const CChainParams& chainparams = Params();
+    mainParams = CreateChainParams(CBaseChainParams::MAIN);
+
+    ClearDatadirCache();
+    pathTemp = fs::temp_directory_path() / strprintf("bench_fabcoin_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+    fs::create_directories(pathTemp);
+    gArgs.ForceSetArg("-datadir", pathTemp.string());
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+
+    dev::eth::NoProof::init();
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    globalState = std::unique_ptr<FascState>(new FascState(dev::u256(0), FascState::openDB(pathTemp.string(), hashDB, dev::WithExisting::Trust), pathTemp.string(), dev::eth::BaseState::Empty));
+    dev::eth::ChainParams cp(chainparams.EVMGenesisInfo());
+    cp.EIP150ForkBlock = 0xffffffffffffffff;
+    cp.EIP158ForkBlock = 0xffffffffffffffff;
+    cp.byzantiumForkBlock = 0xffffffffffffffff;
+    cp.constantinopleForkBlock = 0xffffffffffffffff;
+    cp.constantinopleFixForkBlock = 0xffffffffffffffff;
+    globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
+    globalState->populateFrom(cp.genesisState);
+    globalState->setRootUTXO(uintToh256(chainparams.GenesisBlock().hashUTXORoot));
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+    pstorageresult = new StorageResults(pathTemp.string());
+
+    if (!LoadGenesisBlock(chainparams)) {
+        throw std::runtime_error("LoadGenesisBlock failed.");
+    }
+    CValidationState state;
+    if (!ActivateBestChain(state, chainparams)) {
+        throw std::runtime_error("ActivateBestChain failed.");
+    }
+
+    key.MakeNewKey(true);
+    scriptPubKey = CScript() << ToByteVector(key.GetPubKey()) << OP_CHECKSIG;
+    const int spendable = 1 + CONTRACT_CALLS + CONTRACT_CREATES + PAYMENTS;
+    for (int i = 0; i < COINBASE_MATURITY + spendable; i++) {
+        CBlock block = MineBlock();
+        ConnectBlock(block);
+        coinbases.push_back(block.vtx[0]);
+    }
+
+    // Deploy the factory in a block of its own, then fill the mempool with calls to it,
+    // new contracts and plain payments, and let the BlockAssembler execute them into the
+    // block under test.
+    size_t nextCoinbase = 0;
+    CMutableTransaction deploy = SpendCoinbase(nextCoinbase++, {CTxOut(0, ContractOutputScript(FACTORY_CODE, OP_CREATE))}, GAS_LIMIT * GAS_PRICE);
+    AddToMempool(deploy);
+    ConnectBlock(MineBlock());
+
+    std::vector<unsigned char> factoryAddress(20);
+    {
+        uint256 hashDeploy = deploy.GetHash();
+        std::vector<unsigned char> txIdAndVout(hashDeploy.begin(), hashDeploy.end());
+        txIdAndVout.resize(txIdAndVout.size() + sizeof(uint32_t), 0); // nVout 0
+        std::vector<unsigned char> sha256TxVout(CSHA256::OUTPUT_SIZE);
+        CSHA256().Write(txIdAndVout.data(), txIdAndVout.size()).Finalize(sha256TxVout.data());
+        CRIPEMD160().Write(sha256TxVout.data(), sha256TxVout.size()).Finalize(factoryAddress.data());
+    }
+    for (int i = 0; i < CONTRACT_CALLS; i++) {
+        AddToMempool(SpendCoinbase(nextCoinbase++, {CTxOut(0, ContractOutputScript(FACTORY_CREATE_CONTRACT, OP_CALL, factoryAddress))}, GAS_LIMIT * GAS_PRICE));
+    }
+    for (int i = 0; i < CONTRACT_CREATES; i++) {
+        AddToMempool(SpendCoinbase(nextCoinbase++, {CTxOut(0, ContractOutputScript(TEMP_CODE, OP_CREATE))}, GAS_LIMIT * GAS_PRICE));
+    }
+    for (int i = 0; i < PAYMENTS; i++) {
+        CKey payee;
+        payee.MakeNewKey(true);
+        AddToMempool(SpendCoinbase(nextCoinbase++, {CTxOut(COIN, GetScriptForDestination(payee.GetPubKey().GetID()))}, 0));
+    }
+
+    CBlock block = MineBlock();
+    assert(block.vtx.size() > (size_t) (CONTRACT_CALLS + CONTRACT_CREATES + PAYMENTS));
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block;
+    serializedBlock.assign(stream.begin(), stream.end());
+}
+
+ContractChainFixture::~ContractChainFixture()
+{
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    mempool.clear();
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    delete pcoinsdbview;
+    delete pblocktree;
+    delete pstorageresult;
+    globalState.reset();
+    globalSealEngine.reset();
+    fs::remove_all(pathTemp);
+
+    pblocktree = prevBlockTree;
+    pcoinsdbview = prevCoinsDBView;
+    pcoinsTip = prevCoinsTip;
+    globalState = std::move(prevGlobalState);
+    globalSealEngine = std::move(prevSealEngine);
+    pstorageresult = prevStorageResult;
+    if (!prevDataDir.empty())
+        gArgs.ForceSetArg("-datadir", prevDataDir);
+    ClearDatadirCache();
+    SelectParams(prevNetwork);
+}
+
+CBlock ContractChainFixture::MineBlock()
+{
+    std::stringstream* commentsOnFailure = nullptr;
+    std::unique_ptr<CBlockTemplate> pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptPubKey, commentsOnFailure);
+    CBlock block = pblocktemplate->block;
+    unsigned int extraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, false, Params().GetConsensus()))
+        block.nNonce = ArithToUint256(UintToArith256(block.nNonce) + 1);
+    return block;
+}
+
+void ContractChainFixture::ConnectBlock(const CBlock& block)
+{
+    ProcessNewBlock(Params(), std::make_shared<const CBlock>(block), true, nullptr);
+    assert(chainActive.Tip()->GetBlockHash() == block.GetHash());
+}
+
+void ContractChainFixture::AddToMempool(const CMutableTransaction& tx)
+{
+    LOCK(cs_main);
+    CValidationState state;
+    bool accepted = AcceptToMemoryPool(mempool, state, MakeTransactionRef(tx), false, nullptr);
+    assert(accepted);
+}
+
+CMutableTransaction ContractChainFixture::SpendCoinbase(size_t index, const std::vector<CTxOut>& outputs, CAmount gasFee)
+{
+    const CTransactionRef& coinbase = coinbases[index];
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(coinbase->GetHash(), 0);
+    tx.vout = outputs;
+    CAmount change = coinbase->vout[0].nValue - gasFee - COIN / 100;
+    for (const CTxOut& out : outputs)
+        change -= out.nValue;
+    tx.vout.push_back(CTxOut(change, scriptPubKey));
+
+    uint256 hash = SignatureHash(coinbase->vout[0].scriptPubKey, tx, 0, SIGHASH_ALL, coinbase->vout[0].nValue, SIGVERSION_BASE);
+    std::vector<unsigned char> vchSig;
+    bool signedOk = key.Sign(hash, vchSig);
+    assert(signedOk);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig = CScript() << vchSig;
+    return tx;
+}
+
+CScript ContractChainFixture::ContractOutputScript(const std::string& data, opcodetype opcode, const std::vector<unsigned char>& address)
+{
+    CScript script = CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(GAS_LIMIT) << CScriptNum(GAS_PRICE) << ParseHex(data);
+    if (opcode == OP_CALL)
+        script << address;
+    return script << opcode;
+}
+
+CDataStream BlockStream(const ContractChainFixture& fixture)
+{
+    CDataStream stream((const char*)fixture.serializedBlock.data(),
+            (const char*)fixture.serializedBlock.data() + fixture.serializedBlock.size(),
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+    return stream;
+}
+
+} // namespace
+
+static void DeserializeContractBlock(benchmark::State& state)
+{
+    const ContractChainFixture& fixture = ContractChainFixture::Get();
+    CDataStream stream = BlockStream(fixture);
+
+    while (state.KeepRunning()) {
+        CBlock block;
+        stream >> block;
+        assert(stream.Rewind(fixture.serializedBlock.size()));
+    }
+}
+
+static void DeserializeAndCheckContractBlock(benchmark::State& state)
+{
+    const ContractChainFixture& fixture = ContractChainFixture::Get();
+    CDataStream stream = BlockStream(fixture);
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    while (state.KeepRunning()) {
+        CBlock block; // Note that CBlock caches its checked state, so we need to recreate it here
+        stream >> block;
+        assert(stream.Rewind(fixture.serializedBlock.size()));
+
+        CValidationState validationState;
+        bool checked = CheckBlock(block, validationState, consensusParams);
+        assert(checked);
+    }
+}
+
+static void CheckEquihashSolutionGenesis(benchmark::State& state)
+{
+    // Regtest chains don't use Equihash; the main network genesis block carries a real solution.
+    const ContractChainFixture& fixture = ContractChainFixture::Get();
+    const CBlock& genesis = fixture.mainParams->GenesisBlock();
+    assert(CheckEquihashSolution(&genesis, *fixture.mainParams));
+
+    while (state.KeepRunning()) {
+        CheckEquihashSolution(&genesis, *fixture.mainParams);
+    }
+}
+
+static void ConnectContractBlock(benchmark::State& state)
+{
+    const ContractChainFixture& fixture = ContractChainFixture::Get();
+    CDataStream stream = BlockStream(fixture);
+    CBlock block;
+    stream >> block;
+
+    LOCK(cs_main);
+    dev::h256 hashStateRoot(globalState->rootHash());
+    dev::h256 hashUTXORoot(globalState->rootHashUTXO());
+    while (state.KeepRunning()) {
+        // Runs ConnectBlock on a throwaway view, executing every contract of the block.
+        CValidationState validationState;
+        bool valid = TestBlockValidity(validationState, Params(), block, chainActive.Tip(), false, true);
+        assert(valid);
+        globalState->setRoot(hashStateRoot);
+        globalState->setRootUTXO(hashUTXORoot);
+        pstorageresult->clearCacheResult();
+    }
+}
+
+BENCHMARK(DeserializeContractBlock, 2500);
+BENCHMARK(DeserializeAndCheckContractBlock, 1000);
+BENCHMARK(CheckEquihashSolutionGenesis, 100);
+BENCHMARK(ConnectContractBlock, 20);
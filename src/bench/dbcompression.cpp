@@ -0,0 +1,102 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/fabcoin-config.h>
+#endif
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <fs.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <vector>
+
+// Each iteration writes or reads one record shaped like a serialized receipt: DB_RECORD_SIZE
+// bytes of addresses, topics and mostly zero words. The iteration time gives the throughput.
+static const size_t DB_RECORD_SIZE = 256;
+static const int DB_RECORDS = 100 * 1000;
+// A cache small enough that reads decompress and verify the checksums of their blocks.
+static const size_t DB_BENCH_CACHE = 1 << 20;
+
+static std::vector<unsigned char> ReceiptLikeRecord(FastRandomContext& rng)
+{
+    std::vector<unsigned char> record(DB_RECORD_SIZE);
+    // The contract and topic come from a handful, the data words are small numbers.
+    const uint32_t contract = rng.randrange(16);
+    for (size_t i = 0; i < 20; i++)
+        record[i] = (unsigned char)(contract * 131 + i);
+    const uint32_t topic = rng.randrange(8);
+    for (size_t i = 20; i < 52; i++)
+        record[i] = (unsigned char)(topic * 17 + i);
+    for (size_t i = DB_RECORD_SIZE - 1; i >= 52; i -= 32)
+        record[i] = (unsigned char)rng.randbits(8);
+    return record;
+}
+
+static uint256 RecordKey(int n)
+{
+    uint256 key;
+    *(int*)key.begin() = n;
+    return key;
+}
+
+static void DBWrite(benchmark::State& state, leveldb::CompressionType compression)
+{
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    {
+        CDBWrapper db(path, DB_BENCH_CACHE, false, true, false, compression);
+        FastRandomContext rng(true);
+        std::vector<unsigned char> record = ReceiptLikeRecord(rng);
+        int n = 0;
+        while (state.KeepRunning()) {
+            record[0] = (unsigned char)n;
+            db.Write(RecordKey(n++), record);
+        }
+    }
+    fs::remove_all(path);
+}
+
+static void DBRead(benchmark::State& state, leveldb::CompressionType compression)
+{
+    fs::path path = fs::temp_directory_path() / fs::unique_path();
+    {
+        CDBWrapper db(path, DB_BENCH_CACHE, false, true, false, compression);
+        FastRandomContext rng(true);
+        CDBBatch batch(db);
+        for (int n = 0; n < DB_RECORDS; n++)
+            batch.Write(RecordKey(n), ReceiptLikeRecord(rng));
+        db.WriteBatch(batch, true);
+        // Move everything to compressed tables
+        db.CompactRange(RecordKey(0), RecordKey(DB_RECORDS));
+
+        std::vector<unsigned char> record;
+        while (state.KeepRunning()) {
+            bool fFound = db.Read(RecordKey(rng.randrange(DB_RECORDS)), record);
+            assert(fFound);
+        }
+    }
+    fs::remove_all(path);
+}
+
+static void DBWriteNone(benchmark::State& state) { DBWrite(state, leveldb::kNoCompression); }
+static void DBReadNone(benchmark::State& state) { DBRead(state, leveldb::kNoCompression); }
+BENCHMARK(DBWriteNone, 200 * 1000);
+BENCHMARK(DBReadNone, 200 * 1000);
+
+#ifdef USE_SNAPPY
+static void DBWriteSnappy(benchmark::State& state) { DBWrite(state, leveldb::kSnappyCompression); }
+static void DBReadSnappy(benchmark::State& state) { DBRead(state, leveldb::kSnappyCompression); }
+BENCHMARK(DBWriteSnappy, 200 * 1000);
+BENCHMARK(DBReadSnappy, 200 * 1000);
+#endif
+
+#ifdef USE_ZSTD
+static void DBWriteZstd(benchmark::State& state) { DBWrite(state, leveldb::kZstdCompression); }
+static void DBReadZstd(benchmark::State& state) { DBRead(state, leveldb::kZstdCompression); }
+BENCHMARK(DBWriteZstd, 200 * 1000);
+BENCHMARK(DBReadZstd, 200 * 1000);
+#endif
@@ -0,0 +1,47 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/SHA3.h>
+#include <libethereum/State.h>
+
+// Storage writes of a block calling many SSTORE-heavy contracts: each account gets a fresh storage trie.
+static dev::eth::AccountMap SyntheticStorageWrites(unsigned accounts, unsigned slots)
+{
+    dev::eth::AccountMap cache;
+    for (unsigned i = 0; i < accounts; i++) {
+        dev::eth::Account& account = cache[dev::right160(dev::sha3(dev::h256(i)))];
+        account = dev::eth::Account(dev::u256(1), dev::u256(0));
+        for (unsigned j = 0; j < slots; j++)
+            account.setStorage(dev::u256(dev::sha3(dev::h256(j))), dev::u256(i * slots + j + 1));
+    }
+    return cache;
+}
+
+static void CommitStorageTries(benchmark::State& state, bool concurrent)
+{
+    const dev::eth::AccountMap cache = SyntheticStorageWrites(64, 256);
+    dev::h256 root;
+    while (state.KeepRunning()) {
+        dev::OverlayDB db;
+        std::unordered_map<dev::Address, dev::h256> roots = dev::eth::commitStorage(cache, db, concurrent);
+        root = roots.begin()->second;
+    }
+    assert(root != dev::EmptyTrie);
+}
+
+static void CommitStorageTriesSerial(benchmark::State& state)
+{
+    CommitStorageTries(state, false);
+}
+
+static void CommitStorageTriesParallel(benchmark::State& state)
+{
+    CommitStorageTries(state, true);
+}
+
+BENCHMARK(CommitStorageTriesSerial, 10);
+BENCHMARK(CommitStorageTriesParallel, 10);
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <tinyformat.h>
+#include <utilstrencodings.h>
+
+#include <univalue.h>
+
+#include <cassert>
+#include <string>
+
+// A batch of sendrawtransaction calls, each with a transaction of about 500 bytes.
+static std::string RawTransactionBatch(unsigned nRequests)
+{
+    UniValue batch(UniValue::VARR);
+    for (unsigned i = 0; i < nRequests; i++) {
+        std::vector<unsigned char> tx(500);
+        for (size_t j = 0; j < tx.size(); j++)
+            tx[j] = (unsigned char)(i * 31 + j * 7);
+        UniValue params(UniValue::VARR);
+        params.push_back(HexStr(tx));
+        UniValue request(UniValue::VOBJ);
+        request.push_back(Pair("jsonrpc", "1.0"));
+        request.push_back(Pair("id", (int)i));
+        request.push_back(Pair("method", "sendrawtransaction"));
+        request.push_back(Pair("params", params));
+        batch.push_back(request);
+    }
+    return batch.write();
+}
+
+// A signrawtransaction call spending many outputs, with their previous outputs given.
+static std::string SignRawTransactionRequest(unsigned nInputs)
+{
+    UniValue prevtxs(UniValue::VARR);
+    for (unsigned i = 0; i < nInputs; i++) {
+        UniValue prevout(UniValue::VOBJ);
+        prevout.push_back(Pair("txid", strprintf("%064x", i + 1)));
+        prevout.push_back(Pair("vout", (int)(i % 4)));
+        prevout.push_back(Pair("scriptPubKey", strprintf("76a914%040x88ac", i)));
+        prevout.push_back(Pair("redeemScript", strprintf("5221%066x21%066x52ae", i, i + 1)));
+        prevout.push_back(Pair("amount", 0.125));
+        prevtxs.push_back(prevout);
+    }
+    UniValue params(UniValue::VARR);
+    params.push_back(std::string(nInputs * 82, 'a'));
+    params.push_back(prevtxs);
+    params.push_back(NullUniValue);
+    params.push_back("ALL");
+    UniValue request(UniValue::VOBJ);
+    request.push_back(Pair("jsonrpc", "1.0"));
+    request.push_back(Pair("id", "bench"));
+    request.push_back(Pair("method", "signrawtransaction"));
+    request.push_back(Pair("params", params));
+    return request.write(4);
+}
+
+static void JSONReadRawTransactionBatch(benchmark::State& state)
+{
+    const std::string json = RawTransactionBatch(100);
+    while (state.KeepRunning()) {
+        UniValue value;
+        bool ok = value.read(json);
+        assert(ok);
+    }
+}
+
+static void JSONWriteRawTransactionBatch(benchmark::State& state)
+{
+    UniValue value;
+    bool ok = value.read(RawTransactionBatch(100));
+    assert(ok);
+    while (state.KeepRunning()) {
+        std::string json = value.write();
+        assert(!json.empty());
+    }
+}
+
+static void JSONReadSignRawTransaction(benchmark::State& state)
+{
+    const std::string json = SignRawTransactionRequest(200);
+    while (state.KeepRunning()) {
+        UniValue value;
+        bool ok = value.read(json);
+        assert(ok);
+    }
+}
+
+static void JSONWriteSignRawTransaction(benchmark::State& state)
+{
+    UniValue value;
+    bool ok = value.read(SignRawTransactionRequest(200));
+    assert(ok);
+    while (state.KeepRunning()) {
+        std::string json = value.write(4);
+        assert(!json.empty());
+    }
+}
+
+BENCHMARK(JSONReadRawTransactionBatch, 2000);
+BENCHMARK(JSONWriteRawTransactionBatch, 4000);
+BENCHMARK(JSONReadSignRawTransaction, 1000);
+BENCHMARK(JSONWriteSignRawTransaction, 2000);
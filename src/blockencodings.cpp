@@ -178,6 +178,15 @@ bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const {
     return txn_available[index] != nullptr;
 }
 
+std::vector<CTransactionRef> PartiallyDownloadedBlock::GetAvailableTransactions() const {
+    std::vector<CTransactionRef> txs;
+    for (const CTransactionRef& tx : txn_available) {
+        if (tx)
+            txs.push_back(tx);
+    }
+    return txs;
+}
+
 ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing) {
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
@@ -221,3 +230,12 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
 
     return READ_STATUS_OK;
 }
+
+size_t GetEquihashSolutionSize(uint32_t nHeight)
+{
+    const CChainParams& chainparams = Params();
+    unsigned int n = chainparams.EquihashN(nHeight);
+    unsigned int k = chainparams.EquihashK(nHeight);
+    // 2^k indices of n/(k+1)+1 bits each
+    return ((size_t)1 << k) * (n / (k + 1) + 1) / 8;
+}
@@ -7,6 +7,7 @@
 
 #include <primitives/block.h>
 
+#include <limits>
 #include <memory>
 
 class CTxMemPool;
@@ -203,7 +204,189 @@ public:
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
     ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
     bool IsTxAvailable(size_t index) const;
+    /** The transactions found so far, in block order */
+    std::vector<CTransactionRef> GetAvailableTransactions() const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
 
+/** The length of an Equihash solution for the parameters active at nHeight */
+size_t GetEquihashSolutionSize(uint32_t nHeight);
+
+/** Explicit solution lengths in headers2 messages are refused above this */
+static const size_t MAX_COMPACT_HEADER_SOLUTION_SIZE = 1 << 16;
+
+/** Which fields of a headers2 entry are written out, the others follow from the previous header */
+enum CompactHeaderFlags : uint8_t {
+    COMPACT_HEADER_VERSION = 1 << 0,       //!< nVersion, else the previous one's
+    COMPACT_HEADER_PREV = 1 << 1,          //!< hashPrevBlock, else the previous header's hash
+    COMPACT_HEADER_HEIGHT = 1 << 2,        //!< nHeight as a varint, else one more than the previous
+    COMPACT_HEADER_BITS = 1 << 3,          //!< nBits, else the previous one's
+    COMPACT_HEADER_ROOTS = 1 << 4,         //!< hashStateRoot and hashUTXORoot, else the last ones written
+    COMPACT_HEADER_RESERVED = 1 << 5,      //!< nReserved, else zero
+    COMPACT_HEADER_SOLUTION_SIZE = 1 << 6, //!< the nSolution length, else GetEquihashSolutionSize
+};
+
+/**
+ * Writes a run of headers as a "headers2" message (NODE_COMPACT_HEADERS). Each header is
+ * written against the one before it: a CompactHeaderFlags byte, the fields it names, the
+ * merkle root, the time as a zigzag varint delta and, in the Equihash format, the nonce and
+ * the solution without its length. The solution is already bit-packed by the Equihash
+ * encoding. There is no transaction count. The first header is written against a null one.
+ */
+template <typename Header>
+class CompactHeadersWriter
+{
+private:
+    const std::vector<Header>& headers;
+
+public:
+    explicit CompactHeadersWriter(const std::vector<Header>& headersIn) : headers(headersIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, headers.size());
+        CBlockHeader prev;
+        uint256 hashPrev;
+        uint256 hashStateRootPrev = prev.hashStateRoot;
+        uint256 hashUTXORootPrev = prev.hashUTXORoot;
+        for (const CBlockHeader& header : headers) {
+            bool fContract = _IsSupportContract(header.nVersion, header.nHeight);
+            bool fEquihash = !_IsLegacyFormat(header.nHeight);
+            uint8_t nFlags = 0;
+            if (header.nVersion != prev.nVersion)
+                nFlags |= COMPACT_HEADER_VERSION;
+            if (header.hashPrevBlock != hashPrev)
+                nFlags |= COMPACT_HEADER_PREV;
+            if (header.nHeight != prev.nHeight + 1)
+                nFlags |= COMPACT_HEADER_HEIGHT;
+            if (header.nBits != prev.nBits)
+                nFlags |= COMPACT_HEADER_BITS;
+            if (fContract && (header.hashStateRoot != hashStateRootPrev || header.hashUTXORoot != hashUTXORootPrev))
+                nFlags |= COMPACT_HEADER_ROOTS;
+            if (fEquihash) {
+                for (uint32_t nReserved : header.nReserved) {
+                    if (nReserved != 0)
+                        nFlags |= COMPACT_HEADER_RESERVED;
+                }
+                if (header.nSolution.size() != GetEquihashSolutionSize(header.nHeight))
+                    nFlags |= COMPACT_HEADER_SOLUTION_SIZE;
+            }
+
+            s << nFlags;
+            if (nFlags & COMPACT_HEADER_VERSION)
+                s << header.nVersion;
+            if (nFlags & COMPACT_HEADER_PREV)
+                s << header.hashPrevBlock;
+            if (nFlags & COMPACT_HEADER_HEIGHT)
+                s << VARINT(header.nHeight);
+            s << header.hashMerkleRoot;
+            int64_t nTimeDelta = (int64_t)header.nTime - (int64_t)prev.nTime;
+            uint64_t nTimeZigZag = nTimeDelta < 0 ? ((uint64_t)-nTimeDelta << 1) - 1 : (uint64_t)nTimeDelta << 1;
+            s << VARINT(nTimeZigZag);
+            if (nFlags & COMPACT_HEADER_BITS)
+                s << header.nBits;
+            if (nFlags & COMPACT_HEADER_ROOTS) {
+                s << header.hashStateRoot << header.hashUTXORoot;
+                hashStateRootPrev = header.hashStateRoot;
+                hashUTXORootPrev = header.hashUTXORoot;
+            }
+            if (nFlags & COMPACT_HEADER_RESERVED) {
+                for (uint32_t nReserved : header.nReserved)
+                    s << nReserved;
+            }
+            if (fEquihash) {
+                s << header.nNonce;
+                if (nFlags & COMPACT_HEADER_SOLUTION_SIZE)
+                    WriteCompactSize(s, header.nSolution.size());
+                if (!header.nSolution.empty())
+                    s.write((const char*)header.nSolution.data(), header.nSolution.size());
+            } else {
+                s << (uint32_t)header.nNonce.GetUint64(0);
+            }
+
+            prev = header;
+            hashPrev = header.GetHash();
+        }
+    }
+};
+
+/**
+ * Read the headers of a headers2 message, see CompactHeadersWriter. Returns false, with nCount
+ * set but nothing read, when there are more than nMaxCount.
+ */
+template <typename Stream>
+bool ReadCompactHeaders(Stream& s, std::vector<CBlockHeader>& headers, unsigned int nMaxCount, unsigned int& nCount)
+{
+    nCount = ReadCompactSize(s);
+    if (nCount > nMaxCount)
+        return false;
+    headers.resize(nCount);
+    CBlockHeader prev;
+    uint256 hashPrev;
+    uint256 hashStateRootPrev = prev.hashStateRoot;
+    uint256 hashUTXORootPrev = prev.hashUTXORoot;
+    for (CBlockHeader& header : headers) {
+        header.SetNull();
+        uint8_t nFlags;
+        s >> nFlags;
+        header.nVersion = prev.nVersion;
+        if (nFlags & COMPACT_HEADER_VERSION)
+            s >> header.nVersion;
+        header.hashPrevBlock = hashPrev;
+        if (nFlags & COMPACT_HEADER_PREV)
+            s >> header.hashPrevBlock;
+        header.nHeight = prev.nHeight + 1;
+        if (nFlags & COMPACT_HEADER_HEIGHT)
+            s >> VARINT(header.nHeight);
+        s >> header.hashMerkleRoot;
+        uint64_t nTimeZigZag;
+        s >> VARINT(nTimeZigZag);
+        // No delta between two 32 bit times encodes larger, and larger ones would overflow below
+        if (nTimeZigZag > (uint64_t)std::numeric_limits<uint32_t>::max() << 1)
+            throw std::ios_base::failure("headers2 time out of range");
+        int64_t nTimeDelta = (nTimeZigZag & 1) ? -(int64_t)((nTimeZigZag >> 1) + 1) : (int64_t)(nTimeZigZag >> 1);
+        int64_t nTime = (int64_t)prev.nTime + nTimeDelta;
+        if (nTime < 0 || nTime > std::numeric_limits<uint32_t>::max())
+            throw std::ios_base::failure("headers2 time out of range");
+        header.nTime = nTime;
+        header.nBits = prev.nBits;
+        if (nFlags & COMPACT_HEADER_BITS)
+            s >> header.nBits;
+
+        bool fContract = _IsSupportContract(header.nVersion, header.nHeight);
+        bool fEquihash = !_IsLegacyFormat(header.nHeight);
+        if (fContract) {
+            if (nFlags & COMPACT_HEADER_ROOTS) {
+                s >> hashStateRootPrev >> hashUTXORootPrev;
+            }
+            header.hashStateRoot = hashStateRootPrev;
+            header.hashUTXORoot = hashUTXORootPrev;
+        }
+        if (fEquihash && (nFlags & COMPACT_HEADER_RESERVED)) {
+            for (uint32_t& nReserved : header.nReserved)
+                s >> nReserved;
+        }
+        if (fEquihash) {
+            s >> header.nNonce;
+            size_t nSolutionSize = GetEquihashSolutionSize(header.nHeight);
+            if (nFlags & COMPACT_HEADER_SOLUTION_SIZE)
+                nSolutionSize = ReadCompactSize(s);
+            if (nSolutionSize > MAX_COMPACT_HEADER_SOLUTION_SIZE)
+                throw std::ios_base::failure("headers2 solution size too large");
+            header.nSolution.resize(nSolutionSize);
+            if (nSolutionSize)
+                s.read((char*)header.nSolution.data(), nSolutionSize);
+        } else {
+            uint32_t nLegacyNonce;
+            s >> nLegacyNonce;
+            header.nNonce = ArithToUint256(arith_uint256(nLegacyNonce));
+        }
+
+        prev = header;
+        hashPrev = header.GetHash();
+    }
+    return true;
+}
+
 #endif
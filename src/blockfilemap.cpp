@@ -0,0 +1,108 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+
+#include <tinyformat.h>
+#include <util.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    int fd = ::open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t nSize = st.st_size;
+    void* addr = mmap(nullptr, nSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file referenced
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LogPrintf("Unable to map %s: %s\n", path.string(), strerror(errno));
+        return nullptr;
+    }
+    return std::shared_ptr<const CMappedFile>(new CMappedFile(static_cast<const unsigned char*>(addr), nSize));
+#else
+    // Blocks are read through files on Windows
+    return nullptr;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    munmap(const_cast<unsigned char*>(pdata), nSize);
+#endif
+}
+
+CBlockFileMapPool::CBlockFileMapPool(const fs::path& dirIn, size_t nMaxFilesIn) : dir(dirIn), nMaxFiles(nMaxFilesIn), nLastBlockFile(0)
+{
+}
+
+std::shared_ptr<const CMappedFile> CBlockFileMapPool::Get(int nFile)
+{
+    LOCK(cs);
+    for (auto it = listMaps.begin(); it != listMaps.end(); ++it) {
+        if (it->first == nFile) {
+            listMaps.splice(listMaps.begin(), listMaps, it);
+            return it->second;
+        }
+    }
+    if (nMaxFiles == 0 || nFile < 0 || nFile >= nLastBlockFile)
+        return nullptr;
+
+    std::shared_ptr<const CMappedFile> map = CMappedFile::Open(dir / strprintf("blk%05u.dat", nFile));
+    if (!map)
+        return nullptr;
+    listMaps.emplace_front(nFile, map);
+    if (listMaps.size() > nMaxFiles)
+        listMaps.pop_back();
+    return map;
+}
+
+void CBlockFileMapPool::SetLastBlockFile(int nFile)
+{
+    LOCK(cs);
+    nLastBlockFile = nFile;
+    // Files at or above it weren't final when they were mapped, e.g. after UnloadBlockIndex
+    listMaps.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedFile>>& entry) { return entry.first >= nFile; });
+}
+
+void CBlockFileMapPool::Drop(int nFile)
+{
+    LOCK(cs);
+    listMaps.remove_if([nFile](const std::pair<int, std::shared_ptr<const CMappedFile>>& entry) { return entry.first == nFile; });
+}
+
+void CBlockFileMapPool::Clear()
+{
+    LOCK(cs);
+    listMaps.clear();
+}
+
+size_t CBlockFileMapPool::MappedFiles() const
+{
+    LOCK(cs);
+    return listMaps.size();
+}
+
+size_t CBlockFileMapPool::MappedBytes() const
+{
+    LOCK(cs);
+    size_t nBytes = 0;
+    for (const auto& entry : listMaps)
+        nBytes += entry.second->size();
+    return nBytes;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef FABCOIN_BLOCKFILEMAP_H
+#define FABCOIN_BLOCKFILEMAP_H
+
+#include <fs.h>
+#include <sync.h>
+
+#include <list>
+#include <memory>
+#include <stddef.h>
+#include <utility>
+
+/** Default for -blockmapfiles, the number of block files kept mapped. 0 on 32 bit, where address space is short */
+static const unsigned int DEFAULT_BLOCK_MAP_FILES = sizeof(void*) >= 8 ? 8 : 0;
+
+/** A whole file mapped read-only into memory, unmapped when the last reference goes away */
+class CMappedFile
+{
+public:
+    /** Map the file at path, nullptr if it doesn't exist, is empty or can't be mapped */
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+    ~CMappedFile();
+
+    const unsigned char* data() const { return pdata; }
+    size_t size() const { return nSize; }
+
+private:
+    CMappedFile(const unsigned char* pdataIn, size_t nSizeIn) : pdata(pdataIn), nSize(nSizeIn) {}
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const unsigned char* const pdata;
+    const size_t nSize;
+};
+
+/**
+ * The least recently used finalized block files (blk?????.dat), mapped read-only so blocks
+ * are deserialized straight from the page cache instead of through fopen, fseek and fread
+ * for every read.
+ *
+ * Only files below the one blocks are appended to are mapped: that one still grows and is
+ * truncated when it is finalized. The mapped pages are clean page cache, so the kernel
+ * drops them under memory pressure; the pool bounds the address space by unmapping the
+ * least recently used file beyond nMaxFiles. A file evicted or pruned while a reader uses
+ * it stays mapped until that reader drops its reference.
+ */
+class CBlockFileMapPool
+{
+public:
+    CBlockFileMapPool(const fs::path& dirIn, size_t nMaxFilesIn);
+
+    /** The mapping of block file nFile, nullptr if it may still change or can't be mapped */
+    std::shared_ptr<const CMappedFile> Get(int nFile);
+    /** Blocks are now appended to nFile, files below it are final */
+    void SetLastBlockFile(int nFile);
+    /** Forget the mapping of a file that is about to be deleted */
+    void Drop(int nFile);
+    void Clear();
+
+    size_t MappedFiles() const;
+    size_t MappedBytes() const;
+
+private:
+    mutable CCriticalSection cs;
+    const fs::path dir;
+    const size_t nMaxFiles;
+    int nLastBlockFile;
+    //! Most recently used first
+    std::list<std::pair<int, std::shared_ptr<const CMappedFile>>> listMaps;
+};
+
+#endif // FABCOIN_BLOCKFILEMAP_H
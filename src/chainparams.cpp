@@ -194,6 +194,9 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x03292eeaf1835cffc791e15b05f558adc080f85b3c54e351c1010a2699d2fc48");
 
+        // fasc: failed contract executions clear the state and UTXO caches from the genesis block on
+        consensus.nFixUTXOCacheHFHeight = 0;
+
         /**
          * The message start string is designed to be unlikely to occur in normal data.
          * The characters are rarely used upper ASCII, not valid as UTF-8, and produce
@@ -205,6 +208,7 @@ public:
         pchMessageStart[3] = 0xab;
         nDefaultPort = 8665;
         nPruneAfterHeight = 100000;
+        nContractReuseHeight = 0;
         
         const size_t N = 200, K = 9;
         BOOST_STATIC_ASSERT(equihash_parameters_acceptable(N, K));
@@ -327,6 +331,9 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x0500238931fa06c38381611e9244d9523926d6dc501664de27d1bff4e22b9afa"); 
 
+        // fasc: failed contract executions clear the state and UTXO caches from the genesis block on
+        consensus.nFixUTXOCacheHFHeight = 0;
+
         //pchMessageStart[0] = 0x0b;
         //pchMessageStart[1] = 0x11;
         //pchMessageStart[2] = 0x09;
@@ -337,6 +344,7 @@ public:
         pchMessageStart[3] = 0x0b;
         nDefaultPort = 18665;
         nPruneAfterHeight = 1000;
+        nContractReuseHeight = 0;
 
         const size_t N = 200, K = 9;
         BOOST_STATIC_ASSERT(equihash_parameters_acceptable(N, K));
@@ -451,12 +459,16 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x0e28ba5df35c1ac0893b7d37db241a6f4afac5498da89369067427dc369f9df3");
 
+        // fasc: failed contract executions clear the state and UTXO caches from the genesis block on
+        consensus.nFixUTXOCacheHFHeight = 0;
+
         pchMessageStart[0] = 0xfa;
         pchMessageStart[1] = 0xbf;
         pchMessageStart[2] = 0xb5;
         pchMessageStart[3] = 0xda;
         this->nDefaultPort = 40665;
         nPruneAfterHeight = 1000;
+        nContractReuseHeight = 0;
 
         const size_t N = 48, K = 5;
         BOOST_STATIC_ASSERT(equihash_parameters_acceptable(N, K));
@@ -588,12 +600,16 @@ public:
         // By default assume that the signatures in ancestors of this block are valid.
         consensus.defaultAssumeValid = uint256S("0x0e28ba5df35c1ac0893b7d37db241a6f4afac5498da89369067427dc369f9df3");
 
+        // fasc: failed contract executions clear the state and UTXO caches from the genesis block on
+        consensus.nFixUTXOCacheHFHeight = 0;
+
         pchMessageStart[0] = 0xfa;
         pchMessageStart[1] = 0xbf;
         pchMessageStart[2] = 0xb5;
         pchMessageStart[3] = 0xda;
         nDefaultPort = 38665;
         nPruneAfterHeight = 1000;
+        nContractReuseHeight = 0;
       
         const size_t N = 48, K = 5;
         BOOST_STATIC_ASSERT(equihash_parameters_acceptable(N, K));
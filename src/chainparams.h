@@ -71,6 +71,10 @@ public:
     bool RequireStandard() const { return fRequireStandard; }
     bool IncludeTestCommands() const {return this->fIncludeTestCommands; }
     uint64_t PruneAfterHeight() const { return nPruneAfterHeight; }
+    /** Height of the chain tip from which contract executions may be run ahead or in parallel and reused;
+     *  must not be below consensus.nFixUTXOCacheHFHeight, before which a failed execution leaves UTXO
+     *  cache entries behind for the next one */
+    int ContractReuseHeight() const { return nContractReuseHeight; }
     unsigned int EquihashN(uint32_t nHeight = 0) const { return (nHeight < consensus.EquihashFABHeight) /*|| (strNetworkID != CBaseChainParams::MAIN)*/ ? nEquihashN : 184; }
     unsigned int EquihashK(uint32_t nHeight = 0) const { return (nHeight < consensus.EquihashFABHeight) /*|| (strNetworkID != CBaseChainParams::MAIN)*/ ? nEquihashK : 7; }
     int64_t GetnPowTargetSpacing( uint32_t nHeight = 0 ) const { return (nHeight < consensus.EquihashFABHeight) ? consensus.nPowTargetSpacing : 2* consensus.nPowTargetSpacing; }
@@ -94,6 +98,7 @@ protected:
     CMessageHeader::MessageStartChars pchMessageStart;
     uint16_t nDefaultPort;
     uint64_t nPruneAfterHeight;
+    int nContractReuseHeight;
     unsigned int nEquihashN = 0;
     unsigned int nEquihashK = 0;
     std::vector<CDNSSeedData> vSeeds;
@@ -2,6 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/fabcoin-config.h>
+#endif
+
 #include <dbwrapper.h>
 
 #include <fs.h>
@@ -14,6 +18,8 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <map>
+#include <mutex>
 
 class CFabcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -73,13 +79,13 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, leveldb::CompressionType compression)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.compression = compression;
     options.max_open_files = 64;
     options.info_log = new CFabcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
@@ -90,14 +96,24 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+void FreeLevelDBOptions(leveldb::Options& options)
+{
+    delete options.filter_policy;
+    options.filter_policy = nullptr;
+    delete options.info_log;
+    options.info_log = nullptr;
+    delete options.block_cache;
+    options.block_cache = nullptr;
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, leveldb::CompressionType compression)
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetLevelDBOptions(nCacheSize, compression);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -114,6 +130,10 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
     LogPrintf("Opened LevelDB successfully\n");
+    if (!fMemory) {
+        strName = path.string();
+        RegisterLevelDB(strName, pdb, nCacheSize, options.block_cache);
+    }
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
         LogPrintf("Starting database compaction of %s\n", path.string());
@@ -143,14 +163,11 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
 
 CDBWrapper::~CDBWrapper()
 {
+    if (!strName.empty())
+        UnregisterLevelDB(strName);
     delete pdb;
     pdb = nullptr;
-    delete options.filter_policy;
-    options.filter_policy = nullptr;
-    delete options.info_log;
-    options.info_log = nullptr;
-    delete options.block_cache;
-    options.block_cache = nullptr;
+    FreeLevelDBOptions(options);
     delete penv;
     options.env = nullptr;
 }
@@ -189,6 +206,107 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+namespace {
+
+struct RegisteredLevelDB
+{
+    leveldb::DB* db;
+    size_t nCacheSize;
+    leveldb::Cache* cache;
+};
+
+std::mutex cs_leveldbs;
+std::map<std::string, RegisteredLevelDB> mapLevelDBs;
+
+}
+
+static const char* const DB_COMPRESSION_DBS[] = {"blockindex", "chainstate", "evmstate", "receipts"};
+static std::map<std::string, leveldb::CompressionType> mapDBCompression;
+
+static bool ParseCompression(const std::string& strCodec, leveldb::CompressionType& compression)
+{
+    if (strCodec == "none") {
+        compression = leveldb::kNoCompression;
+        return true;
+    }
+#ifdef USE_SNAPPY
+    if (strCodec == "snappy") {
+        compression = leveldb::kSnappyCompression;
+        return true;
+    }
+#endif
+#ifdef USE_ZSTD
+    if (strCodec == "zstd") {
+        compression = leveldb::kZstdCompression;
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool SetDBCompression(const std::string& strArg, std::string& strError)
+{
+    size_t nColon = strArg.find(':');
+    std::string strDB = nColon == std::string::npos ? "" : strArg.substr(0, nColon);
+    std::string strCodec = nColon == std::string::npos ? strArg : strArg.substr(nColon + 1);
+    leveldb::CompressionType compression;
+    if (!ParseCompression(strCodec, compression)) {
+        strError = strprintf("Unsupported database compression: '%s'", strCodec);
+        return false;
+    }
+    bool fFound = false;
+    for (const char* db : DB_COMPRESSION_DBS) {
+        if (strDB.empty() || strDB == db) {
+            mapDBCompression[db] = compression;
+            fFound = true;
+        }
+    }
+    if (!fFound) {
+        strError = strprintf("Unknown database for compression: '%s'", strDB);
+        return false;
+    }
+    return true;
+}
+
+leveldb::CompressionType GetDBCompression(const std::string& db)
+{
+    std::map<std::string, leveldb::CompressionType>::const_iterator it = mapDBCompression.find(db);
+    return it == mapDBCompression.end() ? leveldb::kNoCompression : it->second;
+}
+
+void RegisterLevelDB(const std::string& name, leveldb::DB* db, size_t nCacheSize, leveldb::Cache* cache)
+{
+    std::lock_guard<std::mutex> lock(cs_leveldbs);
+    mapLevelDBs[name] = RegisteredLevelDB{db, nCacheSize, cache};
+}
+
+void UnregisterLevelDB(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(cs_leveldbs);
+    mapLevelDBs.erase(name);
+}
+
+std::vector<LevelDBInfo> GetLevelDBInfo()
+{
+    // Keys of all databases sort below this one
+    const std::string strKeyEnd(DBWRAPPER_PREALLOC_KEY_SIZE, '\xff');
+    const leveldb::Range range{leveldb::Slice(), leveldb::Slice(strKeyEnd)};
+
+    std::vector<LevelDBInfo> vInfo;
+    std::lock_guard<std::mutex> lock(cs_leveldbs);
+    for (const auto& entry : mapLevelDBs) {
+        LevelDBInfo info;
+        info.name = entry.first;
+        info.nCacheSize = entry.second.nCacheSize;
+        info.nCacheUsage = entry.second.cache ? entry.second.cache->TotalCharge() : 0;
+        entry.second.db->GetApproximateSizes(&range, 1, &info.nApproximateSize);
+        entry.second.db->GetProperty("leveldb.approximate-memory-usage", &info.strMemoryUsage);
+        entry.second.db->GetProperty("leveldb.stats", &info.strStats);
+        vInfo.push_back(info);
+    }
+    return vInfo;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
@@ -43,6 +43,44 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
 };
 
+/**
+ * Options CDBWrapper opens its databases with: an LRU block cache of half of nCacheSize, write
+ * buffers of a quarter and bloom filters. Used as well by the databases opened outside it, the
+ * contract state and receipts, which free the cache, filter and logger with FreeLevelDBOptions.
+ */
+leveldb::Options GetLevelDBOptions(size_t nCacheSize, leveldb::CompressionType compression = leveldb::kNoCompression);
+
+/** Free the block cache, filter policy and logger of options from GetLevelDBOptions, once their database is closed. */
+void FreeLevelDBOptions(leveldb::Options& options);
+
+/**
+ * Set the compression of newly written tables of the databases from -dbcompression=[<db>:]<codec>.
+ * The databases are "blockindex", "chainstate", "evmstate" (the contract state and UTXO tries)
+ * and "receipts", all if none is given. The codecs are "none", and "snappy" and "zstd" when built
+ * with them. Tables already written keep theirs, so that the setting can be changed at any time.
+ */
+bool SetDBCompression(const std::string& strArg, std::string& strError);
+leveldb::CompressionType GetDBCompression(const std::string& db);
+
+/** Usage of a database opened with GetLevelDBOptions, for getdbinfo */
+struct LevelDBInfo
+{
+    std::string name;
+    size_t nCacheSize;
+    size_t nCacheUsage;
+    uint64_t nApproximateSize;
+    std::string strMemoryUsage;
+    std::string strStats;
+};
+
+/**
+ * Report a database in GetLevelDBInfo under name, replacing any database of that name.
+ * It must be unregistered before being closed.
+ */
+void RegisterLevelDB(const std::string& name, leveldb::DB* db, size_t nCacheSize, leveldb::Cache* cache);
+void UnregisterLevelDB(const std::string& name);
+std::vector<LevelDBInfo> GetLevelDBInfo();
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch
 {
@@ -198,6 +236,9 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! name the database is reported under in GetLevelDBInfo, empty if in memory
+    std::string strName;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -217,8 +258,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] compression Codec of the tables written, see SetDBCompression.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, leveldb::CompressionType compression = leveldb::kNoCompression);
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -117,11 +117,11 @@ bool FascDGP::initStorages(const dev::Address& addr, unsigned int blockHeight, s
 }
 
 void FascDGP::initStorageDGP(const dev::Address& addr) {
-    storageDGP = state->storage(addr);
+    dgpContract = addr;
 }
 
 void FascDGP::initStorageTemplate(const dev::Address& addr) {
-    storageTemplate = state->storage(addr);
+    templateContract = addr;
 }
 
 void FascDGP::initDataTemplate(const dev::Address& addr, std::vector<unsigned char>& data) {
@@ -129,17 +129,16 @@ void FascDGP::initDataTemplate(const dev::Address& addr, std::vector<unsigned ch
 }
 
 void FascDGP::createParamsInstance() {
-    dev::h256 paramsInstanceHash = sha3(dev::h256("0000000000000000000000000000000000000000000000000000000000000000"));
-    if(storageDGP.count(paramsInstanceHash)) {
-        dev::u256 paramsInstanceSize = storageDGP.find(paramsInstanceHash)->second.second;
-        for(size_t i = 0; i < size_t(paramsInstanceSize); i++) {
-            std::pair<unsigned int, dev::Address> params;
-            params.first = dev::toUint64(storageDGP.find(sha3(paramsInstanceHash))->second.second);
-            ++paramsInstanceHash;
-            params.second = dev::right160(dev::h256(storageDGP.find(sha3(paramsInstanceHash))->second.second));
-            ++paramsInstanceHash;
-            paramsInstance.push_back(params);
-        }
+    // Slot 0 holds the length of the params array, whose elements start at slot sha3(0).
+    dev::u256 paramsInstanceSize = state->storage(dgpContract, dev::u256(0));
+    dev::u256 paramsInstanceSlot = dev::u256(sha3(dev::h256(dev::u256(0))));
+    for(size_t i = 0; i < size_t(paramsInstanceSize); i++) {
+        std::pair<unsigned int, dev::Address> params;
+        params.first = dev::toUint64(state->storage(dgpContract, paramsInstanceSlot));
+        ++paramsInstanceSlot;
+        params.second = dev::right160(dev::h256(state->storage(dgpContract, paramsInstanceSlot)));
+        ++paramsInstanceSlot;
+        paramsInstance.push_back(params);
     }
 }
 
@@ -151,25 +150,16 @@ dev::Address FascDGP::getAddressForBlock(unsigned int blockHeight) {
     return dev::Address();
 }
 
-static inline bool sortPairs(const std::pair<dev::u256, dev::u256>& a, const std::pair<dev::u256, dev::u256>& b) {
-    return a.first < b.first;
-}
-
 void FascDGP::parseStorageScheduleContract(std::vector<uint32_t>& uint32Values) {
-    std::vector<std::pair<dev::u256, dev::u256>> data;
+    std::vector<dev::u256> data;
     for(size_t i = 0; i < 5; i++) {
-        dev::h256 gasScheduleHash = sha3(dev::h256(dev::u256(i)));
-        if(storageTemplate.count(gasScheduleHash)) {
-            dev::u256 key = storageTemplate.find(gasScheduleHash)->second.first;
-            dev::u256 value = storageTemplate.find(gasScheduleHash)->second.second;
-            data.push_back(std::make_pair(key, value));
+        dev::u256 value = state->storage(templateContract, dev::u256(i));
+        if(value) {
+            data.push_back(value);
         }
     }
 
-    std::sort(data.begin(), data.end(), sortPairs);
-
-    for(std::pair<dev::u256, dev::u256> d : data) {
-        dev::u256 value = d.second;
+    for(dev::u256 value : data) {
         for(size_t i = 0; i < 4; i++) {
             uint64_t uint64Value = dev::toUint64(value);
             value = value >> 64;
@@ -191,9 +181,9 @@ void FascDGP::parseDataScheduleContract(std::vector<uint32_t>& uint32Values) {
 }
 
 void FascDGP::parseStorageOneUint64(uint64_t& value) {
-    dev::h256 blockSizeHash = sha3(dev::h256(dev::u256(0)));
-    if(storageTemplate.count(blockSizeHash)) {
-        value = dev::toUint64(storageTemplate.find(blockSizeHash)->second.second);
+    dev::u256 storedValue = state->storage(templateContract, dev::u256(0));
+    if(storedValue) {
+        value = dev::toUint64(storedValue);
     }
 }
 
@@ -258,8 +248,7 @@ dev::eth::EVMSchedule FascDGP::createEVMSchedule(const dev::eth::EVMSchedule &_s
 }
 
 void FascDGP::clear() {
+    dgpContract = dev::Address();
     templateContract = dev::Address();
-    storageDGP.clear();
-    storageTemplate.clear();
     paramsInstance.clear();
 }
@@ -78,11 +78,9 @@ private:
 
     const FascState* state;
 
-    dev::Address templateContract;
-
-    std::map<dev::h256, std::pair<dev::u256, dev::u256> > storageDGP;
+    dev::Address dgpContract;
 
-    std::map<dev::h256, std::pair<dev::u256, dev::u256> > storageTemplate;
+    dev::Address templateContract;
 
     std::vector<unsigned char> dataTemplate;
 
@@ -0,0 +1,218 @@
+#include <fasc/fascparallel.h>
+#include <chainparams.h>
+#include <checkqueue.h>
+#include <coins.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <libethereum/ChainParams.h>
+
+bool fParallelContracts = DEFAULT_PARALLEL_CONTRACTS;
+
+// Contract executions are heavy and uneven, so hand them out one at a time.
+static CCheckQueue<CContractCheck> contractcheckqueue(1);
+
+void ThreadContractCheck() {
+    RenameThread("fabcoin-contractcheck");
+    contractcheckqueue.Thread();
+}
+
+bool CContractCheck::operator()(std::stringstream* commentsOnFailureNullForNone) {
+    // Mirrors ByteCodeExec::performByteCode. A failure here only means the transaction
+    // will be executed sequentially, so it never fails the check queue.
+    try {
+        std::vector<ResultExecute> results;
+        std::stringstream comments;
+        ContractExecutionRecorder recorder(*slot->state, slot->txs, *envInfo, hashTip);
+        for (const FascTransaction& tx : slot->txs) {
+            if (!tx.isCreation() && !slot->state->addressInUse(tx.receiveAddress())) {
+                dev::eth::ExecutionResult execRes;
+                execRes.excepted = dev::eth::TransactionException::Unknown;
+                results.push_back(ResultExecute{execRes, FascTransactionReceipt(dev::h256(), dev::u256(), dev::u256(), dev::eth::LogEntries()), CTransaction()});
+                continue;
+            }
+            results.push_back(slot->state->execute(*envInfo, *slot->sealEngine, tx, dev::eth::Permanence::Committed, OnOpFunc(), &comments));
+        }
+        slot->record = recorder.Finish(results, comments.str());
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::BENCH, "%s: parallel execution of %s failed: %s\n", __func__, slot->txs.front().getHashWith().hex(), e.what());
+        slot->record.reset();
+    }
+    return true;
+}
+
+ParallelContractExecution::ParallelContractExecution(const CBlock& _block, const dev::u256& blockGasLimit, const dev::eth::EVMSchedule& _schedule) :
+    block(_block), schedule(_schedule), nApplied(0), nExecuted(0)
+{
+    envExec.reset(new ByteCodeExec(block, std::vector<FascTransaction>(), blockGasLimit));
+    envInfo.reset(new dev::eth::EnvInfo(envExec->BuildEVMEnvironment()));
+    chainParams.reset(new dev::eth::ChainParams(Params().EVMGenesisInfo()));
+    baseState.reset(new FascState(dev::u256(0), globalState->db(), globalState->dbUtxo()));
+    baseState->setRoot(globalState->rootHash());
+    baseState->setRootUTXO(globalState->rootHashUTXO());
+    if (chainActive.Tip()) {
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+}
+
+ParallelContractExecution::~ParallelContractExecution()
+{
+    if (!slots.empty()) {
+        LogPrint(BCLog::BENCH, "    - Parallel contract execution: %u candidates, %d applied, %d executed sequentially\n", (unsigned) slots.size(), nApplied, nExecuted);
+    }
+}
+
+void ParallelContractExecution::AddCandidates(CCoinsViewCache& view)
+{
+    AssertLockHeld(cs_main);
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase() || tx->HasOpSpend() || !tx->HasCreateOrCallInOutputs()) {
+            continue;
+        }
+        FascTxConverter convert(*tx, &view, &block.vtx);
+        ExtractFascTX resultConvertFascTX;
+        dev::u256 gasLoanNotUsed;
+        if (!convert.extractionFascTransactions(resultConvertFascTX, gasLoanNotUsed, nullptr)) {
+            continue;
+        }
+        AddCandidate(tx->GetHash(), resultConvertFascTX.first);
+    }
+}
+
+void ParallelContractExecution::AddCandidate(const uint256& hashTx, const std::vector<FascTransaction>& txs)
+{
+    // The receipts of a transaction with several contract outputs carry the roots between
+    // its executions, which can't be recovered from a private view; run those sequentially.
+    if (txs.size() != 1 || txs.front().getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()) {
+        return;
+    }
+    std::unique_ptr<ParallelContractSlot> slot(new ParallelContractSlot());
+    slot->txs = txs;
+    slot->state.reset(new FascState(dev::u256(0), baseState->db(), baseState->dbUtxo()));
+    slot->state->setRoot(baseState->rootHash());
+    slot->state->setRootUTXO(baseState->rootHashUTXO());
+    slot->sealEngine = std::unique_ptr<dev::eth::SealEngineFace>(chainParams->createSealEngine());
+    slot->sealEngine->setFascSchedule(schedule);
+    slots[hashTx] = std::move(slot);
+}
+
+void ParallelContractExecution::Run()
+{
+    AssertLockHeld(cs_main);
+    // Before this height a failed execution could leave UTXO cache entries behind for the next
+    // transaction, which no private view can reproduce.
+    if (chainActive.Height() < Params().ContractReuseHeight() || slots.size() < 2) {
+        slots.clear();
+        return;
+    }
+    int64_t nTimeStart = GetTimeMicros();
+
+    std::vector<CContractCheck> vChecks;
+    vChecks.reserve(slots.size());
+    for (auto& it : slots) {
+        vChecks.push_back(CContractCheck(it.second.get(), envInfo.get(), hashTip));
+    }
+    CCheckQueueControl<CContractCheck> control(&contractcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+    LogPrint(BCLog::BENCH, "    - Parallel contract execution of %u txs: %.2fms\n", (unsigned) slots.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
+bool ParallelContractExecution::Changed(const dev::Address& addr) const
+{
+    // An account's trie value covers its balance, nonce, code and storage root, so
+    // comparing it with the start of the block tells whether anything in it was modified.
+    return globalState->rawAccount(addr) != baseState->rawAccount(addr) ||
+           globalState->rawUTXO(addr) != baseState->rawUTXO(addr);
+}
+
+bool ParallelContractExecution::Conflicts(const dev::eth::StateAccessLog& access) const
+{
+    // Writes made without reading (e.g. the sender and author accounts every execution
+    // deletes) are blind, so only accounts a preceding transaction actually changed matter.
+    for (const dev::Address& addr : access.addresses) {
+        if (writtenInBlock.count(addr) && Changed(addr)) {
+            return true;
+        }
+    }
+    for (const dev::Address& addr : access.written) {
+        if (writtenInBlock.count(addr) && Changed(addr)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool MapRoot(const dev::h256& root, const dev::h256& pre, const dev::h256& post, const dev::h256& preOut, const dev::h256& postOut, dev::h256& rootOut)
+{
+    if (root == dev::h256()) {
+        rootOut = root;
+    } else if (root == post) {
+        rootOut = postOut;
+    } else if (root == pre) {
+        rootOut = preOut;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParallelContractExecution::Apply(const std::vector<FascTransaction>& txs, std::vector<ResultExecute>& resultOut, std::stringstream* commentsNullForNone)
+{
+    AssertLockHeld(cs_main);
+    if (txs.size() != 1) {
+        return false;
+    }
+    auto it = slots.find(h256Touint(txs.front().getHashWith()));
+    if (it == slots.end() || !it->second->record) {
+        return false;
+    }
+    ParallelContractSlot& slot = *it->second;
+    const ContractExecutionRecord& record = *slot.record;
+    if (record.txsFingerprint != ContractPreExecutor::Fingerprint(txs) || Conflicts(record.access)) {
+        return false;
+    }
+    dev::h256 unused;
+    for (const ResultExecute& r : record.results) {
+        if (!MapRoot(r.txRec.stateRoot(), record.preStateRoot, record.postStateRoot, unused, unused, unused) ||
+            !MapRoot(r.txRec.utxoRoot(), record.preUTXORoot, record.postUTXORoot, unused, unused, unused)) {
+            return false;
+        }
+    }
+
+    // Storage tries and code live in the private overlay; make them reachable from globalState.
+    slot.state->db().commit();
+    slot.state->dbUtxo().commit();
+
+    dev::h256 preStateRoot = globalState->rootHash();
+    dev::h256 preUTXORoot = globalState->rootHashUTXO();
+    for (const dev::Address& addr : record.access.written) {
+        globalState->setRawAccount(addr, slot.state->rawAccount(addr));
+        globalState->setRawUTXO(addr, slot.state->rawUTXO(addr));
+    }
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+    dev::h256 postStateRoot = globalState->rootHash();
+    dev::h256 postUTXORoot = globalState->rootHashUTXO();
+
+    resultOut.clear();
+    for (const ResultExecute& r : record.results) {
+        dev::h256 stateRoot, utxoRoot;
+        MapRoot(r.txRec.stateRoot(), record.preStateRoot, record.postStateRoot, preStateRoot, postStateRoot, stateRoot);
+        MapRoot(r.txRec.utxoRoot(), record.preUTXORoot, record.postUTXORoot, preUTXORoot, postUTXORoot, utxoRoot);
+        resultOut.push_back(ResultExecute{r.execRes, FascTransactionReceipt(stateRoot, utxoRoot, r.txRec.cumulativeGasUsed(), r.txRec.log()), r.tx});
+    }
+    if (commentsNullForNone != nullptr) {
+        *commentsNullForNone << record.comments;
+    }
+    writtenInBlock += record.access.written;
+    nApplied++;
+    return true;
+}
+
+void ParallelContractExecution::NoteExecuted(const dev::eth::StateAccessLog& access)
+{
+    writtenInBlock += access.written;
+    nExecuted++;
+}
@@ -0,0 +1,108 @@
+#ifndef FASCPARALLEL_H
+#define FASCPARALLEL_H
+
+#include <fasc/fascpreexec.h>
+
+#include <map>
+#include <memory>
+
+class CBlock;
+class CCoinsViewCache;
+class ByteCodeExec;
+
+namespace dev { namespace eth { class ChainParams; } }
+
+static const bool DEFAULT_PARALLEL_CONTRACTS = false;
+
+/** Whether ConnectBlock executes independent contract transactions in parallel (-parallelcontracts). */
+extern bool fParallelContracts;
+
+/** One contract transaction executed ahead of time on its own view of the block's starting state. */
+struct ParallelContractSlot {
+    std::vector<FascTransaction> txs;
+    std::unique_ptr<FascState> state;
+    std::unique_ptr<dev::eth::SealEngineFace> sealEngine;
+    std::shared_ptr<ContractExecutionRecord> record;    //<- null if the execution could not be made
+};
+
+/** A job for the contract check queue: executes the transaction of one slot. */
+class CContractCheck
+{
+private:
+    ParallelContractSlot* slot;
+    const dev::eth::EnvInfo* envInfo;
+    uint256 hashTip;
+
+public:
+    CContractCheck() : slot(nullptr), envInfo(nullptr) {}
+    CContractCheck(ParallelContractSlot* _slot, const dev::eth::EnvInfo* _envInfo, const uint256& _hashTip) :
+        slot(_slot), envInfo(_envInfo), hashTip(_hashTip) {}
+
+    bool operator()(std::stringstream* commentsOnFailureNullForNone);
+
+    void swap(CContractCheck& check) {
+        std::swap(slot, check.slot);
+        std::swap(envInfo, check.envInfo);
+        std::swap(hashTip, check.hashTip);
+    }
+};
+
+/**
+ * Optimistic parallel execution of the contract transactions of a block.
+ *
+ * Before the transactions of a block are connected, every transaction with a single
+ * contract output is executed on the contract check queue, each on a private view of
+ * the state at the start of the block, recording which accounts it looked at and wrote.
+ * ConnectBlock then processes the block in order exactly as before. When ByteCodeExec
+ * reaches a transaction whose accounts still have the values they had at the start of
+ * the block, its writes are copied into globalState instead of executing it again;
+ * otherwise it is executed sequentially as usual.
+ *
+ * An execution only depends on the values it read, so this yields the same results, and
+ * since the tries are canonical the same roots, as sequential execution. Receipts are
+ * rewritten to carry the roots of globalState.
+ */
+class ParallelContractExecution {
+public:
+    /** Requires globalState to be at the state the block starts from. */
+    ParallelContractExecution(const CBlock& block, const dev::u256& blockGasLimit, const dev::eth::EVMSchedule& schedule);
+    ~ParallelContractExecution();
+
+    /** Add every eligible transaction of the block; requires cs_main. */
+    void AddCandidates(CCoinsViewCache& view);
+    void AddCandidate(const uint256& hashTx, const std::vector<FascTransaction>& txs);
+
+    /** Execute the candidates on the contract check queue; requires cs_main. */
+    void Run();
+
+    /**
+     * Apply the speculative execution of txs to globalState if nothing it read has been
+     * changed by the transactions before it, and write its comments. Requires cs_main.
+     */
+    bool Apply(const std::vector<FascTransaction>& txs, std::vector<ResultExecute>& resultOut, std::stringstream* commentsNullForNone = nullptr);
+
+    /** Account for the writes of a transaction that was executed on globalState. */
+    void NoteExecuted(const dev::eth::StateAccessLog& access);
+
+    int AppliedCount() const { return nApplied; }
+
+private:
+    bool Conflicts(const dev::eth::StateAccessLog& access) const;
+    bool Changed(const dev::Address& addr) const;
+
+    const CBlock& block;
+    dev::eth::EVMSchedule schedule;
+    std::unique_ptr<ByteCodeExec> envExec;          //<- owns the last hashes referenced by envInfo
+    std::unique_ptr<dev::eth::EnvInfo> envInfo;
+    std::unique_ptr<dev::eth::ChainParams> chainParams;
+    std::unique_ptr<FascState> baseState;           //<- the state at the start of the block
+    uint256 hashTip;
+    std::map<uint256, std::unique_ptr<ParallelContractSlot> > slots;
+    dev::AddressHash writtenInBlock;
+    int nApplied;
+    int nExecuted;
+};
+
+void ThreadContractCheck();
+
+#endif // FASCPARALLEL_H
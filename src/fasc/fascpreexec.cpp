@@ -0,0 +1,365 @@
+#include <fasc/fascpreexec.h>
+#include <fasc/fascDGP.h>
+#include <fasc/fascstateimport.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <timedata.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+#include <libethereum/ChainParams.h>
+
+std::unique_ptr<ContractPreExecutor> pcontractPreExecutor;
+
+namespace {
+
+/** Opcode tracer noting whether an execution depended on the block environment. */
+struct EnvOpcodeTracer {
+    bool* fTraced;
+    bool* fEnvUsed;
+
+    void operator()(uint64_t, uint64_t, dev::eth::Instruction inst, dev::bigint, dev::bigint,
+                    dev::bigint, dev::eth::VMFace const*, dev::eth::ExtVMFace const*) const {
+        *fTraced = true;
+        if (inst == dev::eth::Instruction::TIMESTAMP ||
+            inst == dev::eth::Instruction::COINBASE ||
+            inst == dev::eth::Instruction::DIFFICULTY) {
+            *fEnvUsed = true;
+        }
+    }
+};
+
+dev::h256 RecordKey(const dev::h256& txsFingerprint, const dev::h256& stateRoot, const dev::h256& utxoRoot)
+{
+    dev::RLPStream s(3);
+    s << txsFingerprint << stateRoot << utxoRoot;
+    return dev::sha3(s.out());
+}
+
+}
+
+ContractExecutionRecorder::ContractExecutionRecorder(FascState& _state, const std::vector<FascTransaction>& txs, const dev::eth::EnvInfo& envInfo, const uint256& hashTip) :
+    state(_state), record(std::make_shared<ContractExecutionRecord>()), fEnvUsed(false)
+{
+    record->hashTip = hashTip;
+    if (!txs.empty()) {
+        record->hashTx = h256Touint(txs.front().getHashWith());
+    }
+    record->txsFingerprint = ContractPreExecutor::Fingerprint(txs);
+    record->preStateRoot = state.rootHash();
+    record->preUTXORoot = state.rootHashUTXO();
+    record->gasLimit = dev::u256(envInfo.gasLimit());
+    record->timestamp = dev::u256(envInfo.timestamp());
+    record->difficulty = envInfo.difficulty();
+    record->author = envInfo.author();
+    state.setAccessLog(&record->access);
+}
+
+ContractExecutionRecorder::~ContractExecutionRecorder()
+{
+    state.setAccessLog(nullptr);
+}
+
+OnOpFunc ContractExecutionRecorder::Tracer()
+{
+    return EnvOpcodeTracer{&record->fTraced, &fEnvUsed};
+}
+
+std::shared_ptr<ContractExecutionRecord> ContractExecutionRecorder::Finish(const std::vector<ResultExecute>& results, const std::string& comments)
+{
+    state.setAccessLog(nullptr);
+    record->postStateRoot = state.rootHash();
+    record->postUTXORoot = state.rootHashUTXO();
+    // ResultExecute is copy constructible but not assignable
+    record->results = std::vector<ResultExecute>(results);
+    record->comments = comments;
+    // If the VM never reported an opcode (tracing compiled out, or nothing but value transfers)
+    // we can't tell what was read, so require an identical environment.
+    record->fEnvDependent = fEnvUsed || !record->fTraced;
+    return record;
+}
+
+ContractPreExecutor::ContractPreExecutor() : nHits(0), nMisses(0), fInterrupt(false)
+{
+    dev::eth::ChainParams cp(Params().EVMGenesisInfo());
+    speculativeSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
+}
+
+ContractPreExecutor::~ContractPreExecutor()
+{
+}
+
+dev::h256 ContractPreExecutor::Fingerprint(const std::vector<FascTransaction>& txs)
+{
+    dev::RLPStream s(txs.size());
+    for (const FascTransaction& tx : txs) {
+        s.appendList(10);
+        s << (tx.isCreation() ? 1 : 0) << tx.receiveAddress() << tx.sender() << tx.value() << tx.gas() << tx.gasPrice();
+        s << tx.data() << tx.getHashWith() << tx.getNVout() << tx.getVersion().toRaw();
+    }
+    return dev::sha3(s.out());
+}
+
+std::shared_ptr<const ContractExecutionRecord> ContractPreExecutor::Reuse(const std::vector<FascTransaction>& txs, const dev::eth::EnvInfo& envInfo)
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<const ContractExecutionRecord> record;
+    {
+        LOCK(cs_records);
+        if (chainActive.Tip() == nullptr || hashRecordsTip != chainActive.Tip()->GetBlockHash()) {
+            return nullptr;
+        }
+        auto it = records.find(RecordKey(Fingerprint(txs), globalState->rootHash(), globalState->rootHashUTXO()));
+        if (it == records.end()) {
+            nMisses++;
+            return nullptr;
+        }
+        record = it->second;
+    }
+
+    bool fReusable = record->gasLimit == dev::u256(envInfo.gasLimit());
+    if (fReusable && record->fEnvDependent) {
+        fReusable = record->timestamp == dev::u256(envInfo.timestamp()) &&
+                    record->difficulty == envInfo.difficulty() &&
+                    record->author == envInfo.author();
+    }
+    if (fReusable && record->author != envInfo.author()) {
+        // The author only receives the fees and is deleted again right after, which leaves no
+        // trace unless it had an account or a UTXO, or the contract itself looked at it.
+        const dev::Address& author = envInfo.author();
+        fReusable = record->fAuthorInert && !record->access.addresses.count(author) &&
+                    !globalState->addressInUse(author) && !globalState->addressHasUTXO(author);
+    }
+
+    if (fReusable && record->overlay) {
+        // The overlay may be the state the worker is still executing on.
+        LOCK(cs_speculative);
+        std::string error;
+        if (!CopyMissingContractState(record->overlay->db(), record->overlay->dbUtxo(), record->postStateRoot, record->postUTXORoot,
+                                      globalState->db(), globalState->dbUtxo(), error)) {
+            LogPrint(BCLog::BENCH, "%s: the state of %s can't be reused: %s\n", __func__, record->hashTx.ToString(), error);
+            fReusable = false;
+        }
+    }
+
+    LOCK(cs_records);
+    if (!fReusable) {
+        nMisses++;
+        return nullptr;
+    }
+    nHits++;
+    return record;
+}
+
+void ContractPreExecutor::Record(const std::shared_ptr<ContractExecutionRecord>& record)
+{
+    LOCK(cs_records);
+    if (record->hashTip != hashRecordsTip) {
+        records.clear();
+        recordsByTx.clear();
+        hashRecordsTip = record->hashTip;
+    }
+    if (records.size() >= MAX_CONTRACT_PREEXEC_RECORDS) {
+        return;
+    }
+    dev::h256 key = RecordKey(record->txsFingerprint, record->preStateRoot, record->preUTXORoot);
+    records[key] = record;
+    recordsByTx[record->hashTx] = key;
+}
+
+bool ContractPreExecutor::GetAccessSet(const uint256& hashTx, dev::eth::StateAccessLog& accessOut)
+{
+    LOCK(cs_records);
+    auto itTx = recordsByTx.find(hashTx);
+    if (itTx == recordsByTx.end()) {
+        return false;
+    }
+    auto it = records.find(itTx->second);
+    if (it == records.end()) {
+        return false;
+    }
+    accessOut = it->second->access;
+    return true;
+}
+
+void ContractPreExecutor::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    {
+        LOCK(cs_records);
+        if (nHits + nMisses > 0) {
+            LogPrint(BCLog::BENCH, "    - Contract pre-execution: %d reused, %d executed\n", nHits, nMisses);
+        }
+        nHits = 0;
+        nMisses = 0;
+    }
+
+    std::deque<CTransactionRef> pending;
+    if (!fInitialDownload) {
+        LOCK(mempool.cs);
+        auto& index = mempool.mapTx.get<ancestor_score_or_gas_price>();
+        for (auto mi = index.begin(); mi != index.end() && pending.size() < MAX_CONTRACT_PREEXEC_QUEUE; ++mi) {
+            if (mi->GetTx().HasCreateOrCallInOutputs()) {
+                pending.push_back(mi->GetSharedTx());
+            }
+        }
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    queue.swap(pending);
+    condQueue.notify_one();
+}
+
+void ContractPreExecutor::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    if (!ptx->HasCreateOrCallInOutputs() || IsInitialBlockDownload()) {
+        return;
+    }
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    if (queue.size() < MAX_CONTRACT_PREEXEC_QUEUE) {
+        queue.push_back(ptx);
+        condQueue.notify_one();
+    }
+}
+
+void ContractPreExecutor::Interrupt()
+{
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    fInterrupt = true;
+    condQueue.notify_all();
+}
+
+bool ContractPreExecutor::PrepareSpeculativeState()
+{
+    LOCK(cs_main);
+    CBlockIndex* tip = chainActive.Tip();
+    if (tip == nullptr || !globalState || tip->nHeight < Params().ContractReuseHeight()) {
+        return false;
+    }
+    if (speculativeState && tip->GetBlockHash() == hashSpeculativeTip) {
+        return true;
+    }
+
+    // Start a fresh view of the tip state, reading from the databases of globalState.
+    speculativeState = std::make_shared<FascState>(dev::u256(0), globalState->db(), globalState->dbUtxo());
+    speculativeState->setRoot(globalState->rootHash());
+    speculativeState->setRootUTXO(globalState->rootHashUTXO());
+    hashSpeculativeTip = tip->GetBlockHash();
+
+    FascDGP fascDGP(globalState.get(), fGettingValuesDGP);
+    speculativeSealEngine->setFascSchedule(fascDGP.getGasSchedule(tip->nHeight + 1));
+
+    // The timestamp, difficulty and author of the next block are guesses; executions that
+    // read them are only reused when the real block turns out to match.
+    CBlockHeader nextHeader;
+    nextHeader.nTime = std::max<int64_t>(tip->GetMedianTimePast() + 1, GetAdjustedTime());
+    speculativeHeader = dev::eth::BlockHeader();
+    speculativeHeader.setNumber(tip->nHeight + 1);
+    speculativeHeader.setTimestamp(nextHeader.nTime);
+    speculativeHeader.setDifficulty(dev::u256(GetNextWorkRequired(tip, &nextHeader, Params().GetConsensus())));
+    speculativeHeader.setGasLimit(fascDGP.getBlockGasLimit(tip->nHeight + 1));
+    speculativeHeader.setAuthor(dev::Address());
+
+    speculativeLastHashes.reset(new LastHashes());
+    speculativeLastHashes->set(tip);
+    return true;
+}
+
+void ContractPreExecutor::ExecuteSpeculatively(const CTransactionRef& ptx)
+{
+    if (!PrepareSpeculativeState()) {
+        return;
+    }
+    {
+        // The overlay keeps everything executed on this tip: stop once no more records can be kept.
+        LOCK(cs_records);
+        if (hashRecordsTip == hashSpeculativeTip && records.size() >= MAX_CONTRACT_PREEXEC_RECORDS) {
+            return;
+        }
+    }
+
+    ExtractFascTX resultConvert;
+    {
+        LOCK(cs_main);
+        // The transaction will be requeued together with the rest of the mempool for the new tip.
+        if (chainActive.Tip()->GetBlockHash() != hashSpeculativeTip || !mempool.exists(ptx->GetHash())) {
+            return;
+        }
+        FascTxConverter convert(*ptx, nullptr, nullptr);
+        dev::u256 gasLoanNotUsed;
+        if (!convert.extractionFascTransactions(resultConvert, gasLoanNotUsed, nullptr)) {
+            return;
+        }
+    }
+    const std::vector<FascTransaction>& txs = resultConvert.first;
+    if (txs.empty()) {
+        return;
+    }
+    for (const FascTransaction& tx : txs) {
+        if (tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()) {
+            return;
+        }
+    }
+
+    // Keeps Reuse from reading the overlay while it is written; never take cs_main under it.
+    LOCK(cs_speculative);
+    dev::u256 gasUsed;
+    dev::eth::EnvInfo envInfo(speculativeHeader, *speculativeLastHashes, gasUsed, speculativeSealEngine->chainParams().chainID);
+    bool fAuthorInert = !speculativeState->addressInUse(envInfo.author()) && !speculativeState->addressHasUTXO(envInfo.author());
+
+    std::vector<ResultExecute> results;
+    std::stringstream comments;
+    std::shared_ptr<ContractExecutionRecord> record;
+    try {
+        // Mirrors ByteCodeExec::performByteCode, except that the overlay is never committed.
+        ContractExecutionRecorder recorder(*speculativeState, txs, envInfo, hashSpeculativeTip);
+        recorder.Record().fAuthorInert = fAuthorInert;
+        for (const FascTransaction& tx : txs) {
+            if (!tx.isCreation() && !speculativeState->addressInUse(tx.receiveAddress())) {
+                dev::eth::ExecutionResult execRes;
+                execRes.excepted = dev::eth::TransactionException::Unknown;
+                results.push_back(ResultExecute{execRes, FascTransactionReceipt(dev::h256(), dev::u256(), dev::u256(), dev::eth::LogEntries()), CTransaction()});
+                continue;
+            }
+            results.push_back(speculativeState->execute(envInfo, *speculativeSealEngine, tx, dev::eth::Permanence::Committed, recorder.Tracer(), &comments));
+        }
+        speculativeSealEngine->deleteAddresses.clear();
+        record = recorder.Finish(results, comments.str());
+        record->overlay = speculativeState;
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::BENCH, "%s: speculative execution of %s failed: %s\n", __func__, ptx->GetHash().ToString(), e.what());
+        speculativeState.reset();
+        speculativeSealEngine->deleteAddresses.clear();
+        return;
+    }
+    Record(record);
+}
+
+void ContractPreExecutor::ThreadMain()
+{
+    while (true) {
+        CTransactionRef ptx;
+        {
+            boost::unique_lock<boost::mutex> lock(mutexQueue);
+            while (queue.empty() && !fInterrupt) {
+                condQueue.wait(lock);
+            }
+            if (fInterrupt) {
+                return;
+            }
+            ptx = queue.front();
+            queue.pop_front();
+        }
+        ExecuteSpeculatively(ptx);
+    }
+}
+
+void ThreadContractPreExecution()
+{
+    if (pcontractPreExecutor) {
+        pcontractPreExecutor->ThreadMain();
+    }
+}
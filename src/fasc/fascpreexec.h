@@ -0,0 +1,148 @@
+#ifndef FASCPREEXEC_H
+#define FASCPREEXEC_H
+
+#include <fasc/fascstate.h>
+#include <validationinterface.h>
+#include <sync.h>
+
+#include <libethcore/BlockHeader.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <deque>
+#include <map>
+#include <memory>
+
+class CBlockIndex;
+class LastHashes;
+
+static const bool DEFAULT_CONTRACT_PREEXEC = false;
+/** Maximum number of executions remembered for one chain tip. */
+static const unsigned int MAX_CONTRACT_PREEXEC_RECORDS = 5000;
+/** Maximum number of mempool transactions waiting for speculative execution. */
+static const unsigned int MAX_CONTRACT_PREEXEC_QUEUE = 10000;
+
+/**
+ * The outcome of executing the contract outputs of one transaction on top of
+ * a known state, together with everything that outcome depended on.
+ * It may be reused instead of running the EVM again whenever the same transaction
+ * is executed on the same chain tip, starting from the same state roots, with a
+ * compatible block environment.
+ */
+struct ContractExecutionRecord {
+    uint256 hashTip;                        //<- chain tip the execution was made on top of
+    uint256 hashTx;
+    dev::h256 txsFingerprint;               //<- see ContractPreExecutor::Fingerprint
+    dev::h256 preStateRoot;
+    dev::h256 preUTXORoot;
+    dev::h256 postStateRoot;
+    dev::h256 postUTXORoot;
+    dev::u256 gasLimit;
+    dev::u256 timestamp;
+    dev::u256 difficulty;
+    dev::Address author;
+    bool fTraced;                           //<- at least one opcode was reported by the VM
+    bool fEnvDependent;                     //<- TIMESTAMP, COINBASE or DIFFICULTY was executed, or we can't tell
+    bool fAuthorInert;                      //<- author had neither an account nor a UTXO before the execution
+    dev::eth::StateAccessLog access;        //<- read/write set
+    std::vector<ResultExecute> results;
+    std::string comments;                   //<- what the executions wrote to commentsOnFailure
+    std::shared_ptr<const FascState> overlay; //<- private state holding the post state's new nodes, null if they were committed
+
+    ContractExecutionRecord() : fTraced(false), fEnvDependent(true), fAuthorInert(false) {}
+};
+
+/**
+ * Records one ByteCodeExec-like run of txs on a FascState: attaches an access log to
+ * the state for the lifetime of the recorder and provides the opcode tracer that
+ * detects use of the block environment.
+ */
+class ContractExecutionRecorder {
+public:
+    ContractExecutionRecorder(FascState& _state, const std::vector<FascTransaction>& txs, const dev::eth::EnvInfo& envInfo, const uint256& hashTip);
+    ~ContractExecutionRecorder();
+
+    ContractExecutionRecorder(const ContractExecutionRecorder&) = delete;
+    ContractExecutionRecorder& operator=(const ContractExecutionRecorder&) = delete;
+
+    OnOpFunc Tracer();
+
+    /** Detach from the state and complete the record with the post state, results and comments. */
+    std::shared_ptr<ContractExecutionRecord> Finish(const std::vector<ResultExecute>& results, const std::string& comments);
+
+    ContractExecutionRecord& Record() { return *record; }
+
+private:
+    FascState& state;
+    std::shared_ptr<ContractExecutionRecord> record;
+    bool fEnvUsed;
+};
+
+/**
+ * Runs contract transactions from the mempool on a background thread against the
+ * current tip state, and remembers the results of contract executions so that
+ * ByteCodeExec (used by both ConnectBlock and the BlockAssembler) can skip the EVM
+ * when a transaction is executed again under identical conditions.
+ *
+ * Speculative executions are chained in the order the BlockAssembler picks
+ * transactions: each one runs on top of the state left by the previous one. They
+ * stay in the overlay of a private state that is dropped with the tip; the nodes
+ * of an execution are only copied to globalState when it is reused.
+ */
+class ContractPreExecutor : public CValidationInterface {
+public:
+    ContractPreExecutor();
+    ~ContractPreExecutor();
+
+    /**
+     * Look up a reusable execution of txs on top of the current globalState, and make its post
+     * state reachable from globalState; requires cs_main.
+     */
+    std::shared_ptr<const ContractExecutionRecord> Reuse(const std::vector<FascTransaction>& txs, const dev::eth::EnvInfo& envInfo);
+    /** Remember a finished execution. */
+    void Record(const std::shared_ptr<ContractExecutionRecord>& record);
+    /** Fetch the read/write set of a known execution of the transaction on the current tip. */
+    bool GetAccessSet(const uint256& hashTx, dev::eth::StateAccessLog& accessOut);
+
+    void ThreadMain();
+    void Interrupt();
+
+    static dev::h256 Fingerprint(const std::vector<FascTransaction>& txs);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& ptxn) override;
+
+private:
+    bool PrepareSpeculativeState();
+    void ExecuteSpeculatively(const CTransactionRef& ptx);
+
+    CCriticalSection cs_records;
+    uint256 hashRecordsTip;
+    std::map<dev::h256, std::shared_ptr<ContractExecutionRecord> > records; //<- by fingerprint and pre roots
+    std::map<uint256, dev::h256> recordsByTx;
+    int64_t nHits;
+    int64_t nMisses;
+
+    boost::mutex mutexQueue;
+    boost::condition_variable condQueue;
+    std::deque<CTransactionRef> queue;
+    bool fInterrupt;
+
+    // Only touched by the worker thread, except that records share the state for their nodes:
+    // executing on it and copying nodes out of it in Reuse both hold cs_speculative.
+    CCriticalSection cs_speculative;
+    std::shared_ptr<FascState> speculativeState;
+    std::unique_ptr<dev::eth::SealEngineFace> speculativeSealEngine;
+    uint256 hashSpeculativeTip;
+    dev::eth::BlockHeader speculativeHeader;
+    std::unique_ptr<LastHashes> speculativeLastHashes;
+};
+
+/** Non-null when -contractpreexec is set. */
+extern std::unique_ptr<ContractPreExecutor> pcontractPreExecutor;
+
+void ThreadContractPreExecution();
+
+#endif // FASCPREEXEC_H
@@ -0,0 +1,181 @@
+#include <fasc/fascprefetch.h>
+#include <fasc/fascpreexec.h>
+#include <fasc/fascsnapshot.h>
+#include <fasc/fascstate.h>
+#include <coins.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <map>
+#include <set>
+
+std::unique_ptr<ContractStatePrefetcher> pcontractPrefetcher;
+
+ContractStatePrefetcher::ContractStatePrefetcher() : fInterrupt(false)
+{
+}
+
+void ContractStatePrefetcher::Prefetch(const CBlockHeader& header, const std::vector<CTransactionRef>& txs)
+{
+    Job job;
+    job.hashBlock = header.GetHash();
+    job.hashPrevBlock = header.hashPrevBlock;
+    for (const CTransactionRef& ptx : txs) {
+        if (ptx && ptx->HasCreateOrCallInOutputs()) {
+            job.txs.push_back(ptx);
+        }
+    }
+    if (job.txs.empty()) {
+        return;
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    // The newest blocks are the ones about to be connected.
+    if (queue.size() >= MAX_CONTRACT_PREFETCH_QUEUE) {
+        queue.pop_front();
+    }
+    queue.push_back(std::move(job));
+    condQueue.notify_one();
+}
+
+void ContractStatePrefetcher::Interrupt()
+{
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    fInterrupt = true;
+    condQueue.notify_all();
+}
+
+std::vector<uint256> ContractStatePrefetcher::QueuedBlocks()
+{
+    boost::unique_lock<boost::mutex> lock(mutexQueue);
+    std::vector<uint256> hashes;
+    for (const Job& job : queue) {
+        hashes.push_back(job.hashBlock);
+    }
+    return hashes;
+}
+
+bool ContractStatePrefetcher::PrefetchBlock(const Job& job)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    // The senders are the owners of the first inputs: their coins are copied into view, so that
+    // the transactions can be converted without cs_main, and without looking them up on disk.
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    std::unique_ptr<FascState> state;
+    {
+        LOCK2(cs_main, mempool.cs);
+        if (!globalState || chainActive.Tip() == nullptr || chainActive.Tip()->GetBlockHash() != job.hashPrevBlock) {
+            return false;
+        }
+        CCoinsViewMemPool viewMemPool(pcoinsTip, mempool);
+        view.SetBackend(viewMemPool);
+        for (const CTransactionRef& ptx : job.txs) {
+            if (!ptx->vin.empty()) {
+                view.AccessCoin(ptx->vin[0].prevout);
+            }
+        }
+        view.SetBackend(viewDummy);
+
+        // A fresh view of the tip state, sharing the databases of globalState.
+        state.reset(new FascState(dev::u256(0), globalState->db(), globalState->dbUtxo()));
+        state->setRoot(globalState->rootHash());
+        state->setRootUTXO(globalState->rootHashUTXO());
+        if (pstateSnapshot) {
+            state->setFlatStateReader(pstateSnapshot.get());
+        }
+    }
+
+    // The slots read of every account the block is expected to touch.
+    std::map<dev::Address, std::set<dev::u256> > touched;
+    size_t nReadSets = 0;
+    for (const CTransactionRef& ptx : job.txs) {
+        dev::eth::StateAccessLog access;
+        if (pcontractPreExecutor && pcontractPreExecutor->GetAccessSet(ptx->GetHash(), access)) {
+            for (const dev::Address& address : access.addresses) {
+                touched[address];
+            }
+            for (const std::pair<dev::Address, dev::u256>& slot : access.storage) {
+                touched[slot.first].insert(slot.second);
+            }
+            nReadSets++;
+            continue;
+        }
+        ExtractFascTX resultConvert;
+        FascTxConverter convert(*ptx, &view, &job.txs);
+        dev::u256 gasLoanNotUsed;
+        if (!convert.extractionFascTransactions(resultConvert, gasLoanNotUsed, nullptr)) {
+            continue;
+        }
+        for (const FascTransaction& tx : resultConvert.first) {
+            touched[tx.sender()];
+            if (!tx.isCreation()) {
+                touched[tx.receiveAddress()];
+            }
+        }
+    }
+
+    size_t nAccounts = 0;
+    size_t nSlots = 0;
+    try {
+        for (const auto& entry : touched) {
+            const dev::Address& address = entry.first;
+            state->addressHasUTXO(address);
+            if (!state->addressInUse(address)) {
+                continue;
+            }
+            state->code(address);
+            for (const dev::u256& key : entry.second) {
+                state->storage(address, key);
+            }
+            nAccounts++;
+            nSlots += entry.second.size();
+        }
+    } catch (const std::exception& e) {
+        LogPrint(BCLog::BENCH, "%s: prefetching the contract state of block %s failed: %s\n", __func__, job.hashBlock.ToString(), e.what());
+        return false;
+    }
+    LogPrint(BCLog::BENCH, "    - Contract state prefetch of block %s: %u accounts (%u read sets), %u slots in %.2fms\n",
+             job.hashBlock.ToString(), nAccounts, nReadSets, nSlots, (GetTimeMicros() - nTimeStart) * 0.001);
+    return true;
+}
+
+bool ContractStatePrefetcher::PrefetchNext()
+{
+    Job job;
+    {
+        boost::unique_lock<boost::mutex> lock(mutexQueue);
+        if (queue.empty()) {
+            return false;
+        }
+        job = std::move(queue.front());
+        queue.pop_front();
+    }
+    return PrefetchBlock(job);
+}
+
+void ContractStatePrefetcher::ThreadMain()
+{
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutexQueue);
+            while (queue.empty() && !fInterrupt) {
+                condQueue.wait(lock);
+            }
+            if (fInterrupt) {
+                return;
+            }
+        }
+        PrefetchNext();
+    }
+}
+
+void ThreadContractPrefetch()
+{
+    if (pcontractPrefetcher) {
+        pcontractPrefetcher->ThreadMain();
+    }
+}
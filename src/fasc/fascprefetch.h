@@ -0,0 +1,68 @@
+#ifndef FASCPREFETCH_H
+#define FASCPREFETCH_H
+
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+static const bool DEFAULT_CONTRACT_PREFETCH = true;
+/** Maximum number of blocks waiting for their contract state to be prefetched. */
+static const unsigned int MAX_CONTRACT_PREFETCH_QUEUE = 8;
+
+/**
+ * Reads the contract state a block being reconstructed from a compact block is
+ * going to touch, on a background thread, while its missing transactions are
+ * still being requested. The reads go through a private FascState view of the
+ * tip state sharing the databases of globalState, so that ConnectBlock finds the
+ * trie nodes, code and snapshot entries in the database and OS caches instead of
+ * on disk. Nothing is written, and the view is dropped after every block. Blocks
+ * that don't build on the tip by the time their turn comes are skipped.
+ *
+ * The accounts and storage slots come from the read set of a speculative
+ * execution (-contractpreexec) when there is one, otherwise only the senders and
+ * receivers of the contract outputs, with their code, are read.
+ */
+class ContractStatePrefetcher {
+public:
+    ContractStatePrefetcher();
+
+    /** Queue the contract transactions known so far of the block with @a header; the others are ignored. */
+    void Prefetch(const CBlockHeader& header, const std::vector<CTransactionRef>& txs);
+
+    /** Hashes of the blocks waiting to be prefetched, oldest first. */
+    std::vector<uint256> QueuedBlocks();
+
+    /** Prefetch the oldest queued block; false if there was none, or it doesn't build on the tip. */
+    bool PrefetchNext();
+
+    void ThreadMain();
+    void Interrupt();
+
+private:
+    struct Job {
+        uint256 hashBlock;
+        uint256 hashPrevBlock;
+        std::vector<CTransactionRef> txs;
+    };
+
+    bool PrefetchBlock(const Job& job);
+
+    boost::mutex mutexQueue;
+    boost::condition_variable condQueue;
+    std::deque<Job> queue;
+    bool fInterrupt;
+};
+
+/** Non-null when -contractprefetch is set. */
+extern std::unique_ptr<ContractStatePrefetcher> pcontractPrefetcher;
+
+void ThreadContractPrefetch();
+
+#endif // FASCPREFETCH_H
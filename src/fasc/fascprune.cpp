@@ -0,0 +1,260 @@
+#include <fasc/fascprune.h>
+#include <fasc/fascstateimport.h>
+#include <chain.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieDB.h>
+
+#include <boost/thread.hpp>
+
+unsigned int nPruneStateDepth = DEFAULT_PRUNE_STATE;
+std::unique_ptr<StatePruner> pstatePruner;
+
+/** Nodes deleted per write batch. */
+static const size_t STATE_PRUNE_BATCH = 10000;
+
+namespace {
+
+/** Marks the nodes reachable from a set of trie roots, reading from a database snapshot. */
+class TrieNodeMarker {
+public:
+    TrieNodeMarker(ldb::DB* _db, const ldb::Snapshot* snapshot) : nMissing(0), db(_db) {
+        options.snapshot = snapshot;
+        options.fill_cache = false;
+        marked.insert(dev::EmptyTrie);
+    }
+
+    void MarkTrie(const dev::h256& root, bool fAccountTrie) {
+        pending.emplace_back(root, fAccountTrie);
+        while (!pending.empty()) {
+            std::pair<dev::h256, bool> next = pending.back();
+            pending.pop_back();
+            if (!marked.insert(next.first).second)
+                continue;
+            std::string node;
+            if (!db->Get(options, ldb::Slice((const char*)next.first.data(), next.first.size), &node).ok()) {
+                nMissing++;
+                continue;
+            }
+            VisitNode(dev::RLP(node), next.second);
+            if (marked.size() % 10000 == 0)
+                boost::this_thread::interruption_point();
+        }
+    }
+
+    dev::h256Hash marked;
+    size_t nMissing;
+
+private:
+    void VisitNode(const dev::RLP& node, bool fAccountTrie) {
+        if (node.isList() && node.itemCount() == 17) {
+            for (unsigned i = 0; i < 16; i++)
+                VisitChild(node[i], fAccountTrie);
+            if (!node[16].isEmpty())
+                VisitValue(node[16].payload(), fAccountTrie);
+        } else if (node.isList() && node.itemCount() == 2) {
+            // The hex prefix of a leaf has the terminator flag set.
+            dev::bytesConstRef prefix = node[0].payload();
+            if (prefix.size() && (prefix[0] & 0x20))
+                VisitValue(node[1].payload(), fAccountTrie);
+            else
+                VisitChild(node[1], fAccountTrie);
+        }
+    }
+
+    void VisitChild(const dev::RLP& child, bool fAccountTrie) {
+        if (child.isList())
+            VisitNode(child, fAccountTrie);             // nodes under 32 bytes are inlined in their parent
+        else if (child.size() == 32)
+            pending.emplace_back(child.toHash<dev::h256>(), fAccountTrie);
+    }
+
+    void VisitValue(dev::bytesConstRef value, bool fAccountTrie) {
+        if (!fAccountTrie)
+            return;
+        // An account: nonce, balance, storage root and code hash.
+        dev::RLP account(value);
+        if (!account.isList() || account.itemCount() < 4)
+            return;
+        dev::h256 storageRoot = account[2].toHash<dev::h256>();
+        if (storageRoot != dev::EmptyTrie)
+            pending.emplace_back(storageRoot, false);
+        dev::h256 codeHash = account[3].toHash<dev::h256>();
+        if (codeHash != dev::EmptySHA3)
+            marked.insert(codeHash);
+    }
+
+    ldb::DB* db;
+    ldb::ReadOptions options;
+    std::vector<std::pair<dev::h256, bool> > pending;
+};
+
+/** Stops the recording of written nodes and releases the snapshots when a collection ends, however it ends. */
+class CollectionScope {
+public:
+    CollectionScope(std::mutex& _mutex, std::map<ldb::DB const*, dev::h256Hash>& _written) : mutex(_mutex), written(_written) {}
+    ~CollectionScope() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written.clear();
+        }
+        for (const std::pair<ldb::DB*, const ldb::Snapshot*>& snapshot : snapshots)
+            snapshot.first->ReleaseSnapshot(snapshot.second);
+    }
+
+    const ldb::Snapshot* Begin(ldb::DB* db) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written[db];
+        }
+        // Tracking starts before the snapshot is taken, so every node is in one or the other.
+        snapshots.emplace_back(db, db->GetSnapshot());
+        return snapshots.back().second;
+    }
+
+private:
+    std::mutex& mutex;
+    std::map<ldb::DB const*, dev::h256Hash>& written;
+    std::vector<std::pair<ldb::DB*, const ldb::Snapshot*> > snapshots;
+};
+
+}
+
+StatePruner::StatePruner(unsigned int _nDepth) : nDepth(_nDepth)
+{
+    // Count from the tip rather than scanning the whole database at every start.
+    LOCK(cs_main);
+    nLastCollectedHeight = std::max(0, chainActive.Height());
+}
+
+void StatePruner::nodesWritten(ldb::DB const* db, std::vector<dev::h256> const& keys)
+{
+    std::lock_guard<std::mutex> lock(mutexWritten);
+    auto it = written.find(db);
+    if (it != written.end())
+        it->second.insert(keys.begin(), keys.end());
+}
+
+size_t StatePruner::DeleteNodes(ldb::DB* db, std::vector<dev::h256>& keys)
+{
+    size_t nDeleted = 0;
+    ldb::WriteBatch batch;
+    // Hold the lock while writing, so no node can be reported written between the check and the delete.
+    std::lock_guard<std::mutex> lock(mutexWritten);
+    const dev::h256Hash& writtenDB = written[db];
+    for (const dev::h256& key : keys) {
+        if (writtenDB.count(key))
+            continue;
+        batch.Delete(ldb::Slice((const char*)key.data(), key.size));
+        nDeleted++;
+    }
+    ldb::Status status = db->Write(ldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LogPrintf("%s: failed to delete state nodes: %s\n", __func__, status.ToString());
+        nDeleted = 0;
+    }
+    keys.clear();
+    return nDeleted;
+}
+
+size_t StatePruner::CollectDB(ldb::DB* db, const ldb::Snapshot* snapshot, const std::set<dev::h256>& roots, bool fAccounts)
+{
+    TrieNodeMarker marker(db, snapshot);
+    for (const dev::h256& root : roots)
+        marker.MarkTrie(root, fAccounts);
+    if (marker.nMissing)
+        LogPrint(BCLog::PRUNE, "%s: %u nodes reachable from the kept roots are missing\n", __func__, marker.nMissing);
+
+    // Keys of other sizes are aux entries (the preimages of hashed trie keys): keep them.
+    ldb::ReadOptions options;
+    options.snapshot = snapshot;
+    options.fill_cache = false;
+    std::unique_ptr<ldb::Iterator> it(db->NewIterator(options));
+    std::vector<dev::h256> candidates;
+    size_t nDeleted = 0;
+    size_t nScanned = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (++nScanned % STATE_PRUNE_BATCH == 0)
+            boost::this_thread::interruption_point();
+        ldb::Slice key = it->key();
+        if (key.size() != 32)
+            continue;
+        dev::h256 hash((const uint8_t*)key.data(), dev::h256::ConstructFromPointer);
+        if (marker.marked.count(hash))
+            continue;
+        candidates.push_back(hash);
+        if (candidates.size() >= STATE_PRUNE_BATCH)
+            nDeleted += DeleteNodes(db, candidates);
+    }
+    if (!candidates.empty())
+        nDeleted += DeleteNodes(db, candidates);
+
+    LogPrint(BCLog::PRUNE, "%s: kept %u nodes, deleted %u\n", __func__, marker.marked.size(), nDeleted);
+    return nDeleted;
+}
+
+size_t StatePruner::Collect()
+{
+    int64_t nStart = GetTimeMillis();
+    std::set<dev::h256> stateRoots;
+    std::set<dev::h256> utxoRoots;
+    ldb::DB* stateDB;
+    ldb::DB* utxoDB;
+    int nHeight;
+    CollectionScope scope(mutexWritten, written);
+    const ldb::Snapshot* stateSnapshot;
+    const ldb::Snapshot* utxoSnapshot;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        if (!globalState || nHeight < 0)
+            return 0;
+        for (int i = std::max(0, nHeight - (int)nDepth); i <= nHeight; i++) {
+            dev::h256 stateRoot, utxoRoot;
+            GetContractStateRoots(chainActive[i], stateRoot, utxoRoot);
+            stateRoots.insert(stateRoot);
+            utxoRoots.insert(utxoRoot);
+        }
+        stateDB = globalState->db().db();
+        utxoDB = globalState->dbUtxo().db();
+        if (!stateDB || !utxoDB)
+            return 0;
+        stateSnapshot = scope.Begin(stateDB);
+        utxoSnapshot = scope.Begin(utxoDB);
+        // Set before anything is deleted, for CanRewindContractState.
+        nLastCollectedHeight = nHeight;
+    }
+
+    size_t nDeleted = CollectDB(stateDB, stateSnapshot, stateRoots, true);
+    nDeleted += CollectDB(utxoDB, utxoSnapshot, utxoRoots, false);
+    if (nDeleted) {
+        stateDB->CompactRange(nullptr, nullptr);
+        utxoDB->CompactRange(nullptr, nullptr);
+    }
+    LogPrintf("Pruned %u contract state nodes unreachable from blocks %d to %d in %dms\n", nDeleted, std::max(0, nHeight - (int)nDepth), nHeight, GetTimeMillis() - nStart);
+    return nDeleted;
+}
+
+void StatePruner::ThreadMain()
+{
+    while (true) {
+        MilliSleep(10000);
+        int nHeight;
+        {
+            LOCK(cs_main);
+            nHeight = chainActive.Height();
+        }
+        int nInterval = IsInitialBlockDownload() ? STATE_PRUNE_IBD_INTERVAL : STATE_PRUNE_INTERVAL;
+        if (nHeight - nLastCollectedHeight >= nInterval)
+            Collect();
+    }
+}
+
+void ThreadStatePrune()
+{
+    pstatePruner->ThreadMain();
+}
@@ -0,0 +1,67 @@
+#ifndef FASCPRUNE_H
+#define FASCPRUNE_H
+
+#include <libdevcore/OverlayDB.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+
+static const unsigned int DEFAULT_PRUNE_STATE = 0;
+/** Blocks connected between two collections. */
+static const int STATE_PRUNE_INTERVAL = 500;
+/** Blocks connected between two collections during initial block download, where every collection scans the whole database. */
+static const int STATE_PRUNE_IBD_INTERVAL = 10000;
+
+/** Number of recent blocks whose contract state is kept when pruning state (-prunestate), 0 to keep all state. */
+extern unsigned int nPruneStateDepth;
+
+/**
+ * Garbage collector for the contract state and UTXO tries.
+ *
+ * Trie nodes are stored by hash and shared between states, so OverlayDB never deletes
+ * them. Every STATE_PRUNE_INTERVAL blocks, a collection marks every node reachable
+ * from the roots of the last nPruneStateDepth blocks (account storage tries and code
+ * included), then deletes every other node from a snapshot of the database taken when
+ * the collection started.
+ *
+ * Nodes written while a collection runs are reported through OverlayDBObserver and
+ * never deleted by it, since a new state may bring back a node the snapshot holds as
+ * unreachable. Collections start under cs_main, so no block is being connected at the
+ * time the roots and the snapshot are taken.
+ *
+ * The chain can't be rewound below the kept roots: see CanRewindContractState.
+ */
+class StatePruner : public dev::OverlayDBObserver {
+public:
+    explicit StatePruner(unsigned int _nDepth);
+
+    void nodesWritten(ldb::DB const* db, std::vector<dev::h256> const& keys) override;
+
+    /** Run one collection; returns the number of nodes deleted. */
+    size_t Collect();
+
+    /** The tip height at the last collection, or at startup before the first one. */
+    int LastCollectedHeight() const { return nLastCollectedHeight; }
+
+    void ThreadMain();
+
+private:
+    size_t CollectDB(ldb::DB* db, const ldb::Snapshot* snapshot, const std::set<dev::h256>& roots, bool fAccounts);
+    size_t DeleteNodes(ldb::DB* db, std::vector<dev::h256>& keys);
+
+    unsigned int nDepth;
+    std::atomic<int> nLastCollectedHeight;
+
+    std::mutex mutexWritten;
+    std::map<ldb::DB const*, dev::h256Hash> written;   //<- nodes written since the collection started, by database
+};
+
+/** Non-null when -prunestate is set. */
+extern std::unique_ptr<StatePruner> pstatePruner;
+
+void ThreadStatePrune();
+
+#endif // FASCPRUNE_H
@@ -0,0 +1,431 @@
+#include <fasc/fascsnapshot.h>
+#include <uint256.h>
+#include <util.h>
+#include <utiltime.h>
+
+#include <libdevcore/MemoryDB.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/TrieDB.h>
+
+std::unique_ptr<StateSnapshot> pstateSnapshot;
+
+static const char DB_SNAPSHOT_ROOT = 'R';
+static const char DB_SNAPSHOT_ACCOUNT = 'a';
+static const char DB_SNAPSHOT_STORAGE = 's';
+
+/** Size of the partial batches written when generating or flattening large states. */
+static const size_t STATE_SNAPSHOT_BATCH_SIZE = 16 << 20;
+
+namespace {
+
+std::pair<char, uint160> AccountKey(const dev::Address& address)
+{
+    return std::make_pair(DB_SNAPSHOT_ACCOUNT, uint160(address.asBytes()));
+}
+
+std::pair<char, std::pair<uint160, uint256> > StorageKey(const dev::Address& address, const dev::u256& key)
+{
+    return std::make_pair(DB_SNAPSHOT_STORAGE, std::make_pair(uint160(address.asBytes()), u256Touint(key)));
+}
+
+void EraseStorage(CDBWrapper& db, CDBBatch& batch, const dev::Address& address)
+{
+    uint160 addressKey(address.asBytes());
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    for (it->Seek(std::make_pair(DB_SNAPSHOT_STORAGE, std::make_pair(addressKey, uint256()))); it->Valid(); it->Next()) {
+        std::pair<char, std::pair<uint160, uint256> > key;
+        if (!it->GetKey(key) || key.first != DB_SNAPSHOT_STORAGE || key.second.first != addressKey)
+            break;
+        batch.Erase(key);
+    }
+}
+
+}
+
+StateSnapshot::StateSnapshot(const fs::path& _path, size_t _nCacheSize, const dev::OverlayDB& _stateDB) :
+    path(_path), nCacheSize(_nCacheSize), stateDB(_stateDB), db(new CDBWrapper(_path, _nCacheSize)), fValid(false)
+{
+}
+
+bool StateSnapshot::account(const dev::h256& root, const dev::Address& address, std::string& rlp) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fValid)
+        return false;
+    dev::h256 current = root;
+    while (current != diskRoot) {
+        auto it = layers.find(current);
+        if (it == layers.end())
+            return false;
+        if (it->second.diff.account(address, rlp))
+            return true;
+        current = it->second.parent;
+    }
+    if (!db->Read(AccountKey(address), rlp))
+        rlp.clear();
+    return true;
+}
+
+bool StateSnapshot::storage(const dev::h256& root, const dev::Address& address, const dev::u256& key, dev::u256& value) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fValid)
+        return false;
+    dev::h256 current = root;
+    while (current != diskRoot) {
+        auto it = layers.find(current);
+        if (it == layers.end())
+            return false;
+        switch (it->second.diff.storage(address, key, value)) {
+        case dev::eth::StateDiff::Lookup::Found:
+            return true;
+        case dev::eth::StateDiff::Lookup::Unknown:
+            return false;
+        case dev::eth::StateDiff::Lookup::NotHere:
+            break;
+        }
+        current = it->second.parent;
+    }
+    uint256 stored;
+    value = db->Read(StorageKey(address, key), stored) ? uintTou256(stored) : 0;
+    return true;
+}
+
+bool StateSnapshot::Load(const dev::h256& root)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    layers.clear();
+    uint256 stored;
+    if (db->Read(DB_SNAPSHOT_ROOT, stored) && uintToh256(stored) == root) {
+        int64_t nStart = GetTimeMillis();
+        std::string strError;
+        if (CheckDiskRoot(root, strError)) {
+            diskRoot = root;
+            fValid = true;
+            LogPrintf("Loaded the contract state snapshot of state %s, checked in %dms\n", root.hex(), GetTimeMillis() - nStart);
+            return true;
+        }
+        LogPrintf("The contract state snapshot doesn't match state %s: %s\n", root.hex(), strError);
+    }
+    return Generate(root);
+}
+
+bool StateSnapshot::CheckDiskRoot(const dev::h256& root, std::string& strError) const
+{
+    // Rebuild the tries from the snapshot in memory: accounts sort before storage slots, and
+    // the slots of an account are together, so each storage trie is built and dropped in turn.
+    dev::MemoryDB accountDB;
+    dev::HashedGenericTrieDB<dev::MemoryDB> accountTrie(&accountDB);
+    accountTrie.init();
+    std::map<dev::Address, dev::h256> storageRoots;
+    std::unique_ptr<dev::MemoryDB> storageDB;
+    std::unique_ptr<dev::HashedGenericTrieDB<dev::MemoryDB> > storageTrie;
+    dev::Address storageAddress;
+
+    auto checkStorageRoot = [&]() {
+        if (!storageTrie)
+            return true;
+        auto it = storageRoots.find(storageAddress);
+        if (it == storageRoots.end() || it->second != storageTrie->root()) {
+            strError = strprintf("the storage of account %s doesn't match its root", storageAddress.hex());
+            return false;
+        }
+        storageRoots.erase(it);
+        return true;
+    };
+
+    try {
+        std::unique_ptr<CDBIterator> it(db->NewIterator());
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            char type;
+            if (!it->GetKey(type))
+                continue;
+            if (type == DB_SNAPSHOT_ACCOUNT) {
+                std::pair<char, uint160> key;
+                std::string rlp;
+                if (!it->GetKey(key) || !it->GetValue(rlp)) {
+                    strError = "unreadable account";
+                    return false;
+                }
+                dev::Address address(key.second.begin(), dev::h160::ConstructFromPointer);
+                accountTrie.insert(dev::bytesConstRef(address.data(), address.size), dev::bytesConstRef(&rlp));
+                dev::h256 storageRoot = dev::RLP(rlp)[2].toHash<dev::h256>();
+                if (storageRoot != dev::EmptyTrie)
+                    storageRoots[address] = storageRoot;
+            } else if (type == DB_SNAPSHOT_STORAGE) {
+                std::pair<char, std::pair<uint160, uint256> > key;
+                uint256 value;
+                if (!it->GetKey(key) || !it->GetValue(value)) {
+                    strError = "unreadable storage slot";
+                    return false;
+                }
+                dev::Address address(key.second.first.begin(), dev::h160::ConstructFromPointer);
+                if (!storageTrie || address != storageAddress) {
+                    if (!checkStorageRoot())
+                        return false;
+                    storageAddress = address;
+                    storageDB.reset(new dev::MemoryDB());
+                    storageTrie.reset(new dev::HashedGenericTrieDB<dev::MemoryDB>(storageDB.get()));
+                    storageTrie->init();
+                }
+                dev::h256 slot(uintTou256(key.second.second));
+                dev::bytes rlpValue = dev::rlp(uintTou256(value));
+                storageTrie->insert(dev::bytesConstRef(slot.data(), slot.size), dev::bytesConstRef(&rlpValue));
+            }
+        }
+        if (!checkStorageRoot())
+            return false;
+    } catch (const std::exception& e) {
+        strError = e.what();
+        return false;
+    }
+    if (!storageRoots.empty()) {
+        strError = strprintf("the storage of account %s is missing", storageRoots.begin()->first.hex());
+        return false;
+    }
+    if (accountTrie.root() != root) {
+        strError = strprintf("the accounts make state %s", accountTrie.root().hex());
+        return false;
+    }
+    return true;
+}
+
+bool StateSnapshot::Regenerate(const dev::h256& root)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    layers.clear();
+    return Generate(root);
+}
+
+bool StateSnapshot::Generate(const dev::h256& root)
+{
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Generating the contract state snapshot of state %s...\n", root.hex());
+    fValid = false;
+    db.reset();
+    db.reset(new CDBWrapper(path, nCacheSize, false, true));
+
+    size_t nAccounts = 0;
+    try {
+        dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> trie(&stateDB, root);
+        CDBBatch batch(*db);
+        for (auto it = trie.hashedBegin(); it != trie.hashedEnd(); ++it) {
+            dev::bytes key = it.key();
+            if (key.size() != dev::Address::size)
+                return error("%s: the address of account %s is unknown", __func__, dev::h256((*it).first).hex());
+            dev::Address address(key);
+            std::string rlp = (*it).second.toString();
+            batch.Write(AccountKey(address), rlp);
+            WriteTrieStorage(batch, address, dev::RLP(rlp)[2].toHash<dev::h256>());
+            if (batch.SizeEstimate() > STATE_SNAPSHOT_BATCH_SIZE) {
+                db->WriteBatch(batch);
+                batch.Clear();
+            }
+            nAccounts++;
+        }
+        batch.Write(DB_SNAPSHOT_ROOT, h256Touint(root));
+        db->WriteBatch(batch, true);
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+
+    diskRoot = root;
+    fValid = true;
+    LogPrintf("Generated the contract state snapshot: %u accounts in %dms\n", nAccounts, GetTimeMillis() - nStart);
+    return true;
+}
+
+void StateSnapshot::WriteTrieStorage(CDBBatch& batch, const dev::Address& address, const dev::h256& storageRoot)
+{
+    if (storageRoot == dev::EmptyTrie)
+        return;
+    dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> trie(&stateDB, storageRoot);
+    for (auto it = trie.hashedBegin(); it != trie.hashedEnd(); ++it) {
+        dev::bytes key = it.key();
+        if (key.size() != dev::h256::size)
+            throw std::runtime_error(strprintf("the key of storage slot %s of account %s is unknown", dev::h256((*it).first).hex(), address.hex()));
+        batch.Write(StorageKey(address, dev::u256(dev::h256(key))), u256Touint(dev::RLP((*it).second).toInt<dev::u256>()));
+        if (batch.SizeEstimate() > STATE_SNAPSHOT_BATCH_SIZE) {
+            db->WriteBatch(batch);
+            batch.Clear();
+        }
+    }
+}
+
+void StateSnapshot::AddLayer(const dev::h256& parent, const dev::h256& root, dev::eth::StateDiff&& diff)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Blocks that don't change the state, or lead to a state already known, add nothing.
+    if (!fValid || root == parent || root == diskRoot || layers.count(root))
+        return;
+    if (parent != diskRoot && !layers.count(parent)) {
+        Invalidate(strprintf("state %s is built on state %s, which is older than the snapshot", root.hex(), parent.hex()));
+        return;
+    }
+    DiffLayer& layer = layers[root];
+    layer.parent = parent;
+    layer.diff = std::move(diff);
+}
+
+void StateSnapshot::Cap(const dev::h256& root, size_t nLayers)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fValid)
+        return;
+
+    // The layers from root down to the disk, newest first.
+    std::vector<dev::h256> chain;
+    for (dev::h256 current = root; current != diskRoot;) {
+        auto it = layers.find(current);
+        if (it == layers.end())
+            return;
+        chain.push_back(current);
+        current = it->second.parent;
+    }
+    if (chain.size() <= nLayers)
+        return;
+
+    for (size_t i = chain.size(); i-- > nLayers;) {
+        auto it = layers.find(chain[i]);
+        if (!Flatten(chain[i], it->second)) {
+            Invalidate(strprintf("writing state %s failed", chain[i].hex()));
+            return;
+        }
+        diskRoot = chain[i];
+        layers.erase(it);
+    }
+
+    // Drop the branches that don't lead to the new disk state.
+    std::vector<dev::h256> stale;
+    for (const std::pair<const dev::h256, DiffLayer>& layer : layers) {
+        dev::h256 current = layer.second.parent;
+        while (current != diskRoot) {
+            auto it = layers.find(current);
+            if (it == layers.end())
+                break;
+            current = it->second.parent;
+        }
+        if (current != diskRoot)
+            stale.push_back(layer.first);
+    }
+    for (const dev::h256& staleRoot : stale)
+        layers.erase(staleRoot);
+}
+
+bool StateSnapshot::Flatten(const dev::h256& root, const DiffLayer& layer)
+{
+    try {
+        CDBBatch batch(*db);
+        // If the layer takes several batches, the snapshot has no valid state until the last one.
+        batch.Erase(DB_SNAPSHOT_ROOT);
+        for (const std::pair<const dev::Address, dev::eth::StateDiff::AccountChange>& account : layer.diff.accounts) {
+            const dev::eth::StateDiff::AccountChange& change = account.second;
+            if (change.storageReset || change.storageReplaced)
+                EraseStorage(*db, batch, account.first);
+            if (change.rlp.empty()) {
+                batch.Erase(AccountKey(account.first));
+            } else {
+                batch.Write(AccountKey(account.first), change.rlp);
+                if (change.storageReplaced)
+                    WriteTrieStorage(batch, account.first, dev::RLP(change.rlp)[2].toHash<dev::h256>());
+            }
+            for (const std::pair<const dev::u256, dev::u256>& slot : change.storage) {
+                if (slot.second)
+                    batch.Write(StorageKey(account.first, slot.first), u256Touint(slot.second));
+                else
+                    batch.Erase(StorageKey(account.first, slot.first));
+            }
+            if (batch.SizeEstimate() > STATE_SNAPSHOT_BATCH_SIZE) {
+                db->WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        batch.Write(DB_SNAPSHOT_ROOT, h256Touint(root));
+        db->WriteBatch(batch);
+    } catch (const std::exception& e) {
+        return error("%s: %s", __func__, e.what());
+    }
+    return true;
+}
+
+void StateSnapshot::Invalidate(const std::string& reason)
+{
+    LogPrintf("Contract state snapshot disabled, %s. It is generated again at the next start.\n", reason);
+    fValid = false;
+    layers.clear();
+    db->Erase(DB_SNAPSHOT_ROOT, true);
+}
+
+bool StateSnapshot::Verify(const dev::h256& root, std::string& strError) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!fValid || diskRoot != root || !layers.empty()) {
+        strError = strprintf("the snapshot on disk doesn't have state %s", root.hex());
+        return false;
+    }
+
+    size_t nAccounts = 0;
+    size_t nSlots = 0;
+    try {
+        dev::OverlayDB& trieDB = const_cast<dev::OverlayDB&>(stateDB);      // promise we won't change the overlay
+        dev::eth::SecureTrieDB<dev::Address, dev::OverlayDB> trie(&trieDB, root);
+        for (auto it = trie.hashedBegin(); it != trie.hashedEnd(); ++it) {
+            dev::Address address(it.key());
+            std::string rlp = (*it).second.toString();
+            std::string stored;
+            if (!db->Read(AccountKey(address), stored) || stored != rlp) {
+                strError = strprintf("account %s differs from the trie", address.hex());
+                return false;
+            }
+            nAccounts++;
+
+            dev::h256 storageRoot = dev::RLP(rlp)[2].toHash<dev::h256>();
+            if (storageRoot == dev::EmptyTrie)
+                continue;
+            dev::eth::SecureTrieDB<dev::h256, dev::OverlayDB> storageTrie(&trieDB, storageRoot);
+            for (auto sit = storageTrie.hashedBegin(); sit != storageTrie.hashedEnd(); ++sit) {
+                dev::u256 key(dev::h256(sit.key()));
+                uint256 value;
+                if (!db->Read(StorageKey(address, key), value) || uintTou256(value) != dev::RLP((*sit).second).toInt<dev::u256>()) {
+                    strError = strprintf("storage slot %s of account %s differs from the trie", dev::h256(key).hex(), address.hex());
+                    return false;
+                }
+                nSlots++;
+            }
+        }
+    } catch (const std::exception& e) {
+        strError = e.what();
+        return false;
+    }
+
+    // Every entry of the trie is in the snapshot: the snapshot has no other one if the counts match.
+    size_t nStoredAccounts = 0;
+    size_t nStoredSlots = 0;
+    std::unique_ptr<CDBIterator> it(db->NewIterator());
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        char type;
+        if (!it->GetKey(type))
+            continue;
+        if (type == DB_SNAPSHOT_ACCOUNT)
+            nStoredAccounts++;
+        else if (type == DB_SNAPSHOT_STORAGE)
+            nStoredSlots++;
+    }
+    if (nStoredAccounts != nAccounts || nStoredSlots != nSlots) {
+        strError = strprintf("the snapshot has %u accounts and %u storage slots, the trie %u and %u", nStoredAccounts, nStoredSlots, nAccounts, nSlots);
+        return false;
+    }
+    return true;
+}
+
+dev::h256 StateSnapshot::DiskRoot() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return diskRoot;
+}
+
+size_t StateSnapshot::LayerCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return layers.size();
+}
@@ -0,0 +1,87 @@
+#ifndef FASCSNAPSHOT_H
+#define FASCSNAPSHOT_H
+
+#include <dbwrapper.h>
+#include <fs.h>
+
+#include <libethereum/State.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+static const bool DEFAULT_STATE_SNAPSHOT = false;
+static const bool DEFAULT_CHECK_STATE_SNAPSHOT = false;
+/** States kept as in-memory diff layers on top of the snapshot on disk. */
+static const size_t STATE_SNAPSHOT_LAYERS = 128;
+/** Database cache of the snapshot on disk. */
+static const size_t STATE_SNAPSHOT_CACHE = 8 << 20;
+
+/**
+ * Flat snapshot of the contract state: account trie values by address and storage
+ * values by address and slot, so that a lookup costs one database read instead of
+ * one per trie level, and no key hashing.
+ *
+ * The snapshot on disk holds the state of one root. The states of the blocks
+ * connected on top of it are kept in memory as diff layers, one per state root,
+ * each pointing to the state it was built on. A lookup for a root walks its layers
+ * down to the disk; a root the snapshot doesn't know (e.g. before a reorganization
+ * deeper than the layers) is looked up in the trie instead. Once there are more
+ * than STATE_SNAPSHOT_LAYERS layers, the oldest ones are written to disk and the
+ * layers of the branches that no longer lead to it are dropped.
+ *
+ * The trie remains the only source for state roots, and for the storage of accounts
+ * overwritten as a whole, e.g. by the parallel executor.
+ */
+class StateSnapshot : public dev::eth::FlatStateReader {
+public:
+    StateSnapshot(const fs::path& _path, size_t _nCacheSize, const dev::OverlayDB& _stateDB);
+
+    bool account(const dev::h256& root, const dev::Address& address, std::string& rlp) const override;
+    bool storage(const dev::h256& root, const dev::Address& address, const dev::u256& key, dev::u256& value) const override;
+
+    /** Use the snapshot on disk if it has the state @a root and its entries hash to it, or generate it from the trie. */
+    bool Load(const dev::h256& root);
+    /** Generate the snapshot on disk from the trie of the state @a root. */
+    bool Regenerate(const dev::h256& root);
+
+    /** Add the state @a root, made of @a diff on top of the state @a parent. */
+    void AddLayer(const dev::h256& parent, const dev::h256& root, dev::eth::StateDiff&& diff);
+
+    /** Write the layers below the last @a nLayers ones under @a root to disk, and drop the other branches. */
+    void Cap(const dev::h256& root, size_t nLayers);
+
+    /** Compare the snapshot on disk with the trie of the state @a root. */
+    bool Verify(const dev::h256& root, std::string& error) const;
+
+    dev::h256 DiskRoot() const;
+    size_t LayerCount() const;
+
+private:
+    struct DiffLayer {
+        dev::h256 parent;
+        dev::eth::StateDiff diff;
+    };
+
+    bool Generate(const dev::h256& root);
+    /** Whether the entries on disk rebuild the account trie of @a root, and the storage tries its accounts refer to. */
+    bool CheckDiskRoot(const dev::h256& root, std::string& strError) const;
+    bool Flatten(const dev::h256& root, const DiffLayer& layer);
+    void WriteTrieStorage(CDBBatch& batch, const dev::Address& address, const dev::h256& storageRoot);
+    void Invalidate(const std::string& reason);
+
+    fs::path path;
+    size_t nCacheSize;
+    dev::OverlayDB stateDB;
+    std::unique_ptr<CDBWrapper> db;
+
+    mutable std::mutex mutex;
+    bool fValid;
+    dev::h256 diskRoot;
+    std::map<dev::h256, DiffLayer> layers;
+};
+
+/** Non-null when -statesnapshot is set. */
+extern std::unique_ptr<StateSnapshot> pstateSnapshot;
+
+#endif // FASCSNAPSHOT_H
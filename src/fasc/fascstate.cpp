@@ -1,3 +1,4 @@
+#include <future>
 #include <sstream>
 #include <validation.h>
 #include <chainparams.h>
@@ -14,9 +15,18 @@ using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
-FascState::FascState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs) :
+/** UTXO trie changes from which they are committed on another thread, concurrently with the accounts. */
+static const size_t MIN_CONCURRENT_UTXO_COMMIT = 64;
+
+FascState::FascState(u256 const& _accountStartNonce, OverlayDB const& _db, const string& _path, BaseState _bs, ldb::Options const& _utxoOptions) :
     State(_accountStartNonce, _db, _bs) {
-    dbUTXO = FascState::openDB(_path + "/fascDB", sha3(rlp("")), WithExisting::Trust);
+    dbUTXO = FascState::openDB(_path + "/fascDB", sha3(rlp("")), WithExisting::Trust, _utxoOptions);
+    stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
+}
+
+FascState::FascState(u256 const& _accountStartNonce, OverlayDB const& _db, OverlayDB const& _dbUtxo) :
+    State(_accountStartNonce, _db, BaseState::PreExisting) {
+    dbUTXO = _dbUtxo;
     stateUTXO = SecureTrieDB<Address, OverlayDB>(&dbUTXO);
 }
 
@@ -153,7 +163,7 @@ ResultExecute FascState::execute(
             m_cache.clear();
             cacheUTXO.clear();
         } else {
-            deleteAccounts(_sealEngine.deleteAddresses);
+            deleteAccountsUnlogged(_sealEngine.deleteAddresses);
             if(res.excepted == TransactionException::None) {
                 CondensingTX ctx(this, transfers, _t, _sealEngine.deleteAddresses);
                 tx = MakeTransactionRef(ctx.createCondensingTX(feesCoveredByLogs,
@@ -173,10 +183,33 @@ ResultExecute FascState::execute(
                 }
                 printfErrorLog(res.excepted);
             }
-            fasc::commit(cacheUTXO, stateUTXO, m_cache);
-            cacheUTXO.clear();
+            // The UTXO trie has its own database: when it has enough changes, update it on the storage commit pool
+            // while the accounts are committed.
+            static const dev::eth::AccountMap noAccounts;
+            auto commitUTXO = std::make_shared<std::packaged_task<dev::AddressHash()>>([this]() { return fasc::commit(cacheUTXO, stateUTXO, noAccounts); });
+            std::future<dev::AddressHash> committedUTXO = commitUTXO->get_future();
+            bool pooledUTXO = cacheUTXO.size() >= MIN_CONCURRENT_UTXO_COMMIT && dev::eth::storageCommitThreads() > 0 && !dev::eth::isStorageCommitThread();
+            if (pooledUTXO) {
+                dev::eth::postStorageCommitTask([commitUTXO]() { (*commitUTXO)(); });
+            }
             bool removeEmptyAccounts = _envInfo.number() >= _sealEngine.chainParams().EIP158ForkBlock;
-            commit(removeEmptyAccounts ? State::CommitBehaviour::RemoveEmptyAccounts : State::CommitBehaviour::KeepEmptyAccounts);
+            try {
+                commit(removeEmptyAccounts ? State::CommitBehaviour::RemoveEmptyAccounts : State::CommitBehaviour::KeepEmptyAccounts);
+            } catch (...) {
+                // The handlers below clear cacheUTXO.
+                if (pooledUTXO) {
+                    committedUTXO.wait();
+                }
+                throw;
+            }
+            if (!pooledUTXO) {
+                (*commitUTXO)();
+            }
+            dev::AddressHash committedUTXOAddresses = committedUTXO.get();
+            if (m_accessLog) {
+                m_accessLog->written += committedUTXOAddresses;
+            }
+            cacheUTXO.clear();
         }
     }
     catch (Exception const& _e) {
@@ -187,8 +220,10 @@ ResultExecute FascState::execute(
         res.excepted = dev::eth::toTransactionException(_e);
         res.gasUsed = _t.gas();
         const Consensus::Params& consensusParams = Params().GetConsensus();
-        if(chainActive.Height() < consensusParams.nFixUTXOCacheHFHeight && _p != Permanence::Reverted) {
-            deleteAccounts(_sealEngine.deleteAddresses);
+        // The height of the parent block, from the environment built under cs_main: this may run on other threads.
+        int64_t nParentHeight = static_cast<int64_t>(_envInfo.number()) - 1;
+        if(nParentHeight < consensusParams.nFixUTXOCacheHFHeight && _p != Permanence::Reverted) {
+            deleteAccountsUnlogged(_sealEngine.deleteAddresses);
             commit(CommitBehaviour::RemoveEmptyAccounts);
         } else {
             m_cache.clear();
@@ -250,6 +285,9 @@ Vin const* FascState::vin(dev::Address const& _a) const
 
 Vin* FascState::vin(dev::Address const& _addr)
 {
+    if (m_accessLog) {
+        m_accessLog->addresses.insert(_addr);
+    }
     auto it = cacheUTXO.find(_addr);
     if (it == cacheUTXO.end()) {
         std::string stateBack = stateUTXO.at(_addr);
@@ -336,6 +374,15 @@ void FascState::deleteAccounts(std::set<dev::Address>& addrs) {
     }
 }
 
+void FascState::deleteAccountsUnlogged(std::set<dev::Address>& addrs) {
+    // The sender and the block author are always in addrs; looking them up here is not
+    // a read made by the contract, so keep it out of the access log.
+    dev::eth::StateAccessLog* log = m_accessLog;
+    m_accessLog = nullptr;
+    deleteAccounts(addrs);
+    m_accessLog = log;
+}
+
 void FascState::updateUTXO(const std::unordered_map<dev::Address, Vin>& vins) {
     for(auto& v : vins) {
         Vin* vi = const_cast<Vin*>(vin(v.first));
@@ -73,7 +73,12 @@ public:
 
     FascState();
 
-    FascState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting);
+    // Opens the UTXO database under _path, with _utxoOptions.
+    FascState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, const std::string& _path, dev::eth::BaseState _bs = dev::eth::BaseState::PreExisting,
+              ldb::Options const& _utxoOptions = dev::eth::State::defaultDBOptions());
+
+    // Opens a second view over already opened state and UTXO databases, e.g. for executing contracts off the main thread.
+    FascState(dev::u256 const& _accountStartNonce, dev::OverlayDB const& _db, dev::OverlayDB const& _dbUtxo);
 
     ResultExecute execute(dev::eth::EnvInfo const& _envInfo, dev::eth::SealEngineFace const& _sealEngine,
                           FascTransaction const& _t, dev::eth::Permanence _p = dev::eth::Permanence::Committed,
@@ -100,6 +105,44 @@ public:
 
     std::unordered_map<dev::Address, Vin> vins() const; // temp
 
+    bool addressHasUTXO(dev::Address const& _addr) const {
+        return vin(_addr) != nullptr;
+    }
+
+    // Raw trie values of an account and of its UTXO, empty if there is none. Both bypass the caches,
+    // so they must only be used while the caches are empty, i.e. between executions.
+    std::string rawAccount(dev::Address const& _addr) const {
+        return m_state.at(_addr);
+    }
+
+    std::string rawUTXO(dev::Address const& _addr) const {
+        return stateUTXO.at(_addr);
+    }
+
+    // Overwrites the trie values of an account and of its UTXO, e.g. with the result of an execution
+    // made on another view of the same state. Empty values remove the entry.
+    void setRawAccount(dev::Address const& _addr, std::string const& _value) {
+        if (_value.empty())
+            m_state.remove(_addr);
+        else
+            m_state.insert(_addr, dev::bytesConstRef(&_value));
+        if (m_flatReader) {
+            // The storage written with the account is only in its storage trie.
+            dev::eth::StateDiff::AccountChange& change = m_flatDiff.accounts[_addr];
+            change = dev::eth::StateDiff::AccountChange();
+            change.rlp = _value;
+            change.storageReset = _value.empty();
+            change.storageReplaced = !_value.empty();
+        }
+    }
+
+    void setRawUTXO(dev::Address const& _addr, std::string const& _value) {
+        if (_value.empty())
+            stateUTXO.remove(_addr);
+        else
+            stateUTXO.insert(_addr, dev::bytesConstRef(&_value));
+    }
+
     dev::OverlayDB const& dbUtxo() const {
         return dbUTXO;
     }
@@ -130,6 +173,8 @@ private:
 
     void deleteAccounts(std::set<dev::Address>& addrs);
 
+    void deleteAccountsUnlogged(std::set<dev::Address>& addrs);
+
     void updateUTXO(const std::unordered_map<dev::Address, Vin>& vins);
 
     void printfErrorLog(const dev::eth::TransactionException er, const std::string &errorMessage = "");
@@ -0,0 +1,289 @@
+#include <fasc/fascstateimport.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <txdb.h>
+#include <ui_interface.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <fasc/fascstate.h>
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+#include <libdevcore/TrieCommon.h>
+
+#include <boost/thread.hpp>
+
+uint256 hashAssumeValidState;
+fs::path pathImportState;
+
+/** Block whose state was imported, null if none. */
+static uint256 hashImportedState;
+/** Set when an import failed, so that it isn't retried for every block. */
+static bool fImportStateFailed = false;
+
+/** Nodes copied between two writes to the databases. */
+static const size_t STATE_IMPORT_BATCH = 10000;
+
+namespace {
+
+/**
+ * Copies tries between two databases, checking every node against the hash that refers to it.
+ * With fSkipExisting, nodes the destination has already are taken to have their whole subtrie
+ * there too, and are not copied nor visited.
+ */
+class TrieImporter {
+public:
+    TrieImporter(const dev::OverlayDB& _source, dev::OverlayDB& _dest, bool _fSkipExisting = false) :
+        nNodes(0), nMissingKeys(0), source(_source), dest(_dest), fSkipExisting(_fSkipExisting) {
+        copied.insert(dev::EmptyTrie);
+    }
+
+    bool ImportTrie(const dev::h256& root, bool fAccountTrie, std::string& error) {
+        pending.push_back(PendingNode{root, fAccountTrie, dev::bytes()});
+        while (!pending.empty()) {
+            PendingNode next = std::move(pending.back());
+            pending.pop_back();
+            if (!copied.insert(next.hash).second || (fSkipExisting && dest.exists(next.hash)))
+                continue;
+            std::string node = source.lookup(next.hash);
+            if (node.empty()) {
+                error = strprintf("trie node %s is missing", next.hash.hex());
+                return false;
+            }
+            if (dev::sha3(node) != next.hash) {
+                error = strprintf("trie node %s doesn't match its hash", next.hash.hex());
+                return false;
+            }
+            dest.insert(next.hash, dev::bytesConstRef(&node));
+            if (!VisitNode(dev::RLP(node), next.fAccountTrie, next.path, error))
+                return false;
+            if (++nNodes % STATE_IMPORT_BATCH == 0) {
+                dest.commit();
+                boost::this_thread::interruption_point();
+            }
+        }
+        dest.commit();
+        return true;
+    }
+
+    size_t nNodes;
+    size_t nMissingKeys;
+
+private:
+    struct PendingNode {
+        dev::h256 hash;
+        bool fAccountTrie;
+        dev::bytes path;    //<- nibbles from the root of the trie
+    };
+
+    bool VisitNode(const dev::RLP& node, bool fAccountTrie, const dev::bytes& path, std::string& error) {
+        if (node.isList() && node.itemCount() == 17) {
+            for (unsigned i = 0; i < 16; i++) {
+                dev::bytes childPath(path);
+                childPath.push_back(i);
+                if (!VisitChild(node[i], fAccountTrie, childPath, error))
+                    return false;
+            }
+            if (!node[16].isEmpty())
+                return VisitValue(node[16].payload(), fAccountTrie, path, error);
+        } else if (node.isList() && node.itemCount() == 2) {
+            dev::bytes nodePath(path);
+            dev::NibbleSlice key = dev::keyOf(node);
+            for (unsigned i = 0; i < key.size(); i++)
+                nodePath.push_back(key[i]);
+            if (dev::isLeaf(node))
+                return VisitValue(node[1].payload(), fAccountTrie, nodePath, error);
+            return VisitChild(node[1], fAccountTrie, nodePath, error);
+        }
+        return true;
+    }
+
+    bool VisitChild(const dev::RLP& child, bool fAccountTrie, const dev::bytes& path, std::string& error) {
+        if (child.isList())
+            return VisitNode(child, fAccountTrie, path, error);      // nodes under 32 bytes are inlined in their parent
+        if (child.size() == 32)
+            pending.push_back(PendingNode{child.toHash<dev::h256>(), fAccountTrie, path});
+        return true;
+    }
+
+    bool VisitValue(dev::bytesConstRef value, bool fAccountTrie, const dev::bytes& path, std::string& error) {
+        // The keys are hashed: their preimages are kept aside so that the trie can be iterated.
+        if (path.size() == 64) {
+            dev::h256 hashedKey;
+            for (unsigned i = 0; i < 32; i++)
+                hashedKey[i] = (path[2 * i] << 4) | path[2 * i + 1];
+            dev::bytes preimage = source.lookupAux(hashedKey);
+            if (!preimage.empty() && dev::sha3(preimage) == hashedKey)
+                dest.insertAux(hashedKey, dev::bytesConstRef(&preimage));
+            else
+                nMissingKeys++;
+        }
+        if (!fAccountTrie)
+            return true;
+        // An account: nonce, balance, storage root and code hash.
+        dev::RLP account(value);
+        if (!account.isList() || account.itemCount() < 4) {
+            error = "account with a malformed value";
+            return false;
+        }
+        dev::h256 storageRoot = account[2].toHash<dev::h256>();
+        if (storageRoot != dev::EmptyTrie)
+            pending.push_back(PendingNode{storageRoot, false, dev::bytes()});
+        dev::h256 codeHash = account[3].toHash<dev::h256>();
+        if (codeHash != dev::EmptySHA3 && copied.insert(codeHash).second && !(fSkipExisting && dest.exists(codeHash))) {
+            std::string code = source.lookup(codeHash);
+            if (code.empty() || dev::sha3(code) != codeHash) {
+                error = strprintf("code %s is missing or doesn't match its hash", codeHash.hex());
+                return false;
+            }
+            dest.insert(codeHash, dev::bytesConstRef(&code));
+        }
+        return true;
+    }
+
+    const dev::OverlayDB& source;
+    dev::OverlayDB& dest;
+    const bool fSkipExisting;
+    dev::h256Hash copied;
+    std::vector<PendingNode> pending;
+};
+
+/** The block whose state was imported, or else the one to import, if its header is known. */
+const CBlockIndex* TrustedStateBlock()
+{
+    const uint256& hash = hashImportedState.IsNull() ? hashAssumeValidState : hashImportedState;
+    if (hash.IsNull())
+        return nullptr;
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    if (it == mapBlockIndex.end())
+        return nullptr;
+    return it->second;
+}
+
+}
+
+bool ImportContractState(const fs::path& path, const dev::h256& stateRoot, const dev::h256& utxoRoot,
+                         dev::OverlayDB& stateDB, dev::OverlayDB& utxoDB, std::string& error)
+{
+    if (!fs::is_directory(path / "fascDB")) {
+        error = strprintf("%s is not a contract state directory", path.string());
+        return false;
+    }
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    try {
+        dev::OverlayDB sourceState = FascState::openDB(path.string(), hashDB, dev::WithExisting::Trust);
+        dev::OverlayDB sourceUTXO = FascState::openDB((path / "fascDB").string(), hashDB, dev::WithExisting::Trust);
+
+        TrieImporter stateImporter(sourceState, stateDB);
+        if (!stateImporter.ImportTrie(stateRoot, true, error))
+            return false;
+        TrieImporter utxoImporter(sourceUTXO, utxoDB);
+        if (!utxoImporter.ImportTrie(utxoRoot, false, error))
+            return false;
+        if (stateImporter.nMissingKeys || utxoImporter.nMissingKeys)
+            LogPrintf("%s: %u trie keys have no preimage, the state can't be listed entirely\n", __func__, stateImporter.nMissingKeys + utxoImporter.nMissingKeys);
+        LogPrintf("%s: copied %u state nodes and %u UTXO nodes\n", __func__, stateImporter.nNodes, utxoImporter.nNodes);
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+bool CopyMissingContractState(const dev::OverlayDB& sourceState, const dev::OverlayDB& sourceUTXO,
+                              const dev::h256& stateRoot, const dev::h256& utxoRoot,
+                              dev::OverlayDB& stateDB, dev::OverlayDB& utxoDB, std::string& error)
+{
+    try {
+        TrieImporter stateImporter(sourceState, stateDB, true);
+        if (!stateImporter.ImportTrie(stateRoot, true, error))
+            return false;
+        TrieImporter utxoImporter(sourceUTXO, utxoDB, true);
+        if (!utxoImporter.ImportTrie(utxoRoot, false, error))
+            return false;
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+void LoadImportedState()
+{
+    if (!pblocktree->ReadImportedState(hashImportedState))
+        hashImportedState.SetNull();
+    if (!hashImportedState.IsNull())
+        LogPrintf("Contract state of block %s was imported, contracts are not executed up to it\n", hashImportedState.GetHex());
+    if (!hashImportedState.IsNull() && !hashAssumeValidState.IsNull() && hashAssumeValidState != hashImportedState)
+        InitWarning(strprintf(_("The contract state of block %s was imported already, -assumevalidstate is ignored"), hashImportedState.GetHex()));
+}
+
+bool SkipContractExecution(const CBlockIndex* pindex)
+{
+    AssertLockHeld(cs_main);
+    if (hashImportedState.IsNull())
+        return false;
+    const CBlockIndex* pindexState = TrustedStateBlock();
+    return pindexState && pindexState->GetAncestor(pindex->nHeight) == pindex;
+}
+
+void ImportTrustedContractState()
+{
+    if (pathImportState.empty())
+        return;
+
+    uint256 hashState;
+    int nHeight;
+    dev::h256 stateRoot, utxoRoot;
+    std::unique_ptr<dev::OverlayDB> stateDB, utxoDB;
+    {
+        LOCK(cs_main);
+        if (!hashImportedState.IsNull() || fImportStateFailed || !globalState)
+            return;
+        const CBlockIndex* pindexState = TrustedStateBlock();
+        // Like -assumevalid, only import for a block of the best header chain with enough work,
+        // and only while there are blocks left for the imported state to stand in for.
+        if (!pindexState || chainActive.Height() >= pindexState->nHeight || !pindexBestHeader ||
+            pindexBestHeader->GetAncestor(pindexState->nHeight) != pindexState ||
+            pindexBestHeader->nChainWork < UintToArith256(Params().GetConsensus().nMinimumChainWork))
+            return;
+        hashState = pindexState->GetBlockHash();
+        nHeight = pindexState->nHeight;
+        stateRoot = uintToh256(pindexState->hashStateRoot);
+        utxoRoot = uintToh256(pindexState->hashUTXORoot);
+        // Copies sharing the databases of globalState: the import writes straight to disk.
+        stateDB.reset(new dev::OverlayDB(globalState->db()));
+        utxoDB.reset(new dev::OverlayDB(globalState->dbUtxo()));
+    }
+
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Importing the contract state of block %s from %s...\n", hashState.GetHex(), pathImportState.string());
+    std::string error;
+    bool fImported = ImportContractState(pathImportState, stateRoot, utxoRoot, *stateDB, *utxoDB, error);
+
+    LOCK(cs_main);
+    if (!fImported) {
+        LogPrintf("Failed to import the contract state: %s. Contracts are executed instead\n", error);
+        fImportStateFailed = true;
+        return;
+    }
+    if (!pblocktree->WriteImportedState(hashState)) {
+        LogPrintf("Failed to record the imported contract state. Contracts are executed instead\n");
+        fImportStateFailed = true;
+        return;
+    }
+    hashImportedState = hashState;
+    LogPrintf("Imported the contract state of block %s (height %d) in %dms\n", hashImportedState.GetHex(), nHeight, GetTimeMillis() - nStart);
+}
+
+void GetContractStateRoots(const CBlockIndex* pindex, dev::h256& stateRoot, dev::h256& utxoRoot)
+{
+    if (!hashImportedState.IsNull()) {
+        const CBlockIndex* pindexState = TrustedStateBlock();
+        if (pindexState && pindexState->GetAncestor(pindex->nHeight) == pindex)
+            pindex = pindexState;
+    }
+    stateRoot = uintToh256(pindex->hashStateRoot);
+    utxoRoot = uintToh256(pindex->hashUTXORoot);
+}
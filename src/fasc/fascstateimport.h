@@ -0,0 +1,67 @@
+#ifndef FASCSTATEIMPORT_H
+#define FASCSTATEIMPORT_H
+
+#include <fs.h>
+#include <uint256.h>
+
+#include <libdevcore/OverlayDB.h>
+
+#include <string>
+
+class CBlockIndex;
+
+/**
+ * Assumed valid contract state (-assumevalidstate, -importstate).
+ *
+ * The account and UTXO tries of a trusted block are imported from the contract state
+ * directory (stateFasc) of another node. The import walks both tries down from the
+ * roots in the block header and checks every node against the hash its parent holds,
+ * so it recomputes both roots and can't bring in a state the header doesn't commit to.
+ * It runs before blocks are connected, once the header of the trusted block is known,
+ * without holding cs_main.
+ *
+ * The trusted block and its ancestors are then connected on top of the imported state
+ * without executing their contract transactions: their coins and contract outputs are
+ * still checked, but their gas refunds, AAL transactions and state roots aren't, no
+ * receipts or logs are written for them, and the imported state stands in for theirs.
+ * Reorganizations below the trusted block are not supported.
+ */
+
+/** Hash of the block whose contract state may be imported (-assumevalidstate), null if none. */
+extern uint256 hashAssumeValidState;
+/** Contract state directory of another node to import the state from (-importstate). */
+extern fs::path pathImportState;
+
+/** Read which block's state was imported before, from the block tree database. */
+void LoadImportedState();
+
+/** Whether contract execution is skipped when connecting pindex: it is an ancestor of the imported state's block. */
+bool SkipContractExecution(const CBlockIndex* pindex);
+
+/**
+ * Import the state of the -assumevalidstate block when it is in the best header chain and
+ * not connected yet. Called before connecting blocks; the copy runs without holding cs_main.
+ */
+void ImportTrustedContractState();
+
+/** Roots of the contract state after pindex: the imported ones if its execution was skipped. */
+void GetContractStateRoots(const CBlockIndex* pindex, dev::h256& stateRoot, dev::h256& utxoRoot);
+
+/**
+ * Copy the account trie of stateRoot (storage tries and code included) and the UTXO trie
+ * of utxoRoot from the contract state directory path into stateDB and utxoDB, checking
+ * every node against its hash. Fails on any missing or corrupt node.
+ */
+bool ImportContractState(const fs::path& path, const dev::h256& stateRoot, const dev::h256& utxoRoot,
+                         dev::OverlayDB& stateDB, dev::OverlayDB& utxoDB, std::string& error);
+
+/**
+ * Copy the nodes of the account trie of stateRoot and the UTXO trie of utxoRoot that stateDB
+ * and utxoDB don't have from sourceState and sourceUTXO, checked the same way. Used to bring
+ * in a state computed on a private overlay whose parent state the destination has.
+ */
+bool CopyMissingContractState(const dev::OverlayDB& sourceState, const dev::OverlayDB& sourceUTXO,
+                              const dev::h256& stateRoot, const dev::h256& utxoRoot,
+                              dev::OverlayDB& stateDB, dev::OverlayDB& utxoDB, std::string& error);
+
+#endif // FASCSTATEIMPORT_H
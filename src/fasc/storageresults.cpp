@@ -1,18 +1,30 @@
 #include <fasc/storageresults.h>
 
-StorageResults::StorageResults(std::string const& _path)
+#include <dbwrapper.h>
+
+#include <leveldb/cache.h>
+#include <leveldb/env.h>
+#include <leveldb/filter_policy.h>
+
+StorageResults::StorageResults(std::string const& _path, size_t nCacheSize)
 {
     path = _path + "/resultsDB";
+    if (nCacheSize > 0)
+        options = GetLevelDBOptions(nCacheSize);
+    options.compression = GetDBCompression("receipts");
     options.create_if_missing = true;
     leveldb::Status status = leveldb::DB::Open(options, path, &db);
     assert(status.ok());
     LogPrintf("Opened LevelDB successfully\n");
+    RegisterLevelDB(path, db, nCacheSize, options.block_cache);
 }
 
 StorageResults::~StorageResults()
 {
+    UnregisterLevelDB(path);
     delete db;
     db = NULL;
+    FreeLevelDBOptions(options);
 }
 
 void StorageResults::addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result)
@@ -31,6 +43,16 @@ void StorageResults::wipeResults()
     leveldb::Status result = leveldb::DestroyDB(path, leveldb::Options());
 }
 
+bool StorageResults::writeFlushedBlock(uint256 const& hashBlock)
+{
+    return ::writeFlushedBlock(db, hashBlock);
+}
+
+bool StorageResults::readFlushedBlock(uint256& hashBlock) const
+{
+    return ::readFlushedBlock(db, hashBlock);
+}
+
 void StorageResults::deleteResults(std::vector<CTransactionRef> const& txs)
 {
     for (CTransactionRef tx : txs) {
@@ -101,61 +123,69 @@ void StorageResults::commitResults()
 bool StorageResults::readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result)
 {
     std::string value;
-    std::string keyTemp = _key.hex();
+    if (!getRawResult(_key, value))
+        return false;
+    return decodeResult(value, _result);
+}
+
+bool StorageResults::getRawResult(dev::h256 const& hashTx, std::string& raw) const
+{
+    std::string keyTemp = hashTx.hex();
     leveldb::Slice key(keyTemp);
-    leveldb::Status s = db->Get(leveldb::ReadOptions(), key, &value);
-
-    if (!s.IsNotFound() && s.ok()) {
-        TransactionReceiptInfoSerialized tris;
-
-        dev::RLP state(value);
-        tris.blockHashes = state[0].toVector<dev::h256>();
-        tris.blockNumbers = state[1].toVector<uint32_t>();
-        tris.transactionHashes = state[2].toVector<dev::h256>();
-        tris.transactionIndexes = state[3].toVector<uint32_t>();
-        tris.senders = state[4].toVector<dev::h160>();
-        tris.receivers = state[5].toVector<dev::h160>();
-        tris.cumulativeGasUsed = state[6].toVector<dev::u256>();
-        tris.gasUsed = state[7].toVector<dev::u256>();
-        tris.contractAddresses = state[8].toVector<dev::h160>();
-        tris.logs = state[9].toVector<logEntriesSerializ>();
-        if(state.itemCount() >= 11)
-            tris.excepted = state[10].toVector<uint32_t>();
-        if(state.itemCount() >= 12)
-            tris.exceptedMessage = state[11].toVector<std::string>();
-        if(state.itemCount() >= 13)
-            tris.outputIndexes = state[12].toVector<uint32_t>();
-        if(state.itemCount() >= 14)
-            tris.blooms = state[13].toVector<dev::h2048>();
-        if(state.itemCount() >= 15)
-            tris.stateRoots = state[14].toVector<dev::h256>();
-        if(state.itemCount() >= 16)
-            tris.utxoRoots = state[15].toVector<dev::h256>();
-
-        for (size_t j = 0; j < tris.blockHashes.size(); j++) {
-            TransactionReceiptInfo tri{
-                h256Touint(tris.blockHashes[j]), 
-                tris.blockNumbers[j], 
-                h256Touint(tris.transactionHashes[j]), 
-                tris.transactionIndexes[j], 
-                tris.senders[j],
-                tris.receivers[j], 
-                uint64_t(tris.cumulativeGasUsed[j]), 
-                uint64_t(tris.gasUsed[j]), 
-                tris.contractAddresses[j], 
-                logEntriesDeserialize(tris.logs[j]),
-                state.itemCount() >= 11 ? static_cast<dev::eth::TransactionException>(tris.excepted[j]) : dev::eth::TransactionException::NoInformation,
-                state.itemCount() >= 12 ? tris.exceptedMessage[j] : "",
-                state.itemCount() >= 13 ? tris.outputIndexes[j] : 0xffffffff,
-                state.itemCount() >= 14 ? tris.blooms[j] : dev::h2048(),
-                state.itemCount() >= 15 ? tris.stateRoots[j] : dev::h256(),
-                state.itemCount() >= 16 ? tris.utxoRoots[j] : dev::h256()
-                };
-            _result.push_back(tri);
-        }
-        return true;
+    leveldb::Status s = db->Get(leveldb::ReadOptions(), key, &raw);
+    return !s.IsNotFound() && s.ok();
+}
+
+bool StorageResults::decodeResult(std::string const& value, std::vector<TransactionReceiptInfo>& _result)
+{
+    TransactionReceiptInfoSerialized tris;
+
+    dev::RLP state(value);
+    tris.blockHashes = state[0].toVector<dev::h256>();
+    tris.blockNumbers = state[1].toVector<uint32_t>();
+    tris.transactionHashes = state[2].toVector<dev::h256>();
+    tris.transactionIndexes = state[3].toVector<uint32_t>();
+    tris.senders = state[4].toVector<dev::h160>();
+    tris.receivers = state[5].toVector<dev::h160>();
+    tris.cumulativeGasUsed = state[6].toVector<dev::u256>();
+    tris.gasUsed = state[7].toVector<dev::u256>();
+    tris.contractAddresses = state[8].toVector<dev::h160>();
+    tris.logs = state[9].toVector<logEntriesSerializ>();
+    if(state.itemCount() >= 11)
+        tris.excepted = state[10].toVector<uint32_t>();
+    if(state.itemCount() >= 12)
+        tris.exceptedMessage = state[11].toVector<std::string>();
+    if(state.itemCount() >= 13)
+        tris.outputIndexes = state[12].toVector<uint32_t>();
+    if(state.itemCount() >= 14)
+        tris.blooms = state[13].toVector<dev::h2048>();
+    if(state.itemCount() >= 15)
+        tris.stateRoots = state[14].toVector<dev::h256>();
+    if(state.itemCount() >= 16)
+        tris.utxoRoots = state[15].toVector<dev::h256>();
+
+    for (size_t j = 0; j < tris.blockHashes.size(); j++) {
+        TransactionReceiptInfo tri{
+            h256Touint(tris.blockHashes[j]), 
+            tris.blockNumbers[j], 
+            h256Touint(tris.transactionHashes[j]), 
+            tris.transactionIndexes[j], 
+            tris.senders[j],
+            tris.receivers[j], 
+            uint64_t(tris.cumulativeGasUsed[j]), 
+            uint64_t(tris.gasUsed[j]), 
+            tris.contractAddresses[j], 
+            logEntriesDeserialize(tris.logs[j]),
+            state.itemCount() >= 11 ? static_cast<dev::eth::TransactionException>(tris.excepted[j]) : dev::eth::TransactionException::NoInformation,
+            state.itemCount() >= 12 ? tris.exceptedMessage[j] : "",
+            state.itemCount() >= 13 ? tris.outputIndexes[j] : 0xffffffff,
+            state.itemCount() >= 14 ? tris.blooms[j] : dev::h2048(),
+            state.itemCount() >= 15 ? tris.stateRoots[j] : dev::h256(),
+            state.itemCount() >= 16 ? tris.utxoRoots[j] : dev::h256()
+            };
+        _result.push_back(tri);
     }
-    return false;
+    return true;
 }
 
 logEntriesSerializ StorageResults::logEntriesSerialization(dev::eth::LogEntries const& _logs)
@@ -175,3 +205,42 @@ dev::eth::LogEntries StorageResults::logEntriesDeserialize(logEntriesSerializ co
     }
     return result;
 }
+
+bool receiptMatchesTopics(TransactionReceiptInfo const& receipt, std::vector<boost::optional<dev::h256>> const& topics)
+{
+    if (topics.empty())
+        return true;
+    for (size_t i = 0; i < topics.size(); i++) {
+        if (!topics[i])
+            continue;
+        for (const auto& log : receipt.logs) {
+            if (i < log.topics.size() && topics[i].get() == log.topics[i])
+                return true;
+        }
+    }
+    return false;
+}
+
+static const std::string DB_FLUSHED_BLOCK = "flushedblock";
+
+bool writeFlushedBlock(leveldb::DB* db, uint256 const& hashBlock)
+{
+    leveldb::WriteOptions options;
+    options.sync = true;
+    leveldb::Status status = db->Put(options, DB_FLUSHED_BLOCK, leveldb::Slice((const char*)hashBlock.begin(), hashBlock.size()));
+    if (!status.ok()) {
+        LogPrintf("%s: %s\n", __func__, status.ToString());
+        return false;
+    }
+    return true;
+}
+
+bool readFlushedBlock(leveldb::DB* db, uint256& hashBlock)
+{
+    std::string value;
+    leveldb::Status status = db->Get(leveldb::ReadOptions(), DB_FLUSHED_BLOCK, &value);
+    if (!status.ok() || value.size() != hashBlock.size())
+        return false;
+    memcpy(hashBlock.begin(), value.data(), value.size());
+    return true;
+}
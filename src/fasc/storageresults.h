@@ -5,6 +5,8 @@
 #include <leveldb/db.h>
 #include <uint256.h>
 
+#include <boost/optional.hpp>
+
 using logEntriesSerializ = std::vector<std::pair<dev::Address, std::pair<dev::h256s, dev::bytes>>>;
 
 struct TransactionReceiptInfo {
@@ -48,7 +50,9 @@ struct TransactionReceiptInfoSerialized {
 class StorageResults
 {
 public:
-    StorageResults(std::string const& _path);
+    // Opens the database under _path, with the tuning of GetLevelDBOptions for a cache of
+    // nCacheSize, or LevelDB's defaults if 0.
+    StorageResults(std::string const& _path, size_t nCacheSize = 0);
     ~StorageResults();
 
     void addResult(dev::h256 hashTx, std::vector<TransactionReceiptInfo>& result);
@@ -57,18 +61,29 @@ public:
 
     std::vector<TransactionReceiptInfo> getResult(dev::h256 const& hashTx);
 
+    // Committed results of a transaction as stored, in RLP. Reads the database only, so it
+    // can be called without cs_main; results of a block being connected are not seen yet.
+    bool getRawResult(dev::h256 const& hashTx, std::string& raw) const;
+
+    static bool decodeResult(std::string const& raw, std::vector<TransactionReceiptInfo>& result);
+
     void commitResults();
 
     void clearCacheResult();
 
     void wipeResults();
 
+    // Sync the database and mark it with the block the chainstate is flushed at next.
+    bool writeFlushedBlock(uint256 const& hashBlock);
+
+    bool readFlushedBlock(uint256& hashBlock) const;
+
 private:
     bool readResult(dev::h256 const& _key, std::vector<TransactionReceiptInfo>& _result);
 
     logEntriesSerializ logEntriesSerialization(dev::eth::LogEntries const& _logs);
 
-    dev::eth::LogEntries logEntriesDeserialize(logEntriesSerializ const& _logs);
+    static dev::eth::LogEntries logEntriesDeserialize(logEntriesSerializ const& _logs);
 
     std::string path;
 
@@ -78,3 +93,13 @@ private:
 
     std::unordered_map<dev::h256, std::vector<TransactionReceiptInfo>> m_cache_result;
 };
+
+// Block a contract database was synced at before the last chainstate flush, under a key
+// that is neither a trie node's nor a receipt's. The write is synchronous, so that the
+// writes before it are on disk too.
+bool writeFlushedBlock(leveldb::DB* db, uint256 const& hashBlock);
+bool readFlushedBlock(leveldb::DB* db, uint256& hashBlock);
+
+// Whether a log of the receipt has, at some position, the topic the filter expects there.
+// Null topics of the filter match anything; an empty filter matches every receipt.
+bool receiptMatchesTopics(TransactionReceiptInfo const& receipt, std::vector<boost::optional<dev::h256>> const& topics);
@@ -18,6 +18,8 @@
 #include <stdio.h>
 
 
+#include <set>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 
 void avoidCompilerWarningsDefinedButNotUsedHttpRPC() {
@@ -27,6 +29,15 @@ void avoidCompilerWarningsDefinedButNotUsedHttpRPC() {
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Methods that wait for a block, logs or a new template, served by the long-poll worker threads */
+static const std::set<std::string> setLongPollMethods = {
+    "getblocktemplate",
+    "waitforblock",
+    "waitforblockheight",
+    "waitforlogs",
+    "waitfornewblock",
+};
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
  */
@@ -203,6 +214,15 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
                 return true;
             }
 
+            // Streamed by a JSONStreamWriter: end the chunked reply, now that the handler
+            // released its locks, or it was sent as a whole already
+            if (req->isChunkMode()) {
+                req->ChunkEnd();
+                return true;
+            }
+            if (req->ReplySent())
+                return true;
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -224,6 +244,23 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/** Whether the method of a request is one of setLongPollMethods, peeking at the body
+ * rather than parsing it. A batch is told by the method of its first call.
+ */
+static bool HTTPReq_JSONRPCIsLongPoll(HTTPRequest* req, const std::string &)
+{
+    std::string strAfter;
+    if (req->GetRequestMethod() != HTTPRequest::POST || !req->PeekBody("\"method\"", 64, strAfter))
+        return false;
+    size_t nStart = strAfter.find('"');
+    if (nStart == std::string::npos || strAfter.find_first_not_of(" \t\r\n:") != nStart)
+        return false;
+    size_t nEnd = strAfter.find('"', nStart + 1);
+    if (nEnd == std::string::npos)
+        return false;
+    return setLongPollMethods.count(strAfter.substr(nStart + 1, nEnd - nStart - 1)) > 0;
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -248,10 +285,10 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, HTTPReq_JSONRPCIsLongPoll);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API versioning
-    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, HTTPReq_JSONRPCIsLongPoll);
 #endif
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
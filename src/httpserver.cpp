@@ -71,10 +71,16 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    /** Work items with the time they were queued at */
+    std::deque<std::pair<std::unique_ptr<WorkItem>, int64_t>> queue;
     bool running;
     size_t maxDepth;
     int numThreads;
+    std::string name;
+    uint64_t nProcessed;
+    uint64_t nRejected;
+    int64_t nTotalWait;
+    int64_t nMaxWait;
 
     /** RAII object to keep track of number of running worker threads */
     class ThreadCounter
@@ -95,9 +101,14 @@ private:
     };
 
 public:
-    WorkQueue(size_t _maxDepth) : running(true),
+    WorkQueue(const std::string& _name, size_t _maxDepth) : running(true),
                                  maxDepth(_maxDepth),
-                                 numThreads(0)
+                                 numThreads(0),
+                                 name(_name),
+                                 nProcessed(0),
+                                 nRejected(0),
+                                 nTotalWait(0),
+                                 nMaxWait(0)
     {
     }
     /** Precondition: worker threads have all stopped
@@ -111,9 +122,10 @@ public:
     {
         std::unique_lock<std::mutex> lock(cs);
         if (queue.size() >= maxDepth) {
+            nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(std::unique_ptr<WorkItem>(item), GetTimeMicros());
         cond.notify_one();
         return true;
     }
@@ -129,8 +141,12 @@ public:
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                i = std::move(queue.front().first);
+                int64_t nWait = GetTimeMicros() - queue.front().second;
                 queue.pop_front();
+                nProcessed++;
+                nTotalWait += nWait;
+                nMaxWait = std::max(nMaxWait, nWait);
             }
             (*i)();
         }
@@ -149,18 +165,33 @@ public:
         while (numThreads > 0)
             cond.wait(lock);
     }
+    HTTPWorkQueueInfo Info()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        HTTPWorkQueueInfo info;
+        info.name = name;
+        info.threads = numThreads;
+        info.depth = queue.size();
+        info.maxDepth = maxDepth;
+        info.processed = nProcessed;
+        info.rejected = nRejected;
+        info.totalWaitMicros = nTotalWait;
+        info.maxWaitMicros = nMaxWait;
+        return info;
+    }
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPLongPollFilter _isLongPoll):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), isLongPoll(_isLongPoll)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPLongPollFilter isLongPoll;
 };
 
 /** HTTP module state */
@@ -173,6 +204,9 @@ struct evhttp* eventHTTP = 0;
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queue for long polls and other requests that block for long, so that they
+//! don't hold up the threads of the other requests
+static WorkQueue<HTTPClosure>* longPollQueue = 0;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -287,12 +321,15 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        bool fLongPoll = i->isLongPoll && i->isLongPoll(hreq.get(), path);
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        WorkQueue<HTTPClosure>* queue = fLongPoll ? longPollQueue : workQueue;
+        assert(queue);
+        if (queue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s queue depth exceeded, it can be increased with the %s= setting\n",
+                      fLongPoll ? "long-poll" : "work", fLongPoll ? "-rpclongpollqueue" : "-rpcworkqueue");
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -357,9 +394,9 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, const char* threadName)
 {
-    RenameThread("fabcoin-httpworker");
+    RenameThread(threadName);
     queue->Run();
 }
 
@@ -426,8 +463,11 @@ bool InitHTTPServer()
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    int longPollQueueDepth = std::max((long)gArgs.GetArg("-rpclongpollqueue", DEFAULT_HTTP_LONGPOLL_WORKQUEUE), 1L);
+    LogPrintf("HTTP: creating long-poll work queue of depth %d\n", longPollQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPClosure>("work", workQueueDepth);
+    longPollQueue = new WorkQueue<HTTPClosure>("long-poll", longPollQueueDepth);
     // tranfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -461,7 +501,13 @@ bool StartHTTPServer()
     threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
 
     for (int i = 0; i < rpcThreads; i++) {
-        std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
+        std::thread rpc_worker(HTTPWorkQueueRun, workQueue, "fabcoin-httpworker");
+        rpc_worker.detach();
+    }
+    int longPollThreads = std::max((long)gArgs.GetArg("-rpclongpollthreads", DEFAULT_HTTP_LONGPOLL_THREADS), 1L);
+    LogPrintf("HTTP: starting %d long-poll worker threads\n", longPollThreads);
+    for (int i = 0; i < longPollThreads; i++) {
+        std::thread rpc_worker(HTTPWorkQueueRun, longPollQueue, "fabcoin-httplongpoll");
         rpc_worker.detach();
     }
     return true;
@@ -480,6 +526,8 @@ void InterruptHTTPServer()
     }
     if (workQueue)
         workQueue->Interrupt();
+    if (longPollQueue)
+        longPollQueue->Interrupt();
 }
 
 void StopHTTPServer()
@@ -491,6 +539,11 @@ void StopHTTPServer()
         delete workQueue;
         workQueue = nullptr;
     }
+    if (longPollQueue) {
+        longPollQueue->WaitExit();
+        delete longPollQueue;
+        longPollQueue = nullptr;
+    }
     if (eventBase) {
         LogPrint(BCLog::HTTP, "Waiting for HTTP event thread to exit\n");
         // Give event loop a few seconds to exit (to send back last RPC responses), then break it
@@ -521,6 +574,16 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+std::vector<HTTPWorkQueueInfo> GetHTTPWorkQueueInfo()
+{
+    std::vector<HTTPWorkQueueInfo> vInfo;
+    if (workQueue)
+        vInfo.push_back(workQueue->Info());
+    if (longPollQueue)
+        vInfo.push_back(longPollQueue->Info());
+    return vInfo;
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -657,6 +720,27 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+bool HTTPRequest::PeekBody(const std::string& marker, size_t nLength, std::string& strOut)
+{
+#if LIBEVENT_VERSION_NUMBER >= 0x02010000
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return false;
+    struct evbuffer_ptr pos = evbuffer_search(buf, marker.data(), marker.size(), nullptr);
+    if (pos.pos < 0 || evbuffer_ptr_set(buf, &pos, marker.size(), EVBUFFER_PTR_ADD) < 0)
+        return false;
+    strOut.resize(nLength);
+    ev_ssize_t nRead = evbuffer_copyout_from(buf, &pos, &strOut[0], nLength);
+    if (nRead < 0)
+        return false;
+    strOut.resize(nRead);
+    return true;
+#else
+    // No evbuffer_copyout_from before libevent 2.1
+    return false;
+#endif
+}
+
 bool HTTPRequest::ReplySent() {
     return replySent;
 }
@@ -783,10 +867,11 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPLongPollFilter &isLongPoll)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, isLongPoll));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -8,11 +8,14 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
+static const int DEFAULT_HTTP_LONGPOLL_THREADS=8;
+static const int DEFAULT_HTTP_LONGPOLL_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
 
 struct evhttp_request;
@@ -40,11 +43,17 @@ bool UpdateHTTPServerLogging(bool enable);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Whether a request may block for long, e.g. a long poll, and is to be served
+ * by the long-poll worker threads (-rpclongpollthreads). Runs on the event loop
+ * thread: it must not read the body (see HTTPRequest::PeekBody).
+ */
+typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPLongPollFilter;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler,
+                         const HTTPLongPollFilter &isLongPoll = HTTPLongPollFilter());
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -53,6 +62,20 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+/** State of a work queue of the HTTP server, and the time its requests waited in it */
+struct HTTPWorkQueueInfo
+{
+    std::string name;
+    int threads;
+    size_t depth;
+    size_t maxDepth;
+    uint64_t processed;
+    uint64_t rejected;
+    int64_t totalWaitMicros;
+    int64_t maxWaitMicros;
+};
+std::vector<HTTPWorkQueueInfo> GetHTTPWorkQueueInfo();
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */
@@ -112,6 +135,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Find marker in the request body, and return up to nLength bytes following it,
+     * without consuming the body or copying the rest of it.
+     */
+    bool PeekBody(const std::string& marker, size_t nLength, std::string& strOut);
+
     /**
      * Write output header.
      *
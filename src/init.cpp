@@ -11,11 +11,18 @@
 
 #include <addrman.h>
 #include <amount.h>
+#include <blockfilemap.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <fasc/fascparallel.h>
+#include <fasc/fascprefetch.h>
+#include <fasc/fascpreexec.h>
+#include <fasc/fascprune.h>
+#include <fasc/fascsnapshot.h>
+#include <fasc/fascstateimport.h>
 #include <fs.h>
 #include <log_session.h>
 #include <httpserver.h>
@@ -162,6 +169,9 @@ public:
 };
 
 static CCoinsViewErrorCatcher *pcoinscatcher = nullptr;
+/** Options of the contract state databases: their cache, filter policy and logger live as long as globalState. */
+static leveldb::Options stateDBOptions;
+static leveldb::Options utxoDBOptions;
 static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 void Interrupt(boost::thread_group& threadGroup)
@@ -171,11 +181,28 @@ void Interrupt(boost::thread_group& threadGroup)
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
+    if (pcontractPreExecutor)
+        pcontractPreExecutor->Interrupt();
+    if (pcontractPrefetcher)
+        pcontractPrefetcher->Interrupt();
     if (g_connman)
         g_connman->Interrupt();
     threadGroup.interrupt_all();
 }
 
+/** Close the contract state databases, once they are out of getdbinfo, and free their options. */
+static void CloseContractState()
+{
+    if (globalState) {
+        const std::string dirFasc((GetDataDir() / "stateFasc").string());
+        UnregisterLevelDB(dirFasc);
+        UnregisterLevelDB(dirFasc + "/fascDB");
+    }
+    globalState.reset();
+    FreeLevelDBOptions(stateDBOptions);
+    FreeLevelDBOptions(utxoDBOptions);
+}
+
 void Shutdown()
 {
     LogPrintf("%s: In progress...\n", __func__);
@@ -211,6 +238,10 @@ void Shutdown()
     peerLogic.reset();
     g_connman.reset();
 
+    if (pcontractPreExecutor) {
+        UnregisterValidationInterface(pcontractPreExecutor.get());
+    }
+
     StopTorControl();
     if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
@@ -250,6 +281,8 @@ void Shutdown()
         }
         delete pcoinsTip;
         pcoinsTip = nullptr;
+        delete pcoinsflusher;
+        pcoinsflusher = nullptr;
         delete pcoinscatcher;
         pcoinscatcher = nullptr;
         delete pcoinsdbview;
@@ -258,7 +291,18 @@ void Shutdown()
         pblocktree = nullptr;
         delete pstorageresult;
         pstorageresult = nullptr;
-        delete globalState.release();
+        pblockfilemaps.reset();
+        pcontractPrefetcher.reset();
+        pcontractPreExecutor.reset();
+        dev::OverlayDB::setObserver(nullptr);
+        pstatePruner.reset();
+        if (pstateSnapshot) {
+            // Write the diff layers to disk, so that the next start doesn't generate the snapshot again.
+            globalState->setFlatStateReader(nullptr);
+            pstateSnapshot->Cap(globalState->rootHash(), 0);
+            pstateSnapshot.reset();
+        }
+        CloseContractState();
         globalSealEngine.reset();
     }
 #ifdef ENABLE_WALLET
@@ -290,6 +334,7 @@ void Shutdown()
     }
     vpwallets.clear();
 #endif
+    LogSession::flushAll();
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
@@ -357,11 +402,17 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("Print this help message and exit"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins database in the background while blocks are validated, once the coins cache takes half of -dbcache (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-blockmapfiles=<n>", strprintf(_("Keep up to <n> finalized block files memory mapped to read blocks from, 0 to read them with file I/O (default: %u)"), DEFAULT_BLOCK_MAP_FILES));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
     strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-assumevalidstate=<hex>", _("Import the contract state of this block from -importstate when it is in the chain, and connect it and its ancestors without executing their contract transactions. "
+            "Their contract state is not available and reorganizations below it are not possible"));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), FABCOIN_CONF_FILENAME));
+    strUsage += HelpMessageOpt("-contractprefetch", strprintf(_("Read the contract state touched by compact blocks in the background while their missing transactions are requested (default: %u)"), DEFAULT_CONTRACT_PREFETCH));
+    strUsage += HelpMessageOpt("-contractpreexec", strprintf(_("Execute contract transactions from the mempool in the background and reuse the results when connecting or assembling blocks (default: %u)"), DEFAULT_CONTRACT_PREEXEC));
     if (mode == HMM_FABCOIND)
     {
 #if HAVE_DECL_DAEMON
@@ -373,8 +424,12 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
     }
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbcompression=[<db>:]<codec>", _("Compress the tables newly written to a database, or to all if none is given: blockindex, chainstate, evmstate or receipts. "
+        "Codecs: none (default), snappy or zstd, if supported by the build. Can be specified multiple times"));
+    strUsage += HelpMessageOpt("-evmdbcache=<n>", strprintf(_("Part of -dbcache in megabytes for the contract state and receipt databases, at most a quarter of it (default: %d)"), nDefaultEVMDBCache));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
+    strUsage += HelpMessageOpt("-importstate=<dir>", _("Contract state directory (stateFasc) of another node to import the state of the -assumevalidstate block from. Every imported trie node is checked against the block's state roots"));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -386,15 +441,19 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-parallelcontracts", strprintf(_("Execute independent contract transactions of a block in parallel, on as many threads of their own as -par sets for script verification (default: %u)"), DEFAULT_PARALLEL_CONTRACTS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), FABCOIN_PID_FILENAME));
 #endif
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
+    strUsage += HelpMessageOpt("-prunestate=<n>", strprintf(_("Delete contract state that is no longer reachable from the last <n> blocks, in the background. "
+            "Reorganizations and state queries further back are not possible. Disables -contractpreexec. (default: %u = keep all state, minimum %u)"), DEFAULT_PRUNE_STATE, MIN_BLOCKS_TO_KEEP));
     strUsage += HelpMessageOpt("-record-log-opcodes", strprintf(_("Logs all EVM LOG opcode operations to the file vmExecLogs.json")));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
+    strUsage += HelpMessageOpt("-statesnapshot", strprintf(_("Maintain a flat snapshot of the contract state, so that account and storage reads take one database lookup. Disables -contractpreexec. (default: %u)"), DEFAULT_STATE_SNAPSHOT));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -406,6 +465,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-banscore=<n>", strprintf(_("Threshold for disconnecting misbehaving peers (default: %u)"), DEFAULT_BANSCORE_THRESHOLD));
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
+    strUsage += HelpMessageOpt("-compactheaders", strprintf(_("Exchange headers in the compact headers2 encoding with peers that support it (default: %u)"), DEFAULT_COMPACT_HEADERS));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s); -connect=0 disables automatic connections"));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + strprintf(_("(default: %u)"), DEFAULT_NAME_LOOKUP));
@@ -418,6 +478,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXRECEIVEBUFFER));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), DEFAULT_MAXSENDBUFFER));
     strUsage += HelpMessageOpt("-maxtimeadjustment", strprintf(_("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)"), DEFAULT_MAX_TIME_ADJUSTMENT));
+    strUsage += HelpMessageOpt("-msgparsethreads=<n>", strprintf(_("Deserialize received block, headers and cmpctblock messages on <n> threads ahead of processing them, 0 to deserialize them while processing (default: %d)"), DEFAULT_MESSAGE_PARSE_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
@@ -426,6 +487,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("How to wait for sockets to become ready, one of: %s (default: %s). select limits connections to FD_SETSIZE"), GetSupportedSocketEventsModes(), GetSocketEventsModeName(DEFAULT_SOCKETEVENTS)));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
@@ -449,10 +511,12 @@ std::string HelpMessage(HelpMessageMode mode)
 
 #if ENABLE_ZMQ
     strUsage += HelpMessageGroup(_("ZeroMQ notification options:"));
+    strUsage += HelpMessageOpt("-zmqpubcontractlog=<address>", _("Enable publish contract event logs in <address> (requires -logevents)"));
     strUsage += HelpMessageOpt("-zmqpubhashblock=<address>", _("Enable publish hash block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubreceipt=<address>", _("Enable publish contract transaction receipts in <address> (requires -logevents)"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -464,6 +528,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
+        strUsage += HelpMessageOpt("-checkstatesnapshot", strprintf("Compare the contract state snapshot with the state trie at startup, and generate it again if they differ (default: %u)", DEFAULT_CHECK_STATE_SNAPSHOT));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
         strUsage += HelpMessageOpt("-testsafemode", strprintf("Force safe mode (default: %u)", DEFAULT_TESTSAFEMODE));
         strUsage += HelpMessageOpt("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages");
@@ -555,9 +620,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
+    strUsage += HelpMessageOpt("-rpcbatchconcurrency=<n>", strprintf(_("Run up to <n> read-only calls of a JSON-RPC batch at once (default: %d)"), DEFAULT_RPC_BATCH_CONCURRENCY));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Set the number of threads to run the read-only calls of JSON-RPC batches, shared by all batches (0 = one per core, 1 = run batches serially, default: %d)"), DEFAULT_RPC_BATCH_THREADS));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpclongpollthreads=<n>", strprintf(_("Set the number of threads to service long polls and other RPC calls that wait for blocks or logs, apart from the others (default: %d)"), DEFAULT_HTTP_LONGPOLL_THREADS));
+    strUsage += HelpMessageOpt("-rpcmethodlimit=<method>:<n>", _("Allow at most <n> calls to <method> at once, rejecting the others. This option can be specified multiple times"));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpclongpollqueue=<n>", strprintf("Set the depth of the work queue to service long polls, apart from -rpcworkqueue (default: %d)", DEFAULT_HTTP_LONGPOLL_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
@@ -876,6 +946,7 @@ int nMaxConnections;
 int nUserMaxConnections;
 int nFD;
 ServiceFlags nLocalServices = NODE_NETWORK;
+SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
 
 } // namespace
 
@@ -977,13 +1048,18 @@ bool AppInitParameterInteraction()
         return InitError("Cannot set -bind or -whitebind together with -listen=0");
     }
 
+    std::string strSocketEvents = gArgs.GetArg("-socketevents", GetSocketEventsModeName(DEFAULT_SOCKETEVENTS));
+    if (!ParseSocketEventsMode(strSocketEvents, socketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents mode '%s', supported: %s"), strSocketEvents, GetSupportedSocketEventsModes()));
+
     // Make sure enough file descriptors are available
     int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections = gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1051,6 +1127,14 @@ bool AppInitParameterInteraction()
     else
         LogPrintf("Validating signatures for all blocks.\n");
 
+    hashAssumeValidState = uint256S(gArgs.GetArg("-assumevalidstate", ""));
+    if (!hashAssumeValidState.IsNull()) {
+        if (!gArgs.IsArgSet("-importstate"))
+            return InitError(_("-assumevalidstate requires -importstate."));
+        pathImportState = fs::absolute(gArgs.GetArg("-importstate", ""));
+        LogPrintf("Importing the contract state of block %s from %s when it is in the chain.\n", hashAssumeValidState.GetHex(), pathImportState.string());
+    }
+
     if (gArgs.IsArgSet("-minimumchainwork")) {
         const std::string minChainWorkStr = gArgs.GetArg("-minimumchainwork", "");
         if (!IsHexNumber(minChainWorkStr)) {
@@ -1088,6 +1172,7 @@ bool AppInitParameterInteraction()
         nScriptCheckThreads = 0;
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+    fParallelContracts = gArgs.GetBoolArg("-parallelcontracts", DEFAULT_PARALLEL_CONTRACTS);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
@@ -1107,6 +1192,26 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    // contract state pruning; keep the state of the last nPruneStateDepth blocks
+    int64_t nPruneStateArg = gArgs.GetArg("-prunestate", DEFAULT_PRUNE_STATE);
+    if (nPruneStateArg < 0) {
+        return InitError(_("State pruning cannot be configured with a negative value."));
+    }
+    if (nPruneStateArg > 0 && nPruneStateArg < (int64_t)MIN_BLOCKS_TO_KEEP) {
+        return InitError(strprintf(_("State pruning configured below the minimum of %d blocks.  Please use a higher number."), MIN_BLOCKS_TO_KEEP));
+    }
+    nPruneStateDepth = nPruneStateArg;
+    if (nPruneStateDepth && gArgs.GetBoolArg("-contractpreexec", DEFAULT_CONTRACT_PREEXEC)) {
+        // Speculative executions write state that no block refers to, which a collection would delete under them.
+        InitWarning(_("-contractpreexec is disabled by -prunestate."));
+        gArgs.ForceSetArg("-contractpreexec", "0");
+    }
+    if (gArgs.GetBoolArg("-statesnapshot", DEFAULT_STATE_SNAPSHOT) && gArgs.GetBoolArg("-contractpreexec", DEFAULT_CONTRACT_PREEXEC)) {
+        // Reused executions set the state without the changes the snapshot is updated with.
+        InitWarning(_("-contractpreexec is disabled by -statesnapshot."));
+        gArgs.ForceSetArg("-contractpreexec", "0");
+    }
+
     ParseKanbanId();
 
     RegisterAllCoreRPCCommands(tableRPC);
@@ -1173,6 +1278,8 @@ bool AppInitParameterInteraction()
 
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
+    if (gArgs.GetBoolArg("-compactheaders", DEFAULT_COMPACT_HEADERS))
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_HEADERS);
 
     if (gArgs.GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
@@ -1319,12 +1426,20 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        if (fParallelContracts) {
+            for (int i=0; i<nScriptCheckThreads-1; i++)
+                threadGroup.create_thread(&ThreadContractCheck);
+        }
     }
 
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
+    if (LogSession::flagLogsTurnedOn) {
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "logflush", &LogSession::ThreadFlush));
+    }
+
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
 
     /* Start the RPC server already.  It will be started in "warmup" mode
@@ -1357,6 +1472,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CConnman& connman = *g_connman;
 
     peerLogic.reset(new PeerLogicValidation(&connman, scheduler));
+    peerLogic->StartMessageParsers(std::max((int)gArgs.GetArg("-msgparsethreads", DEFAULT_MESSAGE_PARSE_THREADS), 0));
     RegisterValidationInterface(peerLogic.get());
 
     // sanitize comments per BIP-0014, format user agent and check total size
@@ -1451,6 +1567,9 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (pzmqNotificationInterface) {
         RegisterValidationInterface(pzmqNotificationInterface);
     }
+    if ((gArgs.IsArgSet("-zmqpubreceipt") || gArgs.IsArgSet("-zmqpubcontractlog")) && !gArgs.GetBoolArg("-logevents", DEFAULT_LOGEVENTS)) {
+        InitWarning(_("-zmqpubreceipt and -zmqpubcontractlog publish nothing unless -logevents is enabled."));
+    }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
     uint64_t nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
@@ -1464,6 +1583,17 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
 
+    for (const std::string& strCompression : gArgs.GetArgs("-dbcompression")) {
+        std::string strError;
+        if (!SetDBCompression(strCompression, strError))
+            return InitError(strError);
+    }
+
+    int nBlockMapFiles = gArgs.GetArg("-blockmapfiles", DEFAULT_BLOCK_MAP_FILES);
+    if (nBlockMapFiles < 0)
+        return InitError(strprintf(_("Invalid -blockmapfiles value: %d"), nBlockMapFiles));
+    pblockfilemaps.reset(new CBlockFileMapPool(GetDataDir() / "blocks", nBlockMapFiles));
+
     // cache size calculations
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
@@ -1471,6 +1601,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nEVMDBCache = std::max<int64_t>(0, gArgs.GetArg("-evmdbcache", nDefaultEVMDBCache) << 20);
+    nEVMDBCache = std::min(nEVMDBCache, nTotalCache / 4);
+    nTotalCache -= nEVMDBCache;
+    // The trie nodes of the state take most of it, the contract UTXOs least
+    int64_t nEVMStateDBCache = nEVMDBCache / 2;
+    int64_t nEVMResultsDBCache = nEVMDBCache / 4 + nEVMDBCache / 8;
+    int64_t nEVMUTXODBCache = nEVMDBCache - nEVMStateDBCache - nEVMResultsDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1479,8 +1616,11 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for contract state and receipt databases\n", nEVMDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
+    const fs::path fascStateDir = GetDataDir() / "stateFasc";
+    const std::string dirFasc(fascStateDir.string());
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
@@ -1493,11 +1633,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsflusher;
+                pcoinsflusher = nullptr;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
                 delete pstorageresult;
-                globalState.reset();
+                CloseContractState();
                 globalSealEngine.reset();
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReset);
@@ -1559,7 +1701,13 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 }
 
                 // The on-disk coinsdb is now in a good state, create the cache
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                if (gArgs.GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH)) {
+                    pcoinsflusher = new CCoinsViewBackgroundFlush(pcoinscatcher);
+                    pcoinsflusher->Start();
+                    pcoinsTip = new CCoinsViewCache(pcoinsflusher);
+                } else {
+                    pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                }
 
                 bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
                 if (!is_coinsview_empty) {
@@ -1580,23 +1728,29 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 }
 
                 dev::eth::NoProof::init();
-                fs::path fascStateDir = GetDataDir() / "stateFasc";
                 bool fStatus = fs::exists(fascStateDir);
-                const std::string dirFasc(fascStateDir.string());
                 const dev::h256 hashDB(dev::sha3(dev::rlp("")));
                 dev::eth::BaseState existsFascstate = fStatus ? dev::eth::BaseState::PreExisting : dev::eth::BaseState::Empty;
-                globalState = std::unique_ptr<FascState>(new FascState(dev::u256(0), FascState::openDB(dirFasc, hashDB, dev::WithExisting::Trust), dirFasc, existsFascstate));
+                // Freed by CloseContractState, along with the databases.
+                stateDBOptions = GetLevelDBOptions(nEVMStateDBCache, GetDBCompression("evmstate"));
+                utxoDBOptions = GetLevelDBOptions(nEVMUTXODBCache, GetDBCompression("evmstate"));
+                globalState = std::unique_ptr<FascState>(new FascState(dev::u256(0), FascState::openDB(dirFasc, hashDB, dev::WithExisting::Trust, stateDBOptions), dirFasc, existsFascstate, utxoDBOptions));
+                RegisterLevelDB(dirFasc, globalState->db().db(), nEVMStateDBCache, stateDBOptions.block_cache);
+                RegisterLevelDB(dirFasc + "/fascDB", globalState->dbUtxo().db(), nEVMUTXODBCache, utxoDBOptions.block_cache);
                 dev::eth::ChainParams cp(chainparams.EVMGenesisInfo());
                 globalSealEngine = std::unique_ptr<dev::eth::SealEngineFace>(cp.createSealEngine());
 
-                pstorageresult = new StorageResults(fascStateDir.string());
+                pstorageresult = new StorageResults(fascStateDir.string(), nEVMResultsDBCache);
                 if (fReset) {
                     pstorageresult->wipeResults();
                 }
 
+                LoadImportedState();
                 if(chainActive.Tip() != nullptr && !chainActive.Tip()->hashStateRoot.IsNull() && !chainActive.Tip()->hashUTXORoot.IsNull() ){
-                    globalState->setRoot(uintToh256(chainActive.Tip()->hashStateRoot));
-                    globalState->setRootUTXO(uintToh256(chainActive.Tip()->hashUTXORoot));
+                    dev::h256 tipStateRoot, tipUTXORoot;
+                    GetContractStateRoots(chainActive.Tip(), tipStateRoot, tipUTXORoot);
+                    globalState->setRoot(tipStateRoot);
+                    globalState->setRootUTXO(tipUTXORoot);
                 } else {
                     globalState->setRoot(dev::sha3(dev::rlp("")));
                     globalState->setRootUTXO(uintToh256(chainparams.GenesisBlock().hashUTXORoot));
@@ -1605,6 +1759,12 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
                 globalState->db().commit();
                 globalState->dbUtxo().commit();
 
+                std::string strFlushError;
+                if (!is_coinsview_empty && !CheckContractFlushMarkers(strFlushError)) {
+                    strLoadError = strprintf(_("%s. You will need to rebuild the database using -reindex-chainstate."), strFlushError);
+                    break;
+                }
+
                 fRecordLogOpcodes = gArgs.IsArgSet("-record-log-opcodes");
                 fIsVMlogFile = fs::exists(GetDataDir() / "vmExecLogs.json");
                 ///////////////////////////////////////////////////////////
@@ -1707,6 +1867,42 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
         ::feeEstimator.Read(est_filein);
     fFeeEstimatesInitialized = true;
 
+    if (gArgs.GetBoolArg("-contractpreexec", DEFAULT_CONTRACT_PREEXEC)) {
+        pcontractPreExecutor.reset(new ContractPreExecutor());
+        RegisterValidationInterface(pcontractPreExecutor.get());
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "preexec", &ThreadContractPreExecution));
+    }
+
+    if (nPruneStateDepth) {
+        LogPrintf("Contract state pruning enabled, keeping the state of the last %u blocks.\n", nPruneStateDepth);
+        pstatePruner.reset(new StatePruner(nPruneStateDepth));
+        dev::OverlayDB::setObserver(pstatePruner.get());
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "stateprune", &ThreadStatePrune));
+    }
+
+    if (gArgs.GetBoolArg("-statesnapshot", DEFAULT_STATE_SNAPSHOT)) {
+        LOCK(cs_main);
+        uiInterface.InitMessage(_("Loading contract state snapshot..."));
+        pstateSnapshot.reset(new StateSnapshot(GetDataDir() / "stateSnapshot", STATE_SNAPSHOT_CACHE, globalState->db()));
+        bool fSnapshot = pstateSnapshot->Load(globalState->rootHash());
+        std::string strError;
+        if (fSnapshot && gArgs.GetBoolArg("-checkstatesnapshot", DEFAULT_CHECK_STATE_SNAPSHOT) && !pstateSnapshot->Verify(globalState->rootHash(), strError)) {
+            LogPrintf("Contract state snapshot check failed: %s\n", strError);
+            fSnapshot = pstateSnapshot->Regenerate(globalState->rootHash());
+        }
+        if (fSnapshot) {
+            globalState->setFlatStateReader(pstateSnapshot.get());
+        } else {
+            InitWarning(_("Unable to generate the contract state snapshot, reading the state from the trie only."));
+            pstateSnapshot.reset();
+        }
+    }
+
+    if (gArgs.GetBoolArg("-contractprefetch", DEFAULT_CONTRACT_PREFETCH)) {
+        pcontractPrefetcher.reset(new ContractStatePrefetcher());
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "prefetch", &ThreadContractPrefetch));
+    }
+
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (!CWallet::InitLoadWallet())
@@ -1797,6 +1993,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     connOptions.nMaxOutbound = std::min(MAX_OUTBOUND_CONNECTIONS, connOptions.nMaxConnections);
     connOptions.nMaxAddnode = MAX_ADDNODE_CONNECTIONS;
     connOptions.nMaxFeeler = 1;
+    connOptions.socketEventsMode = socketEventsMode;
     connOptions.nBestHeight = chainActive.Height();
     connOptions.uiInterface = &uiInterface;
     connOptions.m_msgproc = peerLogic.get();
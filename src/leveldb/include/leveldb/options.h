@@ -24,7 +24,8 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression     = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression   = 0x2
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -138,8 +139,16 @@ struct Options {
   // worth switching to kNoCompression.  Even if the input data is
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
+  //
+  // kZstdCompression compresses better than kSnappyCompression, at a
+  // higher CPU cost, with zstd_compression_level.
   CompressionType compression;
 
+  // Level of kZstdCompression, from 1 (fastest) to 22.
+  //
+  // Default: 1
+  int zstd_compression_level;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -122,6 +122,27 @@ extern bool Snappy_GetUncompressedLength(const char* input, size_t length,
 extern bool Snappy_Uncompress(const char* input_data, size_t input_length,
                               char* output);
 
+// Store the zstd compression of "input[0,input_length-1]" at the given
+// level in *output. Returns false if zstd is not supported by this port.
+extern bool Zstd_Compress(int level, const char* input, size_t input_length,
+                          std::string* output);
+
+// If input[0,input_length-1] looks like a valid zstd compressed
+// buffer, store the size of the uncompressed data in *result and
+// return true.  Else return false.
+extern bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result);
+
+// Attempt to zstd uncompress input[0,input_length-1] into *output.
+// Returns true if successful, false if the input is invalid zstd
+// compressed data.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+extern bool Zstd_Uncompress(const char* input_data, size_t input_length,
+                            char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
@@ -42,6 +42,9 @@
 #ifdef SNAPPY
 #include <snappy.h>
 #endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include <stdint.h>
 #include <string>
 #include "port/atomic_pointer.h"
@@ -148,6 +151,49 @@ inline bool Snappy_Uncompress(const char* input, size_t length,
 #endif
 }
 
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          ::std::string* output) {
+#ifdef HAVE_ZSTD
+  output->resize(ZSTD_compressBound(length));
+  size_t outlen = ZSTD_compress(&(*output)[0], output->size(), input, length,
+                                level);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#ifdef HAVE_ZSTD
+  unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  *result = size;
+  return true;
+#else
+  return false;
+#endif
+}
+
+inline bool Zstd_Uncompress(const char* input, size_t length, char* output) {
+#ifdef HAVE_ZSTD
+  size_t ulength;
+  if (!Zstd_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  size_t outlen = ZSTD_decompress(output, ulength, input, length);
+  return !ZSTD_isError(outlen) && outlen == ulength;
+#else
+  return false;
+#endif
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   return false;
 }
@@ -23,6 +23,7 @@ Options::Options()
       block_restart_interval(16),
       max_file_size(2<<20),
       compression(kSnappyCompression),
+      zstd_compression_level(1),
       reuse_logs(false),
       filter_policy(NULL) {
 }
@@ -5,6 +5,12 @@
 
 #include "log_session.h"
 #include <util.h>
+#include <utiltime.h>
+
+#include <algorithm>
+#include <cassert>
+
+#include <boost/thread.hpp>
 
 std::string LogSession::currentNetworkName = "";
 bool LogSession::flagLogsTurnedOn = false;
@@ -12,18 +18,14 @@ bool LogSession::flagLogsForwardedToStdOut = false;
 
 LogSession& LogSession::debugLog()
 {
-    static LogSession result;
-    result.name = "debug";
-    result.fileName = (GetDataDir() / "debug_session.log").string();
+    static LogSession result("debug", (GetDataDir() / "debug_session.log").string());
     result.initialize();
     return result;
 }
 
 LogSession& LogSession::evmLog()
 {
-    static LogSession result;
-    result.name = "myEvm";
-    result.fileName = (GetDataDir() / "myEvm.log").string();
+    static LogSession result("myEvm", (GetDataDir() / "myEvm.log").string());
     result.initialize();
     return result;
 }
@@ -38,26 +40,143 @@ void LogSession::initialize()
     if (this->fileName == "") {
         return;
     }
-    this->initialized = true;
+    std::lock_guard<std::mutex> theGuard(this->lock);
+    if (this->initialized)
+        return;
     this->file.open(this->fileName, std::fstream::in | std::fstream::out | std::fstream::trunc);
     if (!this->file.is_open()) {
         std::cout << "Fatal error: failed to open log file: " << this->fileName << std::endl;
     }
+    this->initialized = true;
 }
 
-LogSession::LogSession()
+LogSession::LogSession(const std::string& inputName, const std::string& inputFileName)
 {
+    static std::atomic<unsigned> numberOfSessions(0);
+    this->name = inputName;
+    this->index = numberOfSessions ++;
+    assert(this->index < LogSession::maximumSessions);
+    this->fileName = inputFileName;
     this->maximumLinesToStore = 10000;
     this->numberOfDeletedLines = 0;
+    this->numberOfDroppedLines = 0;
     this->initialized = false;
 }
 
+LogSession::ThreadBuffer::ThreadBuffer(size_t capacity) : retired(false), slots(capacity), head(0), tail(0)
+{
+}
+
+bool LogSession::ThreadBuffer::Push(std::string& line)
+{
+    uint64_t writePosition = this->head.load(std::memory_order_relaxed);
+    if (writePosition - this->tail.load(std::memory_order_acquire) >= this->slots.size()) {
+        return false;
+    }
+    // Swapping hands the slot's previous allocation back to the writer for the next line.
+    this->slots[writePosition % this->slots.size()].swap(line);
+    this->head.store(writePosition + 1, std::memory_order_release);
+    return true;
+}
+
+namespace {
+// The buffers of the calling thread, by session index. The sessions also hold them, so
+// that the lines written just before the thread exits still get flushed.
+struct ThreadBuffers {
+    std::shared_ptr<LogSession::ThreadBuffer> sessions[LogSession::maximumSessions];
+    ~ThreadBuffers() {
+        for (const std::shared_ptr<LogSession::ThreadBuffer>& buffer : this->sessions) {
+            if (buffer) {
+                buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+    }
+};
+thread_local ThreadBuffers threadBuffers;
+}
+
+LogSession::ThreadBuffer& LogSession::threadBuffer()
+{
+    std::shared_ptr<ThreadBuffer>& result = threadBuffers.sessions[this->index];
+    if (!result) {
+        result = std::make_shared<ThreadBuffer>(size_t(LogSession::linesPerThreadBuffer));
+        std::lock_guard<std::mutex> theGuard(this->lockBuffers);
+        this->buffers.push_back(result);
+    }
+    return *result;
+}
+
+void LogSession::flush()
+{
+    std::vector<std::shared_ptr<ThreadBuffer> > currentBuffers;
+    {
+        std::lock_guard<std::mutex> theGuard(this->lockBuffers);
+        currentBuffers = this->buffers;
+    }
+    std::lock_guard<std::mutex> theGuard(this->lock);
+    bool wroteToFile = false;
+    std::vector<std::shared_ptr<ThreadBuffer> > retiredBuffers;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : currentBuffers) {
+        // Checked before draining: a retired buffer gets no more lines.
+        if (buffer->retired.load(std::memory_order_acquire)) {
+            retiredBuffers.push_back(buffer);
+        }
+        buffer->Drain([this, &wroteToFile](const std::string& line) {
+            if (this->file.is_open()) {
+                this->file << line << "\n";
+                wroteToFile = true;
+            }
+            if (this->flagLogsForwardedToStdOut) {
+                std::cout << line << std::endl;
+            }
+            this->lines.push_back(line);
+            if (this->lines.size() > this->maximumLinesToStore) {
+                this->lines.pop_front();
+                this->numberOfDeletedLines ++;
+            }
+        });
+    }
+    if (wroteToFile) {
+        this->file.flush();
+    }
+    if (!retiredBuffers.empty()) {
+        std::lock_guard<std::mutex> theGuardBuffers(this->lockBuffers);
+        for (const std::shared_ptr<ThreadBuffer>& buffer : retiredBuffers) {
+            this->buffers.erase(std::find(this->buffers.begin(), this->buffers.end(), buffer));
+        }
+    }
+}
+
+void LogSession::flushAll()
+{
+    if (!LogSession::flagLogsTurnedOn) {
+        return;
+    }
+    LogSession::debugLog().flush();
+    LogSession::evmLog().flush();
+}
+
+void LogSession::ThreadFlush()
+{
+    try {
+        while (true) {
+            LogSession::flushAll();
+            MilliSleep(LogSession::flushIntervalInMilliseconds);
+        }
+    } catch (const boost::thread_interrupted&) {
+        LogSession::flushAll();
+        throw;
+    }
+}
+
 std::string LogSession::ToStringStatistics() {
     std::stringstream out;
     out << "Displaying " << this->lines.size() << " lines. ";
     if (this->numberOfDeletedLines > 0)
         out << "In addition " << this->numberOfDeletedLines << " have been pruned (total lines: "
             << this->lines.size() + this->numberOfDeletedLines << "). ";
+    if (this->numberOfDroppedLines > 0)
+        out << this->numberOfDroppedLines << " lines were dropped because their thread's buffer was full. ";
     out << "Log name: " << this->name << ". ";
     if (this->fileName == "") {
         out << "The lines are not logged in a file. ";
@@ -75,21 +194,13 @@ LogSession& LogSession::operator<<(specialSymbols input) {
     }
     this->initialize();
     if (input == LogSession::endL) {
-        std::lock_guard<std::mutex> theGuard(this->lock);
-        this->lines.push_back(this->currentLine);
-        if (this->fileName != "") {
-            this->file << this->currentLine << "\n";
-            this->file.flush();
-        }
-        if (this->flagLogsForwardedToStdOut) {
-            std::cout << this->currentLine << std::endl;
+        ThreadBuffer& buffer = this->threadBuffer();
+        std::string line = buffer.currentLine.str();
+        buffer.currentLine.str(std::string());
+        buffer.currentLine.clear();
+        if (!buffer.Push(line)) {
+            this->numberOfDroppedLines ++;
         }
-        if (this->lines.size() > this->maximumLinesToStore) {
-            this->lines.pop_front();
-            this->numberOfDeletedLines ++;
-        }
-        this->currentLine = "";
-
     }
     return *this;
 }
@@ -3,38 +3,72 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #ifndef LOG_SESSION_H
 #define LOG_SESSION_H
+#include <atomic>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <deque>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 // Example use:
 // LogSession::evmLog() << "Debug: data I want to log. " << LogSession::endL;
 // Your data will be cached in a queue (with a size limit) and flushed to a file.
 // If no filename is specified, only the ram cache is used.
-// Each call of operator<< locks a mutex, so excessive use will penalize performance
-// (far less than the actual disk I/O if you are also writing the file).
+// Writing does not lock: each thread assembles its lines in its own buffer and hands
+// finished lines to a preallocated ring. A background thread (ThreadFlush) moves them
+// to the ram cache, the file and stdout. If a ring fills up before it is flushed,
+// further lines of that thread are dropped and counted in numberOfDroppedLines.
+// The buffers of a thread are released once it has exited and its last lines are flushed.
 class LogSession {
 public:
+    // Lines of one thread: written by that thread only, drained by the flusher only.
+    class ThreadBuffer {
+    public:
+        explicit ThreadBuffer(size_t capacity);
+        std::ostringstream currentLine; //<- only touched by the owning thread
+        std::atomic<bool> retired; //<- set when the owning thread exits; the flusher then drains and drops the buffer.
+        bool Push(std::string& line); //<- swaps line into the ring, returns false if the ring is full.
+        template <typename Consumer>
+        void Drain(Consumer consume) {
+            uint64_t readPosition = this->tail.load(std::memory_order_relaxed);
+            uint64_t writePosition = this->head.load(std::memory_order_acquire);
+            for (; readPosition != writePosition; readPosition ++) {
+                consume(this->slots[readPosition % this->slots.size()]);
+            }
+            this->tail.store(readPosition, std::memory_order_release);
+        }
+    private:
+        std::vector<std::string> slots;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+    };
+
     static std::string currentNetworkName;
     static bool flagLogsTurnedOn;
     static bool flagLogsForwardedToStdOut;
+    static const unsigned linesPerThreadBuffer = 1024;
+    static const unsigned maximumSessions = 8; //<- sessions a thread may write to, each has a slot in its buffers.
+    static const unsigned flushIntervalInMilliseconds = 100;
     unsigned maximumLinesToStore;
     std::string name; //<- session name, for example, debug or evm.
+    unsigned index; //<- slot of this session in the buffers of each thread.
     std::string fileName; //<- reserved
     std::fstream file;
     std::deque<std::string> lines;
     int64_t numberOfDeletedLines;
-    std::string currentLine;
-    std::mutex lock;
-    bool initialized;
+    std::atomic<int64_t> numberOfDroppedLines;
+    std::mutex lock; //<- guards lines and file; taken by the flusher and by readers, never by writers.
+    std::mutex lockBuffers; //<- guards buffers; taken once per thread, on its first write.
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers;
+    std::atomic<bool> initialized;
 
-    LogSession();
+    LogSession(const std::string& inputName, const std::string& inputFileName);
     static LogSession& evmLog(); //<- use to fetch a global logfile. This is a function to avoid the "static initialization order fiasco".
     static LogSession& debugLog(); //<- use to fetch a global logfile.
     enum specialSymbols{
-        endL, //<- use log << LogSession::endL to end the line and flush the log file.
+        endL, //<- use log << LogSession::endL to end the line and hand it to the flusher.
         //not used at the moment but reserved for future use:
         red, blue, yellow, green, purple, cyan, normalColor, orange
     };
@@ -50,12 +84,14 @@ public:
         if (!this->flagLogsTurnedOn) {
             return *this;
         }
-        std::lock_guard<std::mutex> theGuard(this->lock);
-        std::stringstream out;
-        out << input;
-        this->currentLine += out.str();
+        this->threadBuffer().currentLine << input;
         return *this;
     }
+    ThreadBuffer& threadBuffer();
+    void flush(); //<- moves the finished lines of all threads to the ram cache and the file.
     std::string ToStringStatistics();
+
+    static void flushAll();
+    static void ThreadFlush(); //<- background flusher, runs until interrupted.
 };
 #endif
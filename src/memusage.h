@@ -6,10 +6,14 @@
 #define FABCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <prevector.h>
 
+#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 #include <unordered_map>
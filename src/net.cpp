@@ -28,6 +28,11 @@
 #include <fcntl.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -44,6 +49,14 @@
 // We add a random period time (0 to 1 seconds) to feeler connections to prevent synchronization.
 #define FEELER_SLEEP_WINDOW 1
 
+// How long the socket handler waits for socket events before it looks at all peers again
+static const int64_t SELECT_TIMEOUT_MILLISECONDS = 50;
+
+#ifdef USE_EPOLL
+// Events taken from the epoll instance per wait, the rest are taken by the next one
+static const int MAX_EPOLL_EVENTS = 1024;
+#endif
+
 #if !defined(HAVE_MSG_NOSIGNAL)
 #define MSG_NOSIGNAL 0
 #endif
@@ -76,6 +89,39 @@ const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
 static const uint64_t RANDOMIZER_ID_LOCALHOSTNONCE = 0xd93e69e2bbfa5735ULL; // SHA256("localhostnonce")[0:8]
+
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode)
+{
+    if (strMode == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (strMode == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_SELECT: return "select";
+    case SOCKETEVENTS_EPOLL: return "epoll";
+    }
+    assert(false);
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+#ifdef USE_EPOLL
+    return "select, epoll";
+#else
+    return "select";
+#endif
+}
 //
 // Global state variables
 //
@@ -386,7 +432,7 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed))
     {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!IsServiceableSocket(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return nullptr;
@@ -1076,7 +1122,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (!IsServiceableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1121,6 +1167,280 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     }
 }
 
+bool CConnman::IsServiceableSocket(SOCKET hSocket) const
+{
+    return socketEventsMode != SOCKETEVENTS_SELECT || IsSelectableSocket(hSocket);
+}
+
+void CConnman::GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        recv_set.insert(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            error_set.insert(pnode->hSocket);
+            if (select_send) {
+                send_set.insert(pnode->hSocket);
+                continue;
+            }
+            if (select_recv) {
+                recv_set.insert(pnode->hSocket);
+            }
+        }
+    }
+}
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SELECT_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+
+    for (SOCKET hSocket : recv_select_set) {
+        FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : send_select_set) {
+        FD_SET(hSocket, &fdsetSend);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    for (SOCKET hSocket : error_select_set) {
+        FD_SET(hSocket, &fdsetError);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+    bool have_fds = !recv_select_set.empty() || !send_select_set.empty() || !error_select_set.empty();
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecv);
+        }
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        if (!interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS)))
+            return;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (FD_ISSET(hSocket, &fdsetRecv)) {
+            recv_set.insert(hSocket);
+        }
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (FD_ISSET(hSocket, &fdsetSend)) {
+            send_set.insert(hSocket);
+        }
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (FD_ISSET(hSocket, &fdsetError)) {
+            error_set.insert(hSocket);
+        }
+    }
+}
+
+#ifdef USE_EPOLL
+bool CConnman::InitSocketEventsEpoll()
+{
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    bool fSuccess = epollfd != -1 && wakeupfd != -1;
+
+    // The wakeup counter and the listening sockets are level triggered: they are
+    // reported by every wait until read, or until all connections are accepted
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeupfd;
+    fSuccess = fSuccess && epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeupfd, &event) == 0;
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        event.data.fd = hListenSocket.socket;
+        fSuccess = fSuccess && epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket, &event) == 0;
+    }
+
+    if (!fSuccess) {
+        LogPrintf("%s: %s\n", __func__, NetworkErrorString(errno));
+        if (epollfd != -1)
+            close(epollfd);
+        if (wakeupfd != -1)
+            close(wakeupfd);
+        epollfd = wakeupfd = -1;
+    }
+    return fSuccess;
+}
+
+void CConnman::SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    std::set<SOCKET> recv_select_set, send_select_set, error_select_set;
+    GenerateSelectSet(recv_select_set, send_select_set, error_select_set);
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            if (pnode->fSocketEventsRegistered)
+                continue;
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            // Edge triggered: readiness is reported once per change, and kept in
+            // mapSocketEvents until a recv or send shows the socket is drained.
+            // Closing a socket removes it from the epoll instance, so the entry
+            // may be left from an earlier socket with the same descriptor.
+            struct epoll_event event;
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.fd = pnode->hSocket;
+            mapSocketEvents[pnode->hSocket] = 0;
+            if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+                LogPrintf("epoll_ctl failed for peer=%d: %s\n", pnode->GetId(), NetworkErrorString(errno));
+                pnode->fDisconnect = true;
+            }
+            pnode->fSocketEventsRegistered = true;
+        }
+    }
+
+    const uint32_t recvEvents = EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR;
+    auto isReady = [this](SOCKET hSocket, uint32_t events) {
+        auto it = mapSocketEvents.find(hSocket);
+        return it != mapSocketEvents.end() && (it->second & events);
+    };
+
+    // Readiness that wasn't used up yet won't be reported again, don't wait then
+    bool fPending = false;
+    for (SOCKET hSocket : recv_select_set)
+        fPending = fPending || isReady(hSocket, recvEvents);
+    for (SOCKET hSocket : send_select_set)
+        fPending = fPending || isReady(hSocket, EPOLLOUT);
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    int nEvents = epoll_wait(epollfd, events, MAX_EPOLL_EVENTS, fPending ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+    if (interruptNet)
+        return;
+    if (nEvents == -1) {
+        int nErr = errno;
+        nEvents = 0;
+        if (nErr != EINTR) {
+            LogPrintf("epoll_wait error %s\n", NetworkErrorString(nErr));
+            if (!interruptNet.sleep_for(std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS)))
+                return;
+        }
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        SOCKET hSocket = events[i].data.fd;
+        if ((int)hSocket == wakeupfd) {
+            uint64_t nWakeups;
+            if (read(wakeupfd, &nWakeups, sizeof(nWakeups)) != sizeof(nWakeups)) {
+                // Already reset by an earlier event
+            }
+            continue;
+        }
+        bool fListenSocket = false;
+        for (const ListenSocket& hListenSocket : vhListenSocket)
+            fListenSocket = fListenSocket || hListenSocket.socket == hSocket;
+        if (fListenSocket) {
+            recv_set.insert(hSocket);
+            continue;
+        }
+        mapSocketEvents[hSocket] |= events[i].events;
+    }
+
+    for (SOCKET hSocket : recv_select_set) {
+        if (isReady(hSocket, recvEvents)) {
+            recv_set.insert(hSocket);
+        }
+    }
+    for (SOCKET hSocket : send_select_set) {
+        if (isReady(hSocket, EPOLLOUT)) {
+            send_set.insert(hSocket);
+        }
+    }
+    for (SOCKET hSocket : error_select_set) {
+        if (isReady(hSocket, EPOLLHUP | EPOLLERR)) {
+            error_set.insert(hSocket);
+        }
+    }
+}
+#endif
+
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        SocketEventsEpoll(recv_set, send_set, error_set);
+        return;
+    }
+#endif
+    SocketEventsSelect(recv_set, send_set, error_set);
+}
+
+void CConnman::SocketDrained(SOCKET hSocket, bool fRecv)
+{
+#ifdef USE_EPOLL
+    if (socketEventsMode != SOCKETEVENTS_EPOLL)
+        return;
+    // A hang up or error stays, the next recv reports it
+    auto it = mapSocketEvents.find(hSocket);
+    if (it != mapSocketEvents.end())
+        it->second &= ~(uint32_t)(fRecv ? EPOLLIN : EPOLLOUT);
+#endif
+}
+
+void CConnman::WakeSocketHandler()
+{
+#ifdef USE_EPOLL
+    if (wakeupfd == -1)
+        return;
+    uint64_t nWakeup = 1;
+    if (write(wakeupfd, &nWakeup, sizeof(nWakeup)) != sizeof(nWakeup)) {
+        // Only fails when the counter would overflow, then the handler wakes up anyway
+    }
+#endif
+}
+
 void CConnman::ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
@@ -1188,93 +1508,19 @@ void CConnman::ThreadSocketHandler()
         }
 
         //
-        // Find which sockets have data to receive
+        // Find which sockets are ready
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1301,13 +1547,15 @@ void CConnman::ThreadSocketHandler()
             bool recvSet = false;
             bool sendSet = false;
             bool errorSet = false;
+            SOCKET hSocket;
             {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                hSocket = pnode->hSocket;
+                recvSet = recv_set.count(hSocket) > 0;
+                sendSet = send_set.count(hSocket) > 0;
+                errorSet = error_set.count(hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1322,6 +1570,9 @@ void CConnman::ThreadSocketHandler()
                 }
                 if (nBytes > 0)
                 {
+                    // A short read drained the socket
+                    if (nBytes < (int)sizeof(pchBuf))
+                        SocketDrained(hSocket, true);
                     bool notify = false;
                     if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
                         pnode->CloseSocketDisconnect();
@@ -1332,7 +1583,8 @@ void CConnman::ThreadSocketHandler()
                         for (; it != pnode->vRecvMsg.end(); ++it) {
                             if (!it->complete())
                                 break;
-                            nSizeAdded += it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+                            nSizeAdded += it->hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
+                            m_msgproc->PrepareMessage(pnode, *it);
                         }
                         {
                             LOCK(pnode->cs_vProcessMsg);
@@ -1361,6 +1613,8 @@ void CConnman::ThreadSocketHandler()
                             LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
                         pnode->CloseSocketDisconnect();
                     }
+                    else if (nErr == WSAEWOULDBLOCK)
+                        SocketDrained(hSocket, true);
                 }
             }
 
@@ -1374,6 +1628,9 @@ void CConnman::ThreadSocketHandler()
                 if (nBytes) {
                     RecordBytesSent(nBytes);
                 }
+                // Data left over means the send buffer of the socket is full
+                if (!pnode->vSendMsg.empty())
+                    SocketDrained(hSocket, false);
             }
 
             //
@@ -2080,7 +2337,7 @@ bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, b
         LogPrintf("%s\n", strError);
         return false;
     }
-    if (!IsSelectableSocket(hListenSocket))
+    if (!IsServiceableSocket(hListenSocket))
     {
         strError = "Error: Couldn't create a listenable socket for incoming connections";
         LogPrintf("%s\n", strError);
@@ -2237,6 +2494,9 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nLastNodeId = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
+    socketEventsMode = DEFAULT_SOCKETEVENTS;
+    epollfd = -1;
+    wakeupfd = -1;
     semOutbound = nullptr;
     semAddnode = nullptr;
     flagInterruptMsgProc = false;
@@ -2300,6 +2560,14 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         return false;
     }
 
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL && !InitSocketEventsEpoll()) {
+        LogPrintf("Falling back to select() for socket events\n");
+        socketEventsMode = SOCKETEVENTS_SELECT;
+    }
+#endif
+    LogPrintf("Using %s for socket events\n", GetSocketEventsModeName(socketEventsMode));
+
     for (const auto& strDest : connOptions.vSeedNodes) {
         AddOneShot(strDest);
     }
@@ -2412,6 +2680,7 @@ void CConnman::Interrupt()
     condMsgProc.notify_all();
 
     interruptNet();
+    WakeSocketHandler();
     InterruptSocks5(true);
 
     if (semOutbound) {
@@ -2453,6 +2722,14 @@ void CConnman::Stop()
         if (hListenSocket.socket != INVALID_SOCKET)
             if (!CloseSocket(hListenSocket.socket))
                 LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+#ifdef USE_EPOLL
+    if (epollfd != -1)
+        close(epollfd);
+    if (wakeupfd != -1)
+        close(wakeupfd);
+    epollfd = wakeupfd = -1;
+    mapSocketEvents.clear();
+#endif
 
     // clean up some globals (to help leak detection)
     for (CNode *pnode : vNodes) {
@@ -2770,6 +3047,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    fSocketEventsRegistered = false;
     nProcessQueueSize = 0;
 
     for (const std::string &msg : getAllNetMessageTypes())
@@ -2845,6 +3123,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
     size_t nBytesSent = 0;
+    bool fWakeSocketHandler = false;
     {
         LOCK(pnode->cs_vSend);
         bool optimisticSend(pnode->vSendMsg.empty());
@@ -2862,9 +3141,15 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
             nBytesSent = SocketSendData(pnode);
+
+        // The socket handler may be waiting without this socket, as it had nothing to send
+        if (!pnode->vSendMsg.empty())
+            fWakeSocketHandler = true;
     }
     if (nBytesSent)
         RecordBytesSent(nBytesSent);
+    if (fWakeSocketHandler)
+        WakeSocketHandler();
 }
 
 bool CConnman::ForNode(NodeId id, std::function<bool(CNode* pnode)> func)
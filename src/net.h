@@ -28,6 +28,9 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <exception>
+#include <set>
+#include <unordered_map>
 
 #ifndef WIN32
 #include <arpa/inet.h>
@@ -35,6 +38,7 @@
 
 
 class CScheduler;
+class CNetMessage;
 class CNode;
 
 namespace boost {
@@ -90,6 +94,26 @@ static const ServiceFlags REQUIRED_SERVICES = NODE_NETWORK;
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#define USE_EPOLL 1
+#endif
+
+/** How the socket handler waits for sockets to become ready (-socketevents) */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT,  //!< select() on all sockets every round, limited to FD_SETSIZE sockets
+    SOCKETEVENTS_EPOLL,   //!< edge-triggered epoll, sockets are registered once
+};
+#ifdef USE_EPOLL
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_EPOLL;
+#else
+static const SocketEventsMode DEFAULT_SOCKETEVENTS = SOCKETEVENTS_SELECT;
+#endif
+
+bool ParseSocketEventsMode(const std::string& strMode, SocketEventsMode& mode);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** The modes this build supports, for the help */
+std::string GetSupportedSocketEventsModes();
+
 typedef int64_t NodeId;
 
 struct AddedNodeInfo
@@ -146,6 +170,7 @@ public:
         std::vector<std::string> vSeedNodes;
         std::vector<CSubNet> vWhitelistedRange;
         std::vector<CService> vBinds, vWhiteBinds;
+        SocketEventsMode socketEventsMode = DEFAULT_SOCKETEVENTS;
     };
 
     void Init(const Options& connOptions) {
@@ -163,6 +188,7 @@ public:
         nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
         nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
         vWhitelistedRange = connOptions.vWhitelistedRange;
+        socketEventsMode = connOptions.socketEventsMode;
     }
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -309,6 +335,8 @@ public:
     unsigned int GetReceiveFloodSize() const;
 
     void WakeMessageHandler();
+    /** Interrupt the socket handler's wait, when it has to look at a socket again without an event */
+    void WakeSocketHandler();
 private:
     struct ListenSocket {
         SOCKET socket;
@@ -326,6 +354,19 @@ private:
     void ThreadOpenConnections();
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
+    /** Whether the socket handler can wait on the socket, select() can't on descriptors from FD_SETSIZE */
+    bool IsServiceableSocket(SOCKET hSocket) const;
+    /** The sockets to wait on: listening ones for connections, peers for sending when they have queued data, else for receiving unless paused */
+    void GenerateSelectSet(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    /** Wait up to SELECT_TIMEOUT_MILLISECONDS for the sockets of GenerateSelectSet to become ready, return the ready ones */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#ifdef USE_EPOLL
+    bool InitSocketEventsEpoll();
+    void SocketEventsEpoll(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+#endif
+    /** A recv or send on hSocket would block, wait for its next edge before using it again */
+    void SocketDrained(SOCKET hSocket, bool fRecv);
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
 
@@ -425,6 +466,13 @@ private:
 
     CThreadInterrupt interruptNet;
 
+    SocketEventsMode socketEventsMode;
+    /** epoll instance and eventfd interrupting epoll_wait, -1 when not used */
+    int epollfd;
+    int wakeupfd;
+    /** Readiness reported by epoll and not yet used up, per socket. Only accessed by the socket handler */
+    std::unordered_map<SOCKET, uint32_t> mapSocketEvents;
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
@@ -465,6 +513,8 @@ struct CombinerAll
 class NetEventsInterface
 {
 public:
+    /** Called by the socket handler for each complete message, before it is queued for ProcessMessages */
+    virtual void PrepareMessage(CNode* pnode, CNetMessage& msg) = 0;
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
@@ -551,6 +601,26 @@ public:
 
 
 
+/**
+ * The payload of a received message, deserialized on a worker thread before the message
+ * handler reaches the message. The worker owns vRecv until fDone is set.
+ */
+class CPreparedMessage
+{
+public:
+    explicit CPreparedMessage(CDataStream&& vRecvIn) : nMessageSize(vRecvIn.size()), vRecv(std::move(vRecvIn)), fDone(false) {}
+    virtual ~CPreparedMessage() {}
+
+    /** Deserialize vRecv into the typed message, run on the worker */
+    virtual void Prepare() = 0;
+
+    const size_t nMessageSize;
+    CDataStream vRecv;
+    //! What Prepare threw, rethrown where the message is processed
+    std::exception_ptr error;
+    std::atomic<bool> fDone;
+};
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -567,6 +637,8 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
+    std::shared_ptr<CPreparedMessage> prepared; // set when vRecv moved to a worker
+
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
         in_data = false;
@@ -659,6 +731,8 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    //! Whether hSocket was added to the epoll instance, only accessed by the socket handler
+    bool fSocketEventsRegistered;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
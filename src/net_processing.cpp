@@ -10,6 +10,7 @@
 #include <blockencodings.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <fasc/fascprefetch.h>
 #include <hash.h>
 #include <init.h>
 #include <validation.h>
@@ -32,6 +33,11 @@
 #include <utilstrencodings.h>
 #include <validationinterface.h>
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #if defined(NDEBUG)
 # error "Fabcoin cannot be compiled without assertions."
 #endif
@@ -1093,7 +1099,14 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     std::shared_ptr<const CBlock> pblock;
                     if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
                         pblock = a_recent_block;
-                    } else {
+                    }
+                    // Blocks are stored in their network serialization with witnesses, so unless
+                    // witnesses have to be stripped the stored bytes are sent without deserializing
+                    CSerializedNetMsg msgRaw;
+                    bool fSendRaw = !pblock && (inv.type == MSG_WITNESS_BLOCK || (inv.type == MSG_BLOCK && !IsWitnessEnabled(mi->second->pprev, consensusParams)));
+                    if (fSendRaw && !ReadRawBlockFromDisk(msgRaw.data, mi->second, Params().MessageStart()))
+                        fSendRaw = false;
+                    if (!pblock && !fSendRaw) {
                         // Send block from disk
                         std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
                         if (!ReadBlockFromDisk(*pblockRead, (*mi).second, consensusParams))
@@ -1101,7 +1114,11 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         pblock = pblockRead;
                     }
 
-                    if (inv.type == MSG_BLOCK)
+                    if (fSendRaw) {
+                        msgRaw.command = NetMsgType::BLOCK;
+                        connman->PushMessage(pfrom, std::move(msgRaw));
+                    }
+                    else if (inv.type == MSG_BLOCK)
                         connman->PushMessage(pfrom, msgMaker.Make( SERIALIZE_TRANSACTION_NO_WITNESS,
                                                                  NetMsgType::BLOCK, *pblock));
                     else if (inv.type == MSG_WITNESS_BLOCK)
@@ -1460,9 +1477,149 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
-bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+/** Threads running CPreparedMessage::Prepare, waking the message handler when a payload is ready */
+class CMessageParserPool
+{
+public:
+    CMessageParserPool(CConnman* connmanIn, int nThreads) : connman(connmanIn), fRunning(true)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&CMessageParserPool::Run, this);
+    }
+
+    /** Payloads not deserialized yet are dropped, their peers are gone by now */
+    ~CMessageParserPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fRunning = false;
+            cond.notify_all();
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void Submit(std::shared_ptr<CPreparedMessage> prepared)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        queue.push_back(std::move(prepared));
+        cond.notify_one();
+    }
+
+private:
+    void Run()
+    {
+        RenameThread("fabcoin-msgparse");
+        while (true) {
+            std::shared_ptr<CPreparedMessage> prepared;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    return;
+                prepared = std::move(queue.front());
+                queue.pop_front();
+            }
+            try {
+                prepared->Prepare();
+            } catch (...) {
+                prepared->error = std::current_exception();
+            }
+            prepared->fDone = true;
+            connman->WakeMessageHandler();
+        }
+    }
+
+    CConnman* const connman;
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::shared_ptr<CPreparedMessage>> queue;
+    std::vector<std::thread> threads;
+    bool fRunning;
+};
+
+/**
+ * Read the headers of a headers message. Returns false, with nCount set but nothing read,
+ * when there are more than MAX_HEADERS_RESULTS.
+ */
+static bool ReadHeadersMessage(CDataStream& vRecv, std::vector<CBlockHeader>& headers, unsigned int& nCount)
+{
+    // Bypass the normal CBlock deserialization, as we don't want to risk deserializing 2000 full blocks.
+    nCount = ReadCompactSize(vRecv);
+    if (nCount > MAX_HEADERS_RESULTS)
+        return false;
+    headers.resize(nCount);
+    for (unsigned int n = 0; n < nCount; n++) {
+        headers[n].hashStateRoot = uint256S("9514771014c9ae803d8cea2731b2063e83de44802b40dce2d06acd02d0ff65e9");
+        headers[n].hashUTXORoot = uint256S("21b463e3b52f6201c0ad6c991be0485b6ef8c092e64583ffa655cc1b171fe856");
+        vRecv >> headers[n];
+        ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
+    }
+    return true;
+}
+
+class CPreparedBlock : public CPreparedMessage
+{
+public:
+    using CPreparedMessage::CPreparedMessage;
+    void Prepare() override
+    {
+        pblock = std::make_shared<CBlock>();
+        vRecv >> *pblock;
+    }
+
+    std::shared_ptr<CBlock> pblock;
+};
+
+/** Whether headers are sent to and accepted from pnode as headers2 messages */
+static bool UseCompactHeaders(const CNode* pnode)
+{
+    return (pnode->GetLocalServices() & NODE_COMPACT_HEADERS) && (pnode->nServices & NODE_COMPACT_HEADERS);
+}
+
+class CPreparedHeaders : public CPreparedMessage
 {
-    LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
+public:
+    CPreparedHeaders(CDataStream&& vRecvIn, bool fCompactIn) : CPreparedMessage(std::move(vRecvIn)), fCompact(fCompactIn) {}
+    void Prepare() override
+    {
+        if (fCompact)
+            fCountOK = ReadCompactHeaders(vRecv, headers, MAX_HEADERS_RESULTS, nCount);
+        else
+            fCountOK = ReadHeadersMessage(vRecv, headers, nCount);
+    }
+
+    const bool fCompact;
+    std::vector<CBlockHeader> headers;
+    unsigned int nCount = 0;
+    bool fCountOK = false;
+};
+
+class CPreparedCmpctBlock : public CPreparedMessage
+{
+public:
+    using CPreparedMessage::CPreparedMessage;
+    void Prepare() override
+    {
+        vRecv >> cmpctblock;
+    }
+
+    CBlockHeaderAndShortTxIDs cmpctblock;
+};
+
+/** The payload a message parser deserialized, rethrowing what the deserialization threw */
+template <typename T>
+static T& GetPrepared(const std::shared_ptr<CPreparedMessage>& prepared)
+{
+    if (prepared->error)
+        std::rethrow_exception(prepared->error);
+    return static_cast<T&>(*prepared);
+}
+
+bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, const std::shared_ptr<CPreparedMessage>& prepared, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
+{
+    LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), prepared ? prepared->nMessageSize : vRecv.size(), pfrom->GetId());
     if (gArgs.IsArgSet("-dropmessagestest") && GetRand(gArgs.GetArg("-dropmessagestest", 0)) == 0)
     {
         LogPrintf("dropmessagestest DROPPING RECV MESSAGE\n");
@@ -2063,7 +2220,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // will re-announce the new block via headers (or compact blocks again)
         // in the SendMessages logic.
         nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
-        connman->PushMessage(pfrom, msgMaker.Make( NetMsgType::HEADERS, vHeaders));
+        if (UseCompactHeaders(pfrom))
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS2, CompactHeadersWriter<CBlock>(vHeaders)));
+        else
+            connman->PushMessage(pfrom, msgMaker.Make( NetMsgType::HEADERS, vHeaders));
     }
 
 
@@ -2256,7 +2416,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
-        vRecv >> cmpctblock;
+        if (prepared)
+            cmpctblock = std::move(GetPrepared<CPreparedCmpctBlock>(prepared).cmpctblock);
+        else
+            vRecv >> cmpctblock;
 
         bool received_new_header = false;
 
@@ -2392,6 +2555,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 } else {
                     req.blockhash = pindex->GetBlockHash();
                     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETBLOCKTXN, req));
+                    // Warm the contract state the block touches while the rest of it is on its way
+                    if (pcontractPrefetcher)
+                        pcontractPrefetcher->Prefetch(cmpctblock.header, partialBlock.GetAvailableTransactions());
                 }
             } else {
                 // This block is either already in flight from a different
@@ -2427,7 +2593,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         } // cs_main
 
         if (fProcessBLOCKTXN)
-            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, nTimeReceived, chainparams, connman, interruptMsgProc);
+            return ProcessMessage(pfrom, NetMsgType::BLOCKTXN, blockTxnMsg, nullptr, nTimeReceived, chainparams, connman, interruptMsgProc);
 
         if (fRevertToHeaderProcessing) {
             // Headers received from HB compact block peers are permitted to be
@@ -2558,30 +2724,28 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
-    else if (strCommand == NetMsgType::HEADERS && !fImporting && !fReindex) // Ignore headers received while importing
+    else if ((strCommand == NetMsgType::HEADERS || (strCommand == NetMsgType::HEADERS2 && (pfrom->GetLocalServices() & NODE_COMPACT_HEADERS))) &&
+             !fImporting && !fReindex) // Ignore headers received while importing
     {
-        // Deserialize in legacy format.
-        int original_version = vRecv.GetVersion();
-        vRecv.SetVersion(original_version );
-        
         std::vector<CBlockHeader> headers;
-
-        // Bypass the normal CBlock deserialization, as we don't want to risk deserializing 2000 full blocks.
-        unsigned int nCount = ReadCompactSize(vRecv);
-        if (nCount > MAX_HEADERS_RESULTS) {
+        unsigned int nCount;
+        bool fCountOK;
+        if (prepared) {
+            CPreparedHeaders& preparedHeaders = GetPrepared<CPreparedHeaders>(prepared);
+            fCountOK = preparedHeaders.fCountOK;
+            nCount = preparedHeaders.nCount;
+            headers.swap(preparedHeaders.headers);
+        } else if (strCommand == NetMsgType::HEADERS2) {
+            fCountOK = ReadCompactHeaders(vRecv, headers, MAX_HEADERS_RESULTS, nCount);
+        } else {
+            fCountOK = ReadHeadersMessage(vRecv, headers, nCount);
+        }
+        if (!fCountOK) {
             LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 20);
             return error("headers message size = %u", nCount);
         }
-        headers.resize(nCount);
-        for (unsigned int n = 0; n < nCount; n++) {
-            headers[n].hashStateRoot = uint256S("9514771014c9ae803d8cea2731b2063e83de44802b40dce2d06acd02d0ff65e9");
-            headers[n].hashUTXORoot = uint256S("21b463e3b52f6201c0ad6c991be0485b6ef8c092e64583ffa655cc1b171fe856");
-            vRecv >> headers[n];
-            ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
-        }
 
-        vRecv.SetVersion(original_version);
         // Headers received via a HEADERS message should be valid, and reflect
         // the chain the peer is on. If we receive a known-invalid header,
         // disconnect the peer if it is using one of our outbound connection
@@ -2592,13 +2756,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
-        // Deserialize in legacy format.
-        int original_version = vRecv.GetVersion();
-        vRecv.SetVersion(original_version );
-
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
-        vRecv.SetVersion(original_version);
+        std::shared_ptr<CBlock> pblock;
+        if (prepared) {
+            pblock = GetPrepared<CPreparedBlock>(prepared).pblock;
+        } else {
+            pblock = std::make_shared<CBlock>();
+            vRecv >> *pblock;
+        }
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
         if (fLogIPs)
@@ -2873,6 +3037,43 @@ static bool SendRejectsAndCheckIfBanned(CNode* pnode, CConnman* connman)
     return false;
 }
 
+PeerLogicValidation::~PeerLogicValidation()
+{
+}
+
+void PeerLogicValidation::StartMessageParsers(int nThreads)
+{
+    messageParsers.reset();
+    if (nThreads > 0)
+        messageParsers.reset(new CMessageParserPool(connman, nThreads));
+}
+
+void PeerLogicValidation::PrepareMessage(CNode* pnode, CNetMessage& msg)
+{
+    // The receive version is only settled once the handshake is done
+    if (!messageParsers || !pnode->fSuccessfullyConnected)
+        return;
+    // Messages ProcessMessages drops unread stay with it
+    const CChainParams& chainparams = Params();
+    if (!msg.hdr.IsValid(chainparams.MessageStart()) ||
+        memcmp(msg.GetMessageHash().begin(), msg.hdr.pchChecksum, CMessageHeader::CHECKSUM_SIZE) != 0)
+        return;
+
+    std::string strCommand = msg.hdr.GetCommand();
+    msg.SetVersion(pnode->GetRecvVersion());
+    if (strCommand == NetMsgType::BLOCK)
+        msg.prepared = std::make_shared<CPreparedBlock>(std::move(msg.vRecv));
+    else if (strCommand == NetMsgType::HEADERS)
+        msg.prepared = std::make_shared<CPreparedHeaders>(std::move(msg.vRecv), false);
+    else if (strCommand == NetMsgType::HEADERS2 && (pnode->GetLocalServices() & NODE_COMPACT_HEADERS))
+        msg.prepared = std::make_shared<CPreparedHeaders>(std::move(msg.vRecv), true);
+    else if (strCommand == NetMsgType::CMPCTBLOCK)
+        msg.prepared = std::make_shared<CPreparedCmpctBlock>(std::move(msg.vRecv));
+    else
+        return;
+    messageParsers->Submit(msg.prepared);
+}
+
 bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptMsgProc)
 {
     const CChainParams& chainparams = Params();
@@ -2904,9 +3105,13 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // A message still being deserialized holds back the ones after it, its parser wakes us up
+        const std::shared_ptr<CPreparedMessage>& prepared = pfrom->vProcessMsg.front().prepared;
+        if (prepared && !prepared->fDone)
+            return false;
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
-        pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
+        pfrom->nProcessQueueSize -= msgs.front().hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
         pfrom->fPauseRecv = pfrom->nProcessQueueSize > connman->GetReceiveFloodSize();
         fMoreWork = !pfrom->vProcessMsg.empty();
     }
@@ -2948,7 +3153,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     bool fRet = false;
     try
     {
-        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
+        fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.prepared, msg.nTime, chainparams, connman, interruptMsgProc);
         if (interruptMsgProc)
             return false;
         if (!pfrom->vRecvGetData.empty())
@@ -3363,7 +3568,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                         LogPrint(BCLog::NET, "%s: sending header %s to peer=%d\n", __func__,
                                 vHeaders.front().GetHash().ToString(), pto->GetId());
                     }
-                    connman->PushMessage(pto, msgMaker.Make( NetMsgType::HEADERS, vHeaders));
+                    if (UseCompactHeaders(pto))
+                        connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS2, CompactHeadersWriter<CBlock>(vHeaders)));
+                    else
+                        connman->PushMessage(pto, msgMaker.Make( NetMsgType::HEADERS, vHeaders));
                     state.pindexBestHeaderSent = pBestIndex;
                 } else
                     fRevertToInv = true;
@@ -34,6 +34,12 @@ static constexpr int64_t STALE_CHECK_INTERVAL = 1.25 * 60; // 1.25 minutes
 static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
+/** Default for -compactheaders, offer NODE_COMPACT_HEADERS and exchange headers2 messages */
+static const bool DEFAULT_COMPACT_HEADERS = true;
+/** Default for -msgparsethreads, threads deserializing block, headers and cmpctblock messages ahead of the message handler */
+static const int DEFAULT_MESSAGE_PARSE_THREADS = 2;
+
+class CMessageParserPool;
 
 class PeerLogicValidation : public CValidationInterface, public NetEventsInterface {
 private:
@@ -41,6 +47,10 @@ private:
 
 public:
     explicit PeerLogicValidation(CConnman* connman, CScheduler &scheduler);
+    ~PeerLogicValidation();
+
+    /** Deserialize large messages on nThreads threads before ProcessMessages reaches them, 0 to leave it to ProcessMessages */
+    void StartMessageParsers(int nThreads);
 
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -50,6 +60,8 @@ public:
 
     void InitializeNode(CNode* pnode) override;
     void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) override;
+    /** Hand the payload of a block, headers or cmpctblock message to a message parser */
+    void PrepareMessage(CNode* pnode, CNetMessage& msg) override;
     /** Process protocol messages received from a given node */
     bool ProcessMessages(CNode* pfrom, std::atomic<bool>& interrupt) override;
     /**
@@ -67,6 +79,7 @@ public:
 
 private:
     int64_t m_stale_tip_check_time; //! Next time to check for stale tip
+    std::unique_ptr<CMessageParserPool> messageParsers;
 };
 
 struct CNodeStateStats {
@@ -0,0 +1,380 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef FABCOIN_POOLEDHASHMAP_H
+#define FABCOIN_POOLEDHASHMAP_H
+
+#include <memusage.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Hash map with open addressing for large caches such as CCoinsViewCache's.
+ *
+ * The table is an array of one control byte per slot, which holds 7 bits of the hash of
+ * the slot's key, and an array of pointers to the entries. Lookups compare the control
+ * bytes of 16 slots at once (with SSE2 when available) and only read the entries whose
+ * bits match. The entries are allocated from chunks, which are never moved: like with
+ * std::unordered_map, references to entries stay valid until they are erased, while
+ * iterators are invalidated by insertions.
+ *
+ * Erasing an entry doesn't invalidate the iterators to other entries, so entries can be
+ * erased while iterating (erase(it++)). The memory of erased entries is reused by the
+ * next insertions, and only freed by clear() or the destructor; dynamic_usage() is the
+ * exact size of the allocations.
+ */
+template <typename K, typename T, typename Hash>
+class pooledhashmap
+{
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+private:
+    enum : size_t { GROUP_SIZE = 16, MIN_CHUNK_NODES = 16, MAX_CHUNK_NODES = 4096 };
+
+    /** Control bytes: empty or erased slots are negative, full slots hold 7 bits of the hash. */
+    enum : int8_t { CTRL_EMPTY = -128, CTRL_ERASED = -2 };
+
+    union node {
+        value_type value;
+        node* next;
+        node() {}
+        ~node() {}
+    };
+
+    std::vector<int8_t> ctrl;
+    std::vector<node*> slots;
+    size_t nSize;
+    /** Erased slots, which lengthen the probes until the next rehash */
+    size_t nErased;
+
+    std::vector<std::unique_ptr<node[]>> chunks;
+    /** Nodes of the last chunk not handed out yet */
+    size_t nChunkLeft;
+    /** Erased nodes, to be reused */
+    node* freelist;
+    size_t nPoolUsage;
+
+    Hash hasher;
+
+    /** Chunks double in size, so that small maps stay small */
+    static size_t ChunkNodes(size_t nChunk)
+    {
+        return std::min<size_t>(MAX_CHUNK_NODES, MIN_CHUNK_NODES << std::min<size_t>(nChunk, 8));
+    }
+
+    /** Bitmask of the slots of the group whose control byte is b */
+    static uint32_t MatchByte(const int8_t* group, int8_t b)
+    {
+#if defined(__SSE2__)
+        __m128i ctrls = _mm_loadu_si128((const __m128i*)group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrls, _mm_set1_epi8(b)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; i++)
+            mask |= (uint32_t)(group[i] == b) << i;
+        return mask;
+#endif
+    }
+
+    /** Bitmask of the empty or erased slots of the group */
+    static uint32_t MatchFree(const int8_t* group)
+    {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < GROUP_SIZE; i++)
+            mask |= (uint32_t)(group[i] < 0) << i;
+        return mask;
+#endif
+    }
+
+    static size_t LowestBit(uint32_t mask)
+    {
+        return __builtin_ctz(mask);
+    }
+
+    static int8_t H2(size_t hash) { return hash & 0x7f; }
+    size_t FirstGroup(size_t hash) const { return (hash >> 7) & (ctrl.size() / GROUP_SIZE - 1); }
+    /** Triangular probing, which visits every group as their count is a power of two */
+    size_t NextGroup(size_t group, size_t probe) const { return (group + probe) & (ctrl.size() / GROUP_SIZE - 1); }
+
+    size_t FindSlot(const K& key, size_t hash) const
+    {
+        if (nSize == 0)
+            return ctrl.size();
+        const int8_t h2 = H2(hash);
+        size_t group = FirstGroup(hash);
+        for (size_t probe = 1; ; probe++) {
+            const int8_t* pctrl = &ctrl[group * GROUP_SIZE];
+            for (uint32_t mask = MatchByte(pctrl, h2); mask; mask &= mask - 1) {
+                size_t pos = group * GROUP_SIZE + LowestBit(mask);
+                if (slots[pos]->value.first == key)
+                    return pos;
+            }
+            if (MatchByte(pctrl, CTRL_EMPTY))
+                return ctrl.size();
+            group = NextGroup(group, probe);
+        }
+    }
+
+    size_t FindFreeSlot(size_t hash) const
+    {
+        size_t group = FirstGroup(hash);
+        for (size_t probe = 1; ; probe++) {
+            uint32_t mask = MatchFree(&ctrl[group * GROUP_SIZE]);
+            if (mask)
+                return group * GROUP_SIZE + LowestBit(mask);
+            group = NextGroup(group, probe);
+        }
+    }
+
+    void Rehash(size_t nCapacity)
+    {
+        std::vector<int8_t> oldCtrl(nCapacity, CTRL_EMPTY);
+        std::vector<node*> oldSlots(nCapacity, nullptr);
+        oldCtrl.swap(ctrl);
+        oldSlots.swap(slots);
+        for (size_t i = 0; i < oldCtrl.size(); i++) {
+            if (oldCtrl[i] < 0)
+                continue;
+            size_t pos = FindFreeSlot(hasher(oldSlots[i]->value.first));
+            ctrl[pos] = oldCtrl[i];
+            slots[pos] = oldSlots[i];
+        }
+        nErased = 0;
+    }
+
+    /** Make room for one more entry: at most 7/8 of the slots are full or erased. */
+    void Reserve()
+    {
+        if ((nSize + nErased + 1) * 8 <= ctrl.size() * 7)
+            return;
+        // Grow when the entries fill more than half of the maximum load, otherwise
+        // just drop the erased slots.
+        size_t nCapacity = std::max<size_t>(ctrl.size(), GROUP_SIZE);
+        if ((nSize + 1) * 16 > nCapacity * 7)
+            nCapacity *= 2;
+        Rehash(nCapacity);
+    }
+
+    node* AllocNode()
+    {
+        if (freelist) {
+            node* n = freelist;
+            freelist = n->next;
+            return n;
+        }
+        if (nChunkLeft == 0) {
+            size_t nNodes = ChunkNodes(chunks.size());
+            chunks.emplace_back(new node[nNodes]);
+            nChunkLeft = nNodes;
+            nPoolUsage += memusage::MallocUsage(sizeof(node) * nNodes);
+        }
+        return &chunks.back()[ChunkNodes(chunks.size() - 1) - nChunkLeft--];
+    }
+
+    void FreeNode(node* n)
+    {
+        n->next = freelist;
+        freelist = n;
+    }
+
+    template <bool Const>
+    class iter
+    {
+        friend class pooledhashmap;
+        template <bool> friend class iter;
+        typedef typename std::conditional<Const, const pooledhashmap*, pooledhashmap*>::type map_pointer;
+        map_pointer map;
+        size_t pos;
+
+        iter(map_pointer mapIn, size_t posIn) : map(mapIn), pos(posIn) {}
+
+        void SkipFree()
+        {
+            while (pos < map->ctrl.size() && map->ctrl[pos] < 0)
+                pos++;
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename pooledhashmap::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        iter() : map(nullptr), pos(0) {}
+        /** Iterators convert to const_iterators */
+        template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+        iter(const iter<OtherConst>& other) : map(other.map), pos(other.pos) {}
+
+        reference operator*() const { return map->slots[pos]->value; }
+        pointer operator->() const { return &map->slots[pos]->value; }
+
+        iter& operator++() { pos++; SkipFree(); return *this; }
+        iter operator++(int) { iter copy(*this); ++(*this); return copy; }
+
+        friend bool operator==(const iter& a, const iter& b) { return a.pos == b.pos; }
+        friend bool operator!=(const iter& a, const iter& b) { return a.pos != b.pos; }
+    };
+
+public:
+    typedef iter<false> iterator;
+    typedef iter<true> const_iterator;
+
+    pooledhashmap() : nSize(0), nErased(0), nChunkLeft(0), freelist(nullptr), nPoolUsage(0) {}
+    pooledhashmap(const pooledhashmap&) = delete;
+    pooledhashmap& operator=(const pooledhashmap&) = delete;
+    ~pooledhashmap() { clear(); }
+
+    iterator begin() { iterator it(this, 0); it.SkipFree(); return it; }
+    const_iterator begin() const { const_iterator it(this, 0); it.SkipFree(); return it; }
+    iterator end() { return iterator(this, ctrl.size()); }
+    const_iterator end() const { return const_iterator(this, ctrl.size()); }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    iterator find(const K& key) { return iterator(this, FindSlot(key, hasher(key))); }
+    const_iterator find(const K& key) const { return const_iterator(this, FindSlot(key, hasher(key))); }
+    size_t count(const K& key) const { return find(key) != end(); }
+
+    /** Insert an entry constructed from the arguments of the key and of the value, unless the key is present */
+    template <typename... KArgs, typename... VArgs>
+    std::pair<iterator, bool> emplace(std::piecewise_construct_t, std::tuple<KArgs...> keyArgs, std::tuple<VArgs...> valueArgs)
+    {
+        const K& key = std::get<0>(keyArgs);
+        size_t hash = hasher(key);
+        size_t pos = FindSlot(key, hash);
+        if (pos != ctrl.size())
+            return std::make_pair(iterator(this, pos), false);
+
+        Reserve();
+        pos = FindFreeSlot(hash);
+        node* n = AllocNode();
+        try {
+            new (&n->value) value_type(std::piecewise_construct, std::move(keyArgs), std::move(valueArgs));
+        } catch (...) {
+            FreeNode(n);
+            throw;
+        }
+        if (ctrl[pos] == CTRL_ERASED)
+            nErased--;
+        ctrl[pos] = H2(hash);
+        slots[pos] = n;
+        nSize++;
+        return std::make_pair(iterator(this, pos), true);
+    }
+
+    std::pair<iterator, bool> emplace(const K& key, T&& value)
+    {
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::move(value)));
+    }
+
+    T& operator[](const K& key)
+    {
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        size_t pos = it.pos;
+        assert(pos < ctrl.size() && ctrl[pos] >= 0);
+        node* n = slots[pos];
+        n->value.~value_type();
+        FreeNode(n);
+        slots[pos] = nullptr;
+        // A probe reaching this group stops at its empty slots anyway, so the slot can be empty again.
+        if (MatchByte(&ctrl[pos - pos % GROUP_SIZE], CTRL_EMPTY)) {
+            ctrl[pos] = CTRL_EMPTY;
+        } else {
+            ctrl[pos] = CTRL_ERASED;
+            nErased++;
+        }
+        nSize--;
+        iterator next(this, pos);
+        next.SkipFree();
+        return next;
+    }
+
+    size_t erase(const K& key)
+    {
+        const_iterator it = find(key);
+        if (it == end())
+            return 0;
+        erase(it);
+        return 1;
+    }
+
+    /** Destroy the entries and free all memory. */
+    void clear()
+    {
+        for (size_t i = 0; i < ctrl.size(); i++) {
+            if (ctrl[i] >= 0)
+                slots[i]->value.~value_type();
+        }
+        std::vector<int8_t>().swap(ctrl);
+        std::vector<node*>().swap(slots);
+        std::vector<std::unique_ptr<node[]>>().swap(chunks);
+        nSize = 0;
+        nErased = 0;
+        nChunkLeft = 0;
+        freelist = nullptr;
+        nPoolUsage = 0;
+    }
+
+    /** Exchange the entries, and the hashers, of two maps without moving any entry */
+    void swap(pooledhashmap& other)
+    {
+        ctrl.swap(other.ctrl);
+        slots.swap(other.slots);
+        std::swap(nSize, other.nSize);
+        std::swap(nErased, other.nErased);
+        chunks.swap(other.chunks);
+        std::swap(nChunkLeft, other.nChunkLeft);
+        std::swap(freelist, other.freelist);
+        std::swap(nPoolUsage, other.nPoolUsage);
+        std::swap(hasher, other.hasher);
+    }
+
+    /** Memory allocated by the map: the table and the chunks of entries, including erased ones */
+    size_t dynamic_usage() const
+    {
+        return nPoolUsage + memusage::MallocUsage(ctrl.capacity()) + memusage::MallocUsage(slots.capacity() * sizeof(node*)) +
+            memusage::MallocUsage(chunks.capacity() * sizeof(std::unique_ptr<node[]>));
+    }
+};
+
+namespace memusage
+{
+
+template<typename K, typename T, typename Hash>
+static inline size_t DynamicUsage(const pooledhashmap<K, T, Hash>& m)
+{
+    return m.dynamic_usage();
+}
+
+}
+
+#endif // FABCOIN_POOLEDHASHMAP_H
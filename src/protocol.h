@@ -240,6 +240,12 @@ extern const char *GETBLOCKTXN;
  * @since protocol version 70014 as described by BIP 152
  */
 extern const char *BLOCKTXN;
+/**
+ * Contains a run of block headers, each written against the one before it.
+ * Sent instead of "headers" to peers that set NODE_COMPACT_HEADERS, by nodes
+ * that set it too.
+ */
+extern const char *HEADERS2;
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -267,6 +273,9 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // NODE_COMPACT_HEADERS means the node sends and accepts "headers2" messages in place
+    // of "headers" between nodes that both set it.
+    NODE_COMPACT_HEADERS = (1 << 6),
 
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
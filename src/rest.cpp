@@ -14,12 +14,17 @@
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <utilstrencodings.h>
 #include <version.h>
 
+#include <tuple>
+
 #include <boost/algorithm/string.hpp>
 
+#include <libdevcore/RLP.h>
+
 #include <univalue.h>
 
 void avoidCompilerWarningsDefinedButNotUsedREST() {
@@ -27,6 +32,8 @@ void avoidCompilerWarningsDefinedButNotUsedREST() {
 }
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_STORAGE_ENTRIES = 10000; //default and max entries of a /rest/storage page
+static const int MAX_LOGS_BLOCKS = 2000; //max blocks of a /rest/logs range
 
 enum RetFormat {
     RF_UNDEF,
@@ -433,6 +440,361 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Split the query string off the URI part, e.g. "addresses=...&topics=..." */
+static std::map<std::string, std::string> ParseQueryString(std::string& param, const std::string& strURIPart)
+{
+    std::map<std::string, std::string> query;
+    const std::string::size_type pos = strURIPart.find('?');
+    param = strURIPart.substr(0, pos);
+    if (pos == std::string::npos)
+        return query;
+
+    std::vector<std::string> pairs;
+    boost::split(pairs, strURIPart.substr(pos + 1), boost::is_any_of("&"));
+    for (const std::string& pair : pairs) {
+        const std::string::size_type eq = pair.find('=');
+        if (eq != std::string::npos)
+            query[pair.substr(0, eq)] = pair.substr(eq + 1);
+    }
+    return query;
+}
+
+static bool WriteContractData(HTTPRequest* req, RetFormat rf, const std::string& binary, const std::function<UniValue()>& toJSON)
+{
+    switch (rf) {
+    case RF_BINARY: {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteHeader("Access-Control-Allow-Origin", "*");
+        req->WriteReply(HTTP_OK, binary);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(binary.begin(), binary.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteHeader("Access-Control-Allow-Origin", "*");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        std::string strJSON;
+        try {
+            strJSON = toJSON().write() + "\n";
+        } catch (const std::exception& e) {
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, std::string("Unreadable data: ") + e.what());
+        }
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteHeader("Access-Control-Allow-Origin", "*");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static UniValue ReceiptsToJSON(const std::string& raw)
+{
+    std::vector<TransactionReceiptInfo> receipts;
+    StorageResults::decodeResult(raw, receipts);
+    UniValue result(UniValue::VARR);
+    for (const TransactionReceiptInfo& receipt : receipts) {
+        UniValue tri(UniValue::VOBJ);
+        transactionReceiptInfoToJSON(receipt, tri);
+        result.push_back(tri);
+    }
+    return result;
+}
+
+/**
+ * Receipts of a transaction. The binary form is the RLP stored by -logevents, read from its
+ * database without cs_main.
+ */
+static bool rest_receipt(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    if (!fLogEvents)
+        return RESTERR(req, HTTP_NOT_FOUND, "Events indexing disabled (see -logevents)");
+
+    std::string raw;
+    if (!pstorageresult->getRawResult(uintToh256(hash), raw))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+    return WriteContractData(req, rf, raw, [&raw]() { return ReceiptsToJSON(raw); });
+}
+
+/**
+ * Receipts with logs of the blocks from/to, like searchlogs: the query may restrict them to
+ * some contracts ("addresses", comma separated), to topics ("topics", comma separated by
+ * position, "null" for any) and to blocks with "minconf" confirmations. The binary form is
+ * an RLP list of the stored receipts of the matching transactions. Only the confirmations
+ * need cs_main, the indexes are read from their databases.
+ */
+static bool rest_logs(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string pathPart, param;
+    std::map<std::string, std::string> query = ParseQueryString(pathPart, strURIPart);
+    const RetFormat rf = ParseDataFormat(param, pathPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No block range specified. Use /rest/logs/<from>/<to>.<ext>?addresses=<addresses>&topics=<topics>.");
+
+    if (!fLogEvents)
+        return RESTERR(req, HTTP_NOT_FOUND, "Events indexing disabled (see -logevents)");
+
+    int32_t fromBlock, toBlock = -1, minconf = 0;
+    if (!ParseInt32(path[0], &fromBlock) || fromBlock < 0 || (path[1] != "latest" && (!ParseInt32(path[1], &toBlock) || toBlock < fromBlock)))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid block range: " + param);
+    if (query.count("minconf") && (!ParseInt32(query["minconf"], &minconf) || minconf < 0))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid minconf: " + query["minconf"]);
+
+    std::set<dev::h160> addresses;
+    if (query.count("addresses")) {
+        std::vector<std::string> strAddresses;
+        boost::split(strAddresses, query["addresses"], boost::is_any_of(","));
+        for (const std::string& strAddress : strAddresses) {
+            if (strAddress.size() != 40 || !IsHex(strAddress))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + strAddress);
+            addresses.insert(dev::h160(strAddress));
+        }
+    }
+
+    std::vector<boost::optional<dev::h256>> topics;
+    if (query.count("topics")) {
+        std::vector<std::string> strTopics;
+        boost::split(strTopics, query["topics"], boost::is_any_of(","));
+        for (const std::string& strTopic : strTopics) {
+            if (strTopic == "null") {
+                topics.push_back(boost::none);
+                continue;
+            }
+            if (strTopic.size() != 64 || !IsHex(strTopic))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid topic: " + strTopic);
+            topics.push_back(dev::h256(strTopic));
+        }
+    }
+
+    int confirmedHeight;
+    {
+        LOCK(cs_main);
+        if (toBlock == -1)
+            toBlock = chainActive.Height();
+        confirmedHeight = chainActive.Height() - minconf;
+    }
+    // Each block of the range is a read of the height index, done without any lock held: bound them.
+    if (toBlock - fromBlock >= MAX_LOGS_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Block range too large (max: %d blocks): %s", MAX_LOGS_BLOCKS, param));
+    toBlock = std::min(toBlock, confirmedHeight);
+
+    std::vector<std::vector<uint256>> hashesToBlock;
+    if (toBlock >= fromBlock && pblocktree->ReadHeightIndex(fromBlock, toBlock, 0, hashesToBlock, addresses) == -1)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid block range: " + param);
+
+    std::vector<std::string> vRaw;
+    for (const std::vector<uint256>& hashesTx : hashesToBlock) {
+        for (const uint256& hashTx : hashesTx) {
+            std::string raw;
+            if (!pstorageresult->getRawResult(uintToh256(hashTx), raw))
+                continue;
+            vRaw.push_back(std::move(raw));
+        }
+    }
+
+    std::vector<TransactionReceiptInfo> receipts;
+    std::vector<std::string> vMatching;
+    try {
+        for (const std::string& raw : vRaw) {
+            std::vector<TransactionReceiptInfo> txReceipts;
+            StorageResults::decodeResult(raw, txReceipts);
+            bool fMatch = false;
+            for (TransactionReceiptInfo& receipt : txReceipts) {
+                if (receipt.logs.empty() || !receiptMatchesTopics(receipt, topics))
+                    continue;
+                fMatch = true;
+                receipts.push_back(std::move(receipt));
+            }
+            if (fMatch)
+                vMatching.push_back(raw);
+        }
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, std::string("Unreadable receipts: ") + e.what());
+    }
+
+    dev::RLPStream rlpReceipts;
+    rlpReceipts.appendList(vMatching.size());
+    for (const std::string& raw : vMatching)
+        rlpReceipts.appendRaw(dev::bytesConstRef(&raw));
+    const dev::bytes& out = rlpReceipts.out();
+
+    return WriteContractData(req, rf, std::string(out.begin(), out.end()), [&receipts]() {
+        UniValue result(UniValue::VARR);
+        for (const TransactionReceiptInfo& receipt : receipts) {
+            UniValue tri(UniValue::VOBJ);
+            transactionReceiptInfoToJSON(receipt, tri);
+            result.push_back(tri);
+        }
+        return result;
+    });
+}
+
+/**
+ * A view of the state of the tip, which can be read after cs_main is released: it shares the
+ * databases of globalState but not its caches.
+ */
+static std::unique_ptr<FascState> TipStateView()
+{
+    LOCK(cs_main);
+    std::unique_ptr<FascState> view(new FascState(dev::u256(0), globalState->db(), globalState->dbUtxo()));
+    view->setRoot(globalState->rootHash());
+    view->setRootUTXO(globalState->rootHashUTXO());
+    return view;
+}
+
+static bool ParseAddressStr(const std::string& strReq, dev::Address& address)
+{
+    if (!IsHex(strReq) || (strReq.size() != 40))
+        return false;
+
+    address = dev::Address(strReq);
+    return true;
+}
+
+/** Account of a contract at the tip. The binary form is its RLP in the state trie. */
+static bool rest_account(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string addressStr;
+    const RetFormat rf = ParseDataFormat(addressStr, strURIPart);
+
+    dev::Address address;
+    if (!ParseAddressStr(addressStr, address))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + addressStr);
+
+    std::unique_ptr<FascState> state = TipStateView();
+    std::string raw;
+    dev::bytes code;
+    try {
+        raw = state->rawAccount(address);
+        if (!raw.empty())
+            code = state->code(address);
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, std::string("Unreadable state: ") + e.what());
+    }
+    if (raw.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, addressStr + " not found");
+
+    dev::RLP account(raw);
+    dev::u256 balance;
+    try {
+        balance = account[1].toInt<dev::u256>();
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, std::string("Unreadable state: ") + e.what());
+    }
+    if (balance > MAX_MONEY)
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Balance out of range: " + balance.str());
+
+    return WriteContractData(req, rf, raw, [&]() {
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("address", addressStr));
+        result.push_back(Pair("nonce", uint64_t(account[0].toInt<dev::u256>())));
+        result.push_back(Pair("balance", CAmount(balance)));
+        result.push_back(Pair("storageRoot", account[2].toHash<dev::h256>().hex()));
+        result.push_back(Pair("codeHash", account[3].toHash<dev::h256>().hex()));
+        result.push_back(Pair("code", HexStr(code.begin(), code.end())));
+        return result;
+    });
+}
+
+/**
+ * Storage of a contract at the tip, in hashed key order, by pages of at most
+ * MAX_STORAGE_ENTRIES: the query may set "limit" and the hashed key to "start" from, the
+ * "next" of the previous page. The binary form is the RLP list of the [hashed key, key, value]
+ * entries followed by the next hashed key, empty on the last page.
+ */
+static bool rest_storage(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string pathPart, addressStr;
+    std::map<std::string, std::string> query = ParseQueryString(pathPart, strURIPart);
+    const RetFormat rf = ParseDataFormat(addressStr, pathPart);
+
+    dev::Address address;
+    if (!ParseAddressStr(addressStr, address))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + addressStr);
+
+    int32_t limit = MAX_STORAGE_ENTRIES;
+    if (query.count("limit") && (!ParseInt32(query["limit"], &limit) || limit <= 0 || (size_t)limit > MAX_STORAGE_ENTRIES))
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Invalid limit (max: %d): %s", MAX_STORAGE_ENTRIES, query["limit"]));
+
+    dev::h256 start;
+    if (query.count("start")) {
+        if (!IsHex(query["start"]) || query["start"].size() != 64)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid start: " + query["start"]);
+        start = dev::h256(query["start"]);
+    }
+
+    std::unique_ptr<FascState> state = TipStateView();
+    std::vector<std::tuple<dev::h256, dev::u256, dev::u256>> entries;
+    bool more = false;
+    dev::h256 next;
+    try {
+        if (!state->addressInUse(address))
+            return RESTERR(req, HTTP_NOT_FOUND, addressStr + " not found");
+        state->forEachStorage(address, start, [&](const dev::h256& hashedKey, const dev::u256& key, const dev::u256& value) {
+            if (entries.size() == (size_t)limit) {
+                more = true;
+                next = hashedKey;
+                return false;
+            }
+            entries.emplace_back(hashedKey, key, value);
+            return true;
+        });
+    } catch (const std::exception& e) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, std::string("Unreadable state: ") + e.what());
+    }
+
+    dev::RLPStream rlpStorage(2);
+    rlpStorage.appendList(entries.size());
+    for (const auto& entry : entries)
+        rlpStorage.appendList(3) << std::get<0>(entry) << std::get<1>(entry) << std::get<2>(entry);
+    if (more)
+        rlpStorage << next;
+    else
+        rlpStorage << dev::bytes();
+    const dev::bytes& out = rlpStorage.out();
+
+    return WriteContractData(req, rf, std::string(out.begin(), out.end()), [&]() {
+        UniValue storage(UniValue::VOBJ);
+        for (const auto& entry : entries) {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV(dev::toHex(dev::h256(std::get<1>(entry))), dev::toHex(dev::h256(std::get<2>(entry))));
+            storage.pushKV(std::get<0>(entry).hex(), e);
+        }
+        UniValue result(UniValue::VOBJ);
+        result.pushKV("storage", storage);
+        if (more)
+            result.pushKV("next", next.hex());
+        return result;
+    });
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -635,6 +997,10 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/receipt/", rest_receipt},
+      {"/rest/logs/", rest_logs},
+      {"/rest/account/", rest_account},
+      {"/rest/storage/", rest_storage},
 };
 
 bool StartREST()
@@ -27,6 +27,7 @@
 #include <utilstrencodings.h>
 #include <hash.h>
 #include <libdevcore/CommonData.h>
+#include <fasc/fascprune.h>
 #include <txdb.h>
 
 #include <stdint.h>
@@ -177,63 +178,74 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+void blockToJSON(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
     int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
+    CBlockIndex *pnext;
+    {
+        LOCK(cs_main);
+        // Only report confirmations if the block is on the main chain
+        if (chainActive.Contains(blockindex))
+            confirmations = chainActive.Height() - blockindex->nHeight + 1;
+        pnext = chainActive.Next(blockindex);
+    }
+    writer.BeginObject();
+    writer.KeyValue("hash", blockindex->GetBlockHash().GetHex());
+    writer.KeyValue("confirmations", confirmations);
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    result.push_back(
-        Pair("strippedsize",
+    writer.KeyValue("strippedsize",
              (int)::GetSerializeSize(block, SER_NETWORK,
-                                     PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS )));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION )));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block, consensusParams)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+                                     PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS ));
+    writer.KeyValue("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION ));
+    writer.KeyValue("weight", (int)::GetBlockWeight(block, consensusParams));
+    writer.KeyValue("height", blockindex->nHeight);
+    writer.KeyValue("version", block.nVersion);
+    writer.KeyValue("versionHex", strprintf("%08x", block.nVersion));
+    writer.KeyValue("merkleroot", block.hashMerkleRoot.GetHex());
 
     bool contract_format =  blockindex->IsSupportContract();  //!!!
     bool legacy_format = blockindex->IsLegacyFormat() ;  //!!!
     if ( contract_format ) {
-        result.push_back(Pair("hashStateRoot", block.hashStateRoot.GetHex())); // fasc
-        result.push_back(Pair("hashUTXORoot", block.hashUTXORoot.GetHex())); // fasc
+        writer.KeyValue("hashStateRoot", block.hashStateRoot.GetHex()); // fasc
+        writer.KeyValue("hashUTXORoot", block.hashUTXORoot.GetHex()); // fasc
     }
-    UniValue txs(UniValue::VARR);
+    writer.Key("tx");
+    writer.BeginArray();
     for(const auto& tx : block.vtx)
     {
         if(txDetails)
         {
             UniValue objTx(UniValue::VOBJ);
             TxToUniv(*tx, uint256(), objTx, true, RPCSerializationFlags());
-            txs.push_back(objTx);
+            writer.Value(objTx);
         }
         else
-            txs.push_back(tx->GetHash().GetHex());
+            writer.Value(tx->GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    writer.End();
+    writer.KeyValue("time", block.GetBlockTime());
+    writer.KeyValue("mediantime", (int64_t)blockindex->GetMedianTimePast());
 
     if ( legacy_format ) 
-       result.push_back(Pair("nonce", (uint64_t)((uint32_t)block.nNonce.GetUint64(0))));
-    else result.push_back(Pair("nonce", block.nNonce.GetHex()));
+       writer.KeyValue("nonce", (uint64_t)((uint32_t)block.nNonce.GetUint64(0)));
+    else writer.KeyValue("nonce", block.nNonce.GetHex());
 
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    writer.KeyValue("bits", strprintf("%08x", block.nBits));
+    writer.KeyValue("difficulty", GetDifficulty(blockindex));
+    writer.KeyValue("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+        writer.KeyValue("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    return result;
+        writer.KeyValue("nextblockhash", pnext->GetBlockHash().GetHex());
+    writer.End();
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    JSONStreamWriter writer;
+    blockToJSON(writer, block, blockindex, txDetails);
+    return writer.Finish();
 }
 //////////////////////////////////////////////////////////////////////////// // fasc
 
@@ -484,6 +496,18 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
+    if (fVerbose) {
+        JSONStreamWriter writer(request);
+        LOCK(mempool.cs);
+        writer.BeginObject();
+        for (const CTxMemPoolEntry& e : mempool.mapTx) {
+            UniValue info(UniValue::VOBJ);
+            entryToJSON(info, e);
+            writer.KeyValue(e.GetTx().GetHash().ToString(), info);
+        }
+        writer.End();
+        return writer.Finish();
+    }
     return mempoolToJSON(fVerbose);
 }
 
@@ -725,13 +749,23 @@ UniValue getaccountinfo(const JSONRPCRequest& request)
 
 UniValue getstorage(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 1)
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 5)
         throw std::runtime_error(
-            "getstorage \"address\"\n"
+            "getstorage \"address\" ( blockNum index limit \"start\" )\n"
             "\nArgument:\n"
             "1. \"address\"          (string, required) The address to get the storage from\n"
             "2. \"blockNum\"         (string, optional) Number of block to get state from, \"latest\" keyword supported. Latest if not passed.\n"
             "3. \"index\"            (number, optional) Zero-based index position of the storage\n"
+            "4. \"limit\"            (number, optional) Return at most this many entries, in hashed key order. Can't be combined with index.\n"
+            "5. \"start\"            (string, optional) Hashed key to start from (inclusive), the \"next\" value of a previous call. Requires limit.\n"
+            "\nResult (with limit):\n"
+            "{\n"
+            "  \"storage\" : {...},   (object) The entries, in the same format as without limit\n"
+            "  \"next\" : \"hex\"     (string) Hashed key to pass as start to get the following entries; absent when there are none\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getstorage", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\"")
+            + HelpExampleCli("getstorage", "\"eb23c0b3e6042821da281a2e2364feb22dd543e3\" -1 null 100")
         );
 
     LOCK(cs_main);
@@ -741,13 +775,15 @@ UniValue getstorage(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect address");
 
     TemporaryState ts(globalState);
-    if (request.params.size() > 1)
+    if (request.params.size() > 1 && !request.params[1].isNull())
     {
         if (request.params[1].isNum())
         {
             auto blockNum = request.params[1].get_int();
             if((blockNum < 0 && blockNum != -1) || blockNum > chainActive.Height())
                 throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect block number");
+            if(blockNum != -1 && nPruneStateDepth && blockNum < chainActive.Height() - (int)nPruneStateDepth)
+                throw JSONRPCError(RPC_MISC_ERROR, "State of this block has been pruned (see -prunestate)");
 
             if(blockNum != -1)
                 ts.SetRoot(uintToh256(chainActive[blockNum]->hashStateRoot), uintToh256(chainActive[blockNum]->hashUTXORoot));
@@ -761,34 +797,65 @@ UniValue getstorage(const JSONRPCRequest& request)
     if(!globalState->addressInUse(addrAccount))
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Address does not exist");
 
-    UniValue result(UniValue::VOBJ);
-
-    bool onlyIndex = request.params.size() > 2;
+    bool onlyIndex = request.params.size() > 2 && !request.params[2].isNull();
     unsigned index = 0;
     if (onlyIndex)
         index = request.params[2].get_int();
 
-    auto storage(globalState->storage(addrAccount));
-
-    if (onlyIndex)
-    {
-        if (index >= storage.size())
-        {
-            std::ostringstream stringStream;
-            stringStream << "Storage size: " << storage.size() << " got index: " << index;
-            throw JSONRPCError(RPC_INVALID_PARAMS, stringStream.str());
+    bool paginated = request.params.size() > 3 && !request.params[3].isNull();
+    size_t limit = 0;
+    if (paginated) {
+        if (onlyIndex)
+            throw JSONRPCError(RPC_INVALID_PARAMS, "index and limit can't be used together");
+        int limitParam = request.params[3].get_int();
+        if (limitParam <= 0)
+            throw JSONRPCError(RPC_INVALID_PARAMS, "limit must be positive");
+        limit = limitParam;
+    }
+
+    dev::h256 start;
+    if (request.params.size() > 4 && !request.params[4].isNull()) {
+        if (!paginated)
+            throw JSONRPCError(RPC_INVALID_PARAMS, "start requires limit");
+        std::string strStart = request.params[4].get_str();
+        if (strStart.size() != 64 || !CheckHex(strStart))
+            throw JSONRPCError(RPC_INVALID_PARAMS, "Incorrect start");
+        start = dev::h256(strStart);
+    }
+
+    // The storage is streamed from the trie, so only the entries up to the requested ones are read.
+    UniValue storage(UniValue::VOBJ);
+    size_t count = 0;
+    bool more = false;
+    dev::h256 next;
+    globalState->forEachStorage(addrAccount, start, [&](const dev::h256& hashedKey, const dev::u256& key, const dev::u256& value) {
+        if (paginated && count == limit) {
+            more = true;
+            next = hashedKey;
+            return false;
         }
-        auto elem = std::next(storage.begin(), index);
-        UniValue e(UniValue::VOBJ);
+        if (!onlyIndex || count == index) {
+            UniValue e(UniValue::VOBJ);
+            e.pushKV(dev::toHex(dev::h256(key)), dev::toHex(dev::h256(value)));
+            storage.pushKV(hashedKey.hex(), e);
+        }
+        count++;
+        return !onlyIndex || count <= index;
+    });
 
-        storage = {{elem->first, {elem->second.first, elem->second.second}}};
-    }
-    for (const auto& j: storage)
+    if (onlyIndex && count <= index)
     {
-        UniValue e(UniValue::VOBJ);        
-        e.pushKV(dev::toHex(dev::h256(j.second.first)), dev::toHex(dev::h256(j.second.second)));
-        result.pushKV(j.first.hex(), e);
+        std::ostringstream stringStream;
+        stringStream << "Storage size: " << count << " got index: " << index;
+        throw JSONRPCError(RPC_INVALID_PARAMS, stringStream.str());
     }
+    if (!paginated)
+        return storage;
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("storage", storage);
+    if (more)
+        result.pushKV("next", next.hex());
     return result;
 }
 UniValue getblockheader(const JSONRPCRequest& request)
@@ -905,8 +972,6 @@ UniValue getblock(const JSONRPCRequest& request)
             + HelpExampleRpc("getblock", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -918,14 +983,20 @@ UniValue getblock(const JSONRPCRequest& request)
             verbosity = request.params[1].get_bool() ? 1 : 0;
     }
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
+    // Only the lookup holds cs_main: reading and formatting the block don't,
+    // so that batched getblock calls run in parallel
     CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        pblockindex = mapBlockIndex[hash];
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    }
 
     if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
         // Block not found on disk. This could be because we have the block
@@ -945,7 +1016,9 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    JSONStreamWriter writer(request);
+    blockToJSON(writer, block, pblockindex, verbosity >= 2);
+    return writer.Finish();
 }
 ////////////////////////////////////////////////////////////////////// // fasc
 /*UniValue contractcode(const JSONRPCRequest& request)
@@ -1512,7 +1585,8 @@ UniValue searchlogs(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Incorrect params");
     }
 
-    UniValue result(UniValue::VARR);
+    JSONStreamWriter writer(request);
+    writer.BeginArray();
 
     auto topics = params.topics;
 
@@ -1527,41 +1601,20 @@ UniValue searchlogs(const JSONRPCRequest& request)
                     continue;
                 }
 
-                if (!topics.empty()) {
-                    for (size_t i = 0; i < topics.size(); i++) {
-                        const auto& tc = topics[i];
-
-                        if (!tc) {
-                            continue;
-                        }
-
-                        for (const auto& log: receipt.logs) {
-                            auto filterTopicContent = tc.get();
-
-                            if (i >= log.topics.size()) {
-                                continue;
-                            }
-
-                            if (filterTopicContent == log.topics[i]) {
-                                goto push;
-                            }
-                        }
-                    }
-
-                    // Skip the log if none of the topics are matched
+                // Skip the log if none of the topics are matched
+                if (!receiptMatchesTopics(receipt, topics)) {
                     continue;
                 }
 
-            push:
-
                 UniValue tri(UniValue::VOBJ);
                 transactionReceiptInfoToJSON(receipt, tri);
-                result.push_back(tri);
+                writer.Value(tri);
             }
         }
     }
 
-    return result;
+    writer.End();
+    return writer.Finish();
 }
 
 UniValue gettransactionreceipt(const JSONRPCRequest& request)
@@ -1577,8 +1630,6 @@ UniValue gettransactionreceipt(const JSONRPCRequest& request)
     if(!fLogEvents)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Events indexing disabled");
 
-    LOCK(cs_main);
-
     std::string hashTemp = request.params[0].get_str();
     if(hashTemp.size() != 64){
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Incorrect hash");
@@ -1586,7 +1637,13 @@ UniValue gettransactionreceipt(const JSONRPCRequest& request)
 
     uint256 hash(uint256S(hashTemp));
 
-    std::vector<TransactionReceiptInfo> transactionReceiptInfo = pstorageresult->getResult(uintToh256(hash));
+    // Read the committed receipts from the database, without cs_main or the result cache, so
+    // that the lookups of a batch run in parallel.
+    std::vector<TransactionReceiptInfo> transactionReceiptInfo;
+    std::string raw;
+    if (pstorageresult->getRawResult(uintToh256(hash), raw)) {
+        StorageResults::decodeResult(raw, transactionReceiptInfo);
+    }
 
     UniValue result(UniValue::VARR);
     for(TransactionReceiptInfo& t : transactionReceiptInfo){
@@ -2487,16 +2544,58 @@ UniValue getchaintxstats(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue getdbinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getdbinfo ( stats )\n"
+            "\nReturns the cache usage and size of the LevelDB databases: the block index, the chain state,\n"
+            "the contract state and the receipts.\n"
+            "\nArguments:\n"
+            "1. stats        (boolean, optional, default=false) Include the LevelDB statistics of each database.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"path\": \"xxxx\",          (string) The directory of the database\n"
+            "    \"cachesize\": xxxxx,        (numeric) The cache given to the database, in bytes (half block cache, a quarter write buffers)\n"
+            "    \"cacheusage\": xxxxx,       (numeric) The bytes in its block cache\n"
+            "    \"approximatesize\": xxxxx,  (numeric) The approximate size of the database on disk, in bytes\n"
+            "    \"memoryusage\": xxxxx,      (numeric) The approximate memory used by the database, in bytes\n"
+            "    \"stats\": \"xxxx\"          (string, if stats is true) The compaction statistics of the database\n"
+            "  },...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbinfo", "")
+            + HelpExampleRpc("getdbinfo", "true")
+        );
+
+    bool fStats = request.params.size() > 0 && !request.params[0].isNull() && request.params[0].get_bool();
+
+    UniValue ret(UniValue::VARR);
+    for (const LevelDBInfo& info : GetLevelDBInfo()) {
+        UniValue db(UniValue::VOBJ);
+        db.push_back(Pair("path", info.name));
+        db.push_back(Pair("cachesize", (uint64_t)info.nCacheSize));
+        db.push_back(Pair("cacheusage", (uint64_t)info.nCacheUsage));
+        db.push_back(Pair("approximatesize", info.nApproximateSize));
+        db.push_back(Pair("memoryusage", (uint64_t)atoi64(info.strMemoryUsage)));
+        if (fStats)
+            db.push_back(Pair("stats", info.strStats));
+        ret.push_back(db);
+    }
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafe argNames
   //  --------------------- ------------------------  -----------------------  ------ ----------
     { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,  {} },
     { "blockchain",         "getchaintxstats",        &getchaintxstats,        true,  {"nblocks", "blockhash"} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
-    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose","legacy"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose","legacy"} },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {}, true },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,  {}, true },
+    { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose","legacy"}, true },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"}, true },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose","legacy"}, true },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true,  {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true,  {"txid","verbose"} },
@@ -2506,11 +2605,12 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          true,  {"verbose"} },
     { "blockchain",         "gettxout",               &gettxout,               true,  {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,  {} },
+    { "blockchain",         "getdbinfo",              &getdbinfo,              true,  {"stats"}, true },
     { "blockchain",         "gettxoutset",            &gettxoutset,            true,  {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        true,  {"height"} },
     { "blockchain",         "verifychain",            &verifychain,            true,  {"checklevel","nblocks"} },
     { "blockchain",         "getaccountinfo",         &getaccountinfo,         true,  {"contract_address"} },
-    { "blockchain",         "getstorage",             &getstorage,             true,  {"address, index, blockNum"} },
+    { "blockchain",         "getstorage",             &getstorage,             true,  {"address", "blockNum", "index", "limit", "start"} },
 
     { "blockchain",         "preciousblock",            &preciousblock,            true,  {"blockhash"} },
 
@@ -2524,7 +2624,7 @@ static const CRPCCommand commands[] =
     { "hidden",             "waitforblock",           &waitforblock,           true,  {"blockhash","timeout"} },
     { "hidden",             "waitforblockheight",     &waitforblockheight,     true,  {"height","timeout"} },
     { "blockchain",         "listcontracts",          &listcontracts,          true,  {"start", "maxDisplay"} },
-    { "blockchain",         "gettransactionreceipt",  &gettransactionreceipt,  true,  {"hash"} },
+    { "blockchain",         "gettransactionreceipt",  &gettransactionreceipt,  true,  {"hash"}, true },
     { "blockchain",         "searchlogs",             &searchlogs,             true,  {"fromBlock", "toBlock", "address", "topics"} },
     { "blockchain",         "waitforlogs",            &waitforlogs,            true,  {"fromBlock", "nblocks", "address", "topics"} },
 };
@@ -7,7 +7,9 @@
 
 class CBlock;
 class CBlockIndex;
+class JSONStreamWriter;
 class UniValue;
+struct TransactionReceiptInfo;
 
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
@@ -23,6 +25,7 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+void blockToJSON(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* blockindex, bool txDetails);
 
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
@@ -30,6 +33,9 @@ UniValue mempoolInfoToJSON();
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
 
+/** Contract execution receipt to JSON */
+void transactionReceiptInfoToJSON(const TransactionReceiptInfo& resExec, UniValue& entry);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex );
 
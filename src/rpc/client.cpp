@@ -118,6 +118,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblockheader", 2, "legacy" },
     { "getblockheader", 3, "no_contract" },
     { "getchaintxstats", 0, "nblocks" },
+    { "getdbinfo", 0, "stats" },
     { "gettransaction", 1, "include_watchonly" },
     { "gettransaction", 2, "waitconf" },
     { "getrawtransaction", 1, "verbose" },
@@ -179,6 +180,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listcontracts", 1, "maxDisplay" },
     { "getstorage", 2, "index" },
     { "getstorage", 1, "blockNum" },
+    { "getstorage", 3, "limit" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
     { "disconnectnode", 1, "nodeid" },
@@ -48,6 +48,7 @@ UniValue getlogfile(const JSONRPCRequest& request) {
         result.pushKV("error", errorStream.str());
         return result;
     }
+    theLog->flush();
     std::lock_guard<std::mutex> theGuard(theLog->lock);
     UniValue logLines;
     logLines.setArray();
@@ -56,6 +57,7 @@ UniValue getlogfile(const JSONRPCRequest& request) {
     }
     result.pushKV("logLines", logLines);
     result.pushKV("resultHTML",  theLog->ToStringStatistics());
+    result.pushKV("droppedLines", theLog->numberOfDroppedLines.load());
     result.pushKV("requestedLog", request.params[0]);
     return result;
 }
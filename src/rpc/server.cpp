@@ -22,7 +22,10 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
+#include <deque>
 #include <memory> // for unique_ptr
+#include <thread>
 #include <unordered_map>
 
 void avoidCompilerWarningsDefinedButNotUsedServer() {
@@ -37,6 +40,101 @@ static CCriticalSection cs_rpcWarmup;
 static RPCTimerInterface* timerInterface = nullptr;
 /* Map of name to timer. */
 static std::map<std::string, std::unique_ptr<RPCTimerBase> > deadlineTimers;
+/* Limit to the calls of a method running at once (-rpcmethodlimit), and the calls running. Set up by StartRPC. */
+static std::map<std::string, std::pair<int, int> > mapRPCMethodLimits;
+static std::mutex cs_rpcMethodLimits;
+
+/** Counts a call against the limit of its method while it runs, or throws if the limit is reached */
+class RPCMethodSlot
+{
+public:
+    explicit RPCMethodSlot(const std::string& method) : it(mapRPCMethodLimits.end())
+    {
+        std::lock_guard<std::mutex> lock(cs_rpcMethodLimits);
+        std::map<std::string, std::pair<int, int> >::iterator found = mapRPCMethodLimits.find(method);
+        if (found == mapRPCMethodLimits.end())
+            return;
+        if (found->second.second >= found->second.first)
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("Too many concurrent %s calls, the limit can be raised with -rpcmethodlimit", method));
+        found->second.second++;
+        it = found;
+    }
+    ~RPCMethodSlot()
+    {
+        if (it == mapRPCMethodLimits.end())
+            return;
+        std::lock_guard<std::mutex> lock(cs_rpcMethodLimits);
+        it->second.second--;
+    }
+private:
+    std::map<std::string, std::pair<int, int> >::iterator it;
+};
+
+/** Threads running the parallel calls of batches, besides the HTTP worker of each batch */
+class RPCBatchPool
+{
+public:
+    RPCBatchPool() : fRunning(false) {}
+
+    void Start(int nThreads)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fRunning = true;
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&RPCBatchPool::Run, this);
+    }
+
+    /** Runs the tasks already submitted, then joins the threads */
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fRunning = false;
+            cond.notify_all();
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        threads.clear();
+    }
+
+    bool Submit(const std::function<void()>& task)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!fRunning || threads.empty())
+            return false;
+        queue.push_back(task);
+        cond.notify_one();
+        return true;
+    }
+
+private:
+    void Run()
+    {
+        RenameThread("fabcoin-rpcbatch");
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (queue.empty())
+                    return;
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::mutex cs;
+    std::condition_variable cond;
+    std::deque<std::function<void()> > queue;
+    std::vector<std::thread> threads;
+    bool fRunning;
+};
+
+static RPCBatchPool rpcBatchPool;
+static int nRPCBatchConcurrency = DEFAULT_RPC_BATCH_CONCURRENCY;
 
 static struct CRPCSignals
 {
@@ -267,6 +365,67 @@ UniValue uptime(const JSONRPCRequest& jsonRequest)
     return GetTime() - GetStartupTime();
 }
 
+UniValue getrpcqueueinfo(const JSONRPCRequest& jsonRequest)
+{
+    if (jsonRequest.fHelp || jsonRequest.params.size() > 0)
+        throw std::runtime_error(
+                "getrpcqueueinfo\n"
+                        "\nReturns the state of the HTTP work queues, the time requests waited in them, and the method limits.\n"
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"queues\": [\n"
+                        "    {\n"
+                        "      \"name\": \"xxxx\",         (string) \"work\", or \"long-poll\" for the requests of blocking methods\n"
+                        "      \"threads\": n,           (numeric) Worker threads\n"
+                        "      \"depth\": n,             (numeric) Requests waiting for a thread\n"
+                        "      \"maxdepth\": n,          (numeric) Requests waiting above which new ones are rejected (-rpcworkqueue, -rpclongpollqueue)\n"
+                        "      \"processed\": n,         (numeric) Requests handed to a thread\n"
+                        "      \"rejected\": n,          (numeric) Requests rejected as the queue was full\n"
+                        "      \"avgwait\": n,           (numeric) Average time requests waited for a thread, in microseconds\n"
+                        "      \"maxwait\": n            (numeric) Longest time a request waited for a thread, in microseconds\n"
+                        "    }, ...\n"
+                        "  ],\n"
+                        "  \"methodlimits\": {        (json object) Methods limited with -rpcmethodlimit\n"
+                        "    \"method\": {\n"
+                        "      \"limit\": n,           (numeric) Calls allowed at once\n"
+                        "      \"running\": n          (numeric) Calls running\n"
+                        "    }, ...\n"
+                        "  }\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getrpcqueueinfo", "")
+                + HelpExampleRpc("getrpcqueueinfo", "")
+        );
+
+    UniValue queues(UniValue::VARR);
+    for (const HTTPWorkQueueInfo& info : GetHTTPWorkQueueInfo()) {
+        UniValue queue(UniValue::VOBJ);
+        queue.push_back(Pair("name", info.name));
+        queue.push_back(Pair("threads", info.threads));
+        queue.push_back(Pair("depth", (uint64_t)info.depth));
+        queue.push_back(Pair("maxdepth", (uint64_t)info.maxDepth));
+        queue.push_back(Pair("processed", info.processed));
+        queue.push_back(Pair("rejected", info.rejected));
+        queue.push_back(Pair("avgwait", info.processed ? info.totalWaitMicros / (int64_t)info.processed : 0));
+        queue.push_back(Pair("maxwait", info.maxWaitMicros));
+        queues.push_back(queue);
+    }
+    UniValue limits(UniValue::VOBJ);
+    {
+        std::lock_guard<std::mutex> lock(cs_rpcMethodLimits);
+        for (const auto& limit : mapRPCMethodLimits) {
+            UniValue method(UniValue::VOBJ);
+            method.push_back(Pair("limit", limit.second.first));
+            method.push_back(Pair("running", limit.second.second));
+            limits.push_back(Pair(limit.first, method));
+        }
+    }
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("queues", queues));
+    result.push_back(Pair("methodlimits", limits));
+    return result;
+}
+
 /**
  * Call Table
  */
@@ -277,6 +436,7 @@ static const CRPCCommand vRPCCommands[] =
     { "control",            "help",                   &help,                   true,  {"command"}  },
     { "control",            "stop",                   &stop,                   true,  {}  },
     { "control",            "uptime",                 &uptime,                 true,  {}  },
+    { "control",            "getrpcqueueinfo",        &getrpcqueueinfo,        true,  {}  },
 };
 
 CRPCTable::CRPCTable()
@@ -316,6 +476,25 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
+    mapRPCMethodLimits.clear();
+    for (const std::string& strLimit : gArgs.GetArgs("-rpcmethodlimit")) {
+        size_t nColon = strLimit.rfind(':');
+        int nLimit = 0;
+        if (nColon == std::string::npos || !ParseInt32(strLimit.substr(nColon + 1), &nLimit) || nLimit < 1) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcmethodlimit specification: %s. It is a method and the number of its calls allowed at once (e.g. searchlogs:2).", strLimit),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        mapRPCMethodLimits[strLimit.substr(0, nColon)] = std::make_pair(nLimit, 0);
+    }
+    int nBatchThreads = gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS);
+    if (nBatchThreads <= 0)
+        nBatchThreads = GetNumCores();
+    nRPCBatchConcurrency = std::max((int)gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY), 1);
+    // The HTTP worker of a batch runs calls too
+    LogPrint(BCLog::RPC, "Starting %d threads for batched calls\n", nBatchThreads - 1);
+    rpcBatchPool.Start(nBatchThreads - 1);
     fRPCRunning = true;
     g_rpcSignals.Started();
     return true;
@@ -331,6 +510,7 @@ void InterruptRPC()
 void StopRPC()
 {
     LogPrint(BCLog::RPC, "Stopping RPC\n");
+    rpcBatchPool.Stop();
     deadlineTimers.clear();
     DeleteAuthCookie();
     g_rpcSignals.Stopped();
@@ -401,6 +581,134 @@ void JSONRPCRequest::PollReply(const UniValue& result) {
     req->ChunkEnd();
 }
 
+JSONStreamWriter::JSONStreamWriter() : req(NULL), fStarted(false), fKey(false)
+{
+}
+
+JSONStreamWriter::JSONStreamWriter(const JSONRPCRequest& request) : JSONStreamWriter()
+{
+    req = request.req;
+    id = request.id;
+    if (req)
+        buffer = "{\"result\":";
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (fKey) {
+        fKey = false;
+        return;
+    }
+    if (!vOpen.empty()) {
+        if (!vOpen.back().second)
+            buffer += ',';
+        vOpen.back().second = false;
+    }
+}
+
+void JSONStreamWriter::Add(const UniValue& value)
+{
+    if (stack.empty())
+        result = value;
+    else if (stack.back().second.isObject())
+        stack.back().second.pushKV(strKey, value);
+    else
+        stack.back().second.push_back(value);
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (!fStarted) {
+        req->WriteHeader("Content-Type", "application/json");
+        // The chunked reply ends when the client closes the connection
+        req->WriteHeader("Connection", "close");
+        fStarted = true;
+    }
+    req->Chunk(buffer);
+    buffer.clear();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    if (!req) {
+        stack.emplace_back(strKey, UniValue(UniValue::VOBJ));
+        return;
+    }
+    Separate();
+    buffer += '{';
+    vOpen.emplace_back('}', true);
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    if (!req) {
+        stack.emplace_back(strKey, UniValue(UniValue::VARR));
+        return;
+    }
+    Separate();
+    buffer += '[';
+    vOpen.emplace_back(']', true);
+}
+
+void JSONStreamWriter::End()
+{
+    if (!req) {
+        assert(!stack.empty());
+        std::pair<std::string, UniValue> container = std::move(stack.back());
+        stack.pop_back();
+        strKey = container.first;
+        Add(container.second);
+        return;
+    }
+    assert(!vOpen.empty() && !fKey);
+    buffer += vOpen.back().first;
+    vOpen.pop_back();
+    if (buffer.size() >= JSON_STREAM_CHUNK_SIZE)
+        Flush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    if (!req) {
+        strKey = key;
+        return;
+    }
+    Separate();
+    buffer += UniValue(key).write();
+    buffer += ':';
+    fKey = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    if (!req) {
+        Add(value);
+        return;
+    }
+    Separate();
+    buffer += value.write();
+    if (buffer.size() >= JSON_STREAM_CHUNK_SIZE)
+        Flush();
+}
+
+UniValue JSONStreamWriter::Finish()
+{
+    if (!req) {
+        assert(stack.empty());
+        return result;
+    }
+    assert(vOpen.empty());
+    buffer += ",\"error\":null,\"id\":" + id.write() + "}\n";
+    if (!fStarted) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, buffer);
+    } else {
+        // Ended by the HTTP handler, see JSONStreamWriter
+        Flush();
+    }
+    return NullUniValue;
+}
+
 void JSONRPCRequest::parse(const UniValue& valRequest)
 {
     // Parse request
@@ -454,12 +762,71 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+/** Whether a call of a batch may run alongside the calls next to it */
+static bool IsParallelBatchCall(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    if (!method.isStr())
+        return false;
+    const CRPCCommand *pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->fParallelBatch;
+}
+
+/** Run the calls vReq[nBegin, nEnd) at once, on up to nRPCBatchConcurrency threads */
+static void JSONRPCExecParallel(const UniValue& vReq, size_t nBegin, size_t nEnd, std::vector<UniValue>& vReply)
+{
+    std::atomic<size_t> nNext(nBegin);
+    auto runCalls = [&]() {
+        for (size_t i = nNext++; i < nEnd; i = nNext++)
+            vReply[i] = JSONRPCExecOne(vReq[i]);
+    };
+
+    std::mutex cs;
+    std::condition_variable cond;
+    int nHelpers = 0;
+    int nDone = 0;
+    int nWanted = (int)std::min<size_t>(nEnd - nBegin, nRPCBatchConcurrency) - 1;
+    for (int i = 0; i < nWanted; i++) {
+        bool fSubmitted = rpcBatchPool.Submit([&]() {
+            runCalls();
+            std::lock_guard<std::mutex> lock(cs);
+            nDone++;
+            cond.notify_one();
+        });
+        if (!fSubmitted)
+            break;
+        nHelpers++;
+    }
+    runCalls();
+
+    // The helpers refer to this frame: wait for all of them, even if they found no call left
+    std::unique_lock<std::mutex> lock(cs);
+    while (nDone < nHelpers)
+        cond.wait(lock);
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
-    UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    // Runs of consecutive parallel calls run at once, the other calls in order between them
+    std::vector<UniValue> vReply(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsParallelBatchCall(vReq[nEnd]))
+            nEnd++;
+        if (nEnd - reqIdx > 1) {
+            JSONRPCExecParallel(vReq, reqIdx, nEnd, vReply);
+            reqIdx = nEnd;
+        } else {
+            vReply[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            reqIdx++;
+        }
+    }
 
+    UniValue ret(UniValue::VARR);
+    ret.push_backV(vReply);
     return ret.write() + "\n";
 }
 
@@ -527,6 +894,8 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     if (!pcmd)
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
 
+    RPCMethodSlot slot(request.strMethod);
+
     g_rpcSignals.PreCommand(*pcmd);
 
     try
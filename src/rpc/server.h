@@ -14,6 +14,7 @@
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <univalue.h>
 #include <httpserver.h>
@@ -21,6 +22,10 @@
 #include <condition_variable>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+/** Threads running the calls of batches in parallel, 0 for one per core */
+static const int DEFAULT_RPC_BATCH_THREADS = 0;
+/** Calls of a batch run at once */
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 16;
 
 struct CUpdatedBlock
 {
@@ -107,6 +112,71 @@ public:
     HTTPRequest *req;
 };
 
+/** Serialized result buffered by JSONStreamWriter before it is sent as a chunk. */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writer for results too large to be built as a whole, e.g. searchlogs or getblock with
+ * transaction details: the handler emits the result value by value instead of returning it.
+ *
+ * When the request came over HTTP, the result is serialized as it is written and sent in
+ * chunks of JSON_STREAM_CHUNK_SIZE, inside the JSON-RPC reply. Results under one chunk are
+ * sent as usual replies by Finish(). Otherwise (batches, the console) the result is built
+ * as a UniValue and returned by Finish().
+ *
+ * Sending a chunk doesn't wait for the client. The chunked reply is ended by the HTTP
+ * handler once the RPC handler returned, since that waits for the client to close the
+ * connection and the RPC handler may still hold locks when it calls Finish().
+ *
+ * Values, or keys and values inside objects, are written in order between the Begin and End
+ * calls of their container. Once a chunk was sent, an error can't be reported in the reply
+ * anymore: it is appended to the truncated result, and the reply fails to parse.
+ */
+class JSONStreamWriter
+{
+public:
+    /** Build the result as a UniValue. */
+    JSONStreamWriter();
+    /** Stream the result as the reply to request, if it came over HTTP. */
+    explicit JSONStreamWriter(const JSONRPCRequest& request);
+
+    void BeginObject();
+    void BeginArray();
+    void End();
+
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    void KeyValue(const std::string& key, const UniValue& value) { Key(key); Value(value); }
+
+    /**
+     * Complete the reply once the result is written. Returns the result, or NullUniValue
+     * if it was sent, or is being sent, already.
+     */
+    UniValue Finish();
+
+private:
+    void Separate();
+    void Add(const UniValue& value);
+    void Flush();
+
+    HTTPRequest* req;
+    UniValue id;
+
+    /** Serialization not sent yet, when streaming. */
+    std::string buffer;
+    /** Whether a chunk was sent. */
+    bool fStarted;
+    /** Closing character of each open container and whether it has no value yet, when streaming. */
+    std::vector<std::pair<char, bool> > vOpen;
+    /** Whether a key was written, and its value comes next. */
+    bool fKey;
+
+    /** Open containers with their keys in their parents, and the key of the next value, when building. */
+    std::vector<std::pair<std::string, UniValue> > stack;
+    std::string strKey;
+    UniValue result;
+};
+
 /** Query whether RPC is running */
 bool IsRPCRunning();
 
@@ -192,6 +262,8 @@ public:
     rpcfn_type actor;
     bool okSafeMode;
     std::vector<std::string> argNames;
+    /** Read-only and safe to run alongside other calls: run on several threads when batched */
+    bool fParallelBatch = false;
 };
 
 /**
@@ -138,6 +138,46 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for deserializing in place from a byte range owned by someone else,
+ * like a memory mapped file. The range must outlive the reader.
+ */
+class CSpanReader
+{
+public:
+    CSpanReader(int nTypeIn, int nVersionIn, const unsigned char* pbeginIn, size_t nSizeIn) : nType(nTypeIn), nVersion(nVersionIn), pbegin(pbeginIn), nSize(nSizeIn), nPos(0) {}
+
+    void read(char* pch, size_t nRead)
+    {
+        if (nRead > nSize - nPos)
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        memcpy(pch, pbegin + nPos, nRead);
+        nPos += nRead;
+    }
+    void ignore(size_t nIgnore)
+    {
+        if (nIgnore > nSize - nPos)
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        nPos += nIgnore;
+    }
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const { return nVersion; }
+    int GetType() const { return nType; }
+    size_t size() const { return nSize - nPos; }
+    bool empty() const { return nPos == nSize; }
+private:
+    const int nType;
+    const int nVersion;
+    const unsigned char* const pbegin;
+    const size_t nSize;
+    size_t nPos;
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
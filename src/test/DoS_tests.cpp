@@ -45,6 +45,26 @@ static NodeId id = 0;
 
 void UpdateLastBlockAnnounceTime(NodeId node, int64_t time_in_seconds);
 
+// Queue a message for ProcessMessages the way the socket handler does
+static void ReceiveMessage(PeerLogicValidation& peerLogic, CNode& node, const std::string& strCommand, const CDataStream& payload)
+{
+    CMessageHeader hdr(Params().MessageStart(), strCommand.c_str(), payload.size());
+    uint256 hash = Hash(payload.begin(), payload.end());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    CDataStream hdrStream(SER_NETWORK, INIT_PROTO_VERSION);
+    hdrStream << hdr;
+
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+    BOOST_REQUIRE_EQUAL(msg.readHeader(hdrStream.data(), hdrStream.size()), (int)CMessageHeader::HEADER_SIZE);
+    BOOST_REQUIRE_EQUAL(msg.readData(payload.data(), payload.size()), (int)payload.size());
+    BOOST_REQUIRE(msg.complete());
+    peerLogic.PrepareMessage(&node, msg);
+
+    LOCK(node.cs_vProcessMsg);
+    node.nProcessQueueSize += payload.size() + CMessageHeader::HEADER_SIZE;
+    node.vProcessMsg.push_back(msg);
+}
+
 BOOST_FIXTURE_TEST_SUITE(DoS_tests, TestingSetup)
 
 // Test eviction of an outbound peer whose chain never advances
@@ -238,6 +258,53 @@ BOOST_AUTO_TEST_CASE(DoS_banscore)
     peerLogic->FinalizeNode(dummyNode1.GetId(), dummy);
 }
 
+BOOST_AUTO_TEST_CASE(DoS_prepared_messages)
+{
+    std::atomic<bool> interruptDummy(false);
+
+    peerLogic->StartMessageParsers(2);
+    CAddress addr1(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode1(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr1, 4, 4, CAddress(), "", true);
+    dummyNode1.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(&dummyNode1);
+    dummyNode1.nVersion = 1;
+    dummyNode1.fSuccessfullyConnected = true;
+
+    // Too many headers are punished as when ProcessMessages reads them
+    CDataStream headers(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(headers, MAX_HEADERS_RESULTS + 1);
+    ReceiveMessage(*peerLogic, dummyNode1, NetMsgType::HEADERS, headers);
+    // A truncated block is rejected as malformed
+    CDataStream block(SER_NETWORK, PROTOCOL_VERSION);
+    block << (int32_t)1;
+    ReceiveMessage(*peerLogic, dummyNode1, NetMsgType::BLOCK, block);
+
+    std::vector<std::shared_ptr<CPreparedMessage>> vPrepared;
+    for (const CNetMessage& msg : dummyNode1.vProcessMsg)
+        vPrepared.push_back(msg.prepared);
+    BOOST_REQUIRE_EQUAL(vPrepared.size(), 2U);
+    for (const std::shared_ptr<CPreparedMessage>& prepared : vPrepared) {
+        BOOST_REQUIRE(prepared);
+        while (!prepared->fDone)
+            MilliSleep(1);
+    }
+
+    BOOST_CHECK(peerLogic->ProcessMessages(&dummyNode1, interruptDummy));
+    CNodeStateStats stats;
+    BOOST_REQUIRE(GetNodeStateStats(dummyNode1.GetId(), stats));
+    BOOST_CHECK_EQUAL(stats.nMisbehavior, 20);
+    BOOST_CHECK(dummyNode1.vSendMsg.empty());
+
+    BOOST_CHECK(!peerLogic->ProcessMessages(&dummyNode1, interruptDummy));
+    BOOST_CHECK_EQUAL(dummyNode1.vSendMsg.size(), 1U);
+    BOOST_CHECK(dummyNode1.vProcessMsg.empty());
+    BOOST_CHECK_EQUAL(dummyNode1.nProcessQueueSize, 0U);
+    peerLogic->StartMessageParsers(0);
+
+    bool dummy;
+    peerLogic->FinalizeNode(dummyNode1.GetId(), dummy);
+}
+
 BOOST_AUTO_TEST_CASE(DoS_bantime)
 {
     std::atomic<bool> interruptDummy(false);
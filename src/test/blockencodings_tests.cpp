@@ -6,6 +6,7 @@
 #include <consensus/merkle.h>
 #include <chainparams.h>
 #include <random.h>
+#include <validation.h>
 
 #include <test/test_fabcoin.h>
 
@@ -86,6 +87,12 @@ BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
         BOOST_CHECK( partialBlock.IsTxAvailable(0));
         BOOST_CHECK(!partialBlock.IsTxAvailable(1));
         BOOST_CHECK( partialBlock.IsTxAvailable(2));
+        {
+            std::vector<CTransactionRef> available = partialBlock.GetAvailableTransactions();
+            BOOST_REQUIRE_EQUAL(available.size(), 2U);
+            BOOST_CHECK(available[0]->GetHash() == block.vtx[0]->GetHash());
+            BOOST_CHECK(available[1]->GetHash() == block.vtx[2]->GetHash());
+        }
 
         BOOST_CHECK_EQUAL(pool.mapTx.find(block.vtx[2]->GetHash())->GetSharedTx().use_count(), SHARED_TX_OFFSET + 1);
 
@@ -347,4 +354,138 @@ BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BOOST_CHECK_EQUAL(req1.indexes[3], req2.indexes[3]);
 }
 
+// A run of linked headers from nHeight on, in the format of the selected network
+static std::vector<CBlockHeader> BuildHeadersTestCase(uint32_t nHeight, size_t nCount)
+{
+    std::vector<CBlockHeader> headers(nCount);
+    uint256 hashPrev = InsecureRand256();
+    uint32_t nTime = 1520000000;
+    for (size_t i = 0; i < nCount; i++) {
+        CBlockHeader& header = headers[i];
+        header.nVersion = 5;
+        header.hashPrevBlock = hashPrev;
+        header.hashMerkleRoot = InsecureRand256();
+        header.nHeight = nHeight + i;
+        nTime += InsecureRandRange(600);
+        header.nTime = nTime;
+        header.nBits = 0x1f07ffff;
+        header.hashStateRoot = i % 4 ? headers[i - 1].hashStateRoot : InsecureRand256();
+        header.hashUTXORoot = InsecureRand256();
+        if (_IsLegacyFormat(header.nHeight)) {
+            header.nNonce = ArithToUint256(arith_uint256(InsecureRand32()));
+        } else {
+            header.nNonce = InsecureRand256();
+            header.nSolution.resize(GetEquihashSolutionSize(header.nHeight));
+            for (unsigned char& c : header.nSolution)
+                c = InsecureRandBits(8);
+        }
+        hashPrev = header.GetHash();
+    }
+    return headers;
+}
+
+// Writes headers as a headers2 message, reads them back and returns the message size
+static size_t CheckCompactHeadersRoundTrip(const std::vector<CBlockHeader>& headers)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CompactHeadersWriter<CBlockHeader>(headers);
+    size_t nSize = stream.size();
+
+    std::vector<CBlockHeader> headers2;
+    unsigned int nCount;
+    BOOST_REQUIRE(ReadCompactHeaders(stream, headers2, MAX_HEADERS_RESULTS, nCount));
+    BOOST_CHECK(stream.empty());
+    BOOST_REQUIRE_EQUAL(nCount, headers.size());
+    BOOST_REQUIRE_EQUAL(headers2.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        BOOST_CHECK_EQUAL(headers2[i].GetHash().ToString(), headers[i].GetHash().ToString());
+        BOOST_CHECK_EQUAL(headers2[i].nHeight, headers[i].nHeight);
+        BOOST_CHECK(headers2[i].nSolution == headers[i].nSolution);
+    }
+    return nSize;
+}
+
+// The size of the same headers in a headers message
+static size_t HeadersMessageSize(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<CBlock> blocks(headers.begin(), headers.end());
+    return GetSerializeSize(blocks, SER_NETWORK, PROTOCOL_VERSION);
+}
+
+BOOST_FIXTURE_TEST_CASE(CompactHeadersRoundTripTest, BasicTestingSetup)
+{
+    // Across the switch to (184,7) and to contract headers
+    uint32_t nSwitchHeight = Params().GetConsensus().EquihashFABHeight;
+    std::vector<CBlockHeader> headers = BuildHeadersTestCase(nSwitchHeight - 10, 20);
+    BOOST_CHECK(headers.front().nSolution.size() != headers.back().nSolution.size());
+    size_t nSize = CheckCompactHeadersRoundTrip(headers);
+    BOOST_CHECK(nSize < HeadersMessageSize(headers));
+
+    // Each field that doesn't follow from the previous header
+    headers = BuildHeadersTestCase(nSwitchHeight, 12);
+    headers[1].nVersion = 4;
+    headers[2].hashPrevBlock = InsecureRand256();
+    headers[3].nHeight += 5;
+    headers[4].nTime = headers[3].nTime - 3000;
+    headers[5].nBits = 0x1e07ffff;
+    headers[6].nReserved[3] = 7;
+    headers[7].nSolution.resize(100);
+    headers[8].nSolution.clear();
+    headers[9].nTime = 0;
+    headers[10].nTime = std::numeric_limits<uint32_t>::max();
+    CheckCompactHeadersRoundTrip(headers);
+
+    CheckCompactHeadersRoundTrip(std::vector<CBlockHeader>());
+    headers.resize(1);
+    CheckCompactHeadersRoundTrip(headers);
+
+    // A full batch of (184,7) headers
+    headers = BuildHeadersTestCase(nSwitchHeight + 1000, MAX_HEADERS_RESULTS);
+    nSize = CheckCompactHeadersRoundTrip(headers);
+    BOOST_TEST_MESSAGE("headers2 " << nSize << " bytes, headers " << HeadersMessageSize(headers) << " bytes");
+    BOOST_CHECK(nSize < HeadersMessageSize(headers));
+}
+
+BOOST_AUTO_TEST_CASE(CompactHeadersLegacyRoundTripTest)
+{
+    // Without Equihash solutions, as on this network
+    std::vector<CBlockHeader> headers = BuildHeadersTestCase(1, 50);
+    BOOST_CHECK(headers.back().nSolution.empty());
+    size_t nSize = CheckCompactHeadersRoundTrip(headers);
+    BOOST_CHECK(nSize < HeadersMessageSize(headers));
+}
+
+BOOST_FIXTURE_TEST_CASE(CompactHeadersMalformedTest, BasicTestingSetup)
+{
+    std::vector<CBlockHeader> headers;
+    unsigned int nCount;
+
+    // Too many headers aren't read
+    CDataStream tooMany(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(tooMany, MAX_HEADERS_RESULTS + 1);
+    BOOST_CHECK(!ReadCompactHeaders(tooMany, headers, MAX_HEADERS_RESULTS, nCount));
+    BOOST_CHECK_EQUAL(nCount, MAX_HEADERS_RESULTS + 1);
+    BOOST_CHECK(headers.empty());
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CompactHeadersWriter<CBlockHeader>(BuildHeadersTestCase(Params().GetConsensus().EquihashFABHeight, 2));
+    CDataStream truncated(stream.begin(), stream.end() - 1, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_THROW(ReadCompactHeaders(truncated, headers, MAX_HEADERS_RESULTS, nCount), std::ios_base::failure);
+
+    // A time before 1970: one second before that of the null header the deltas start from
+    CDataStream early(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(early, 1);
+    uint64_t nTimeZigZag = 1;
+    early << (uint8_t)0 << uint256() << VARINT(nTimeZigZag);
+    BOOST_CHECK_THROW(ReadCompactHeaders(early, headers, MAX_HEADERS_RESULTS, nCount), std::ios_base::failure);
+
+    // Deltas no two times can be apart by, up to one that doesn't fit in an int64_t once decoded
+    for (uint64_t nTimeZigZagHuge : {((uint64_t)std::numeric_limits<uint32_t>::max() << 1) + 1, std::numeric_limits<uint64_t>::max()}) {
+        CDataStream huge(SER_NETWORK, PROTOCOL_VERSION);
+        WriteCompactSize(huge, 1);
+        huge << (uint8_t)0 << uint256() << VARINT(nTimeZigZagHuge);
+        BOOST_CHECK_THROW(ReadCompactHeaders(huge, headers, MAX_HEADERS_RESULTS, nCount), std::ios_base::failure);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,124 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/test_fabcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+void avoidCompilerWarningsDefinedButNotUsedBlockFileMapTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+CMutableTransaction WriteTestFile(const fs::path& path, uint32_t nLockTime)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+    tx.nLockTime = nLockTime;
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    file << tx;
+    return tx;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockfilemap_pool)
+{
+#ifdef WIN32
+    // Blocks are read through files on Windows
+    return;
+#endif
+    fs::path dir = pathTemp / "maps";
+    fs::create_directories(dir);
+    CMutableTransaction tx0 = WriteTestFile(dir / "blk00000.dat", 0);
+    WriteTestFile(dir / "blk00001.dat", 1);
+    WriteTestFile(dir / "blk00002.dat", 2);
+
+    CBlockFileMapPool pool(dir, 2);
+    // Nothing is final yet
+    BOOST_CHECK(!pool.Get(0));
+    pool.SetLastBlockFile(2);
+    // The file blocks are appended to is never mapped
+    BOOST_CHECK(!pool.Get(2));
+    BOOST_CHECK(!pool.Get(5));
+
+    std::shared_ptr<const CMappedFile> map0 = pool.Get(0);
+    BOOST_REQUIRE(map0);
+    BOOST_CHECK(pool.Get(0) == map0);
+    CSpanReader reader(SER_DISK, CLIENT_VERSION, map0->data(), map0->size());
+    CMutableTransaction tx;
+    reader >> tx;
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK(tx.GetHash() == tx0.GetHash());
+    BOOST_CHECK_THROW(reader >> tx, std::ios_base::failure);
+
+    // Mapping a third file evicts the least recently used one, which stays valid while referenced
+    pool.SetLastBlockFile(3);
+    BOOST_CHECK(pool.Get(1));
+    BOOST_CHECK(pool.Get(1) != map0);
+    BOOST_CHECK(pool.Get(2));
+    BOOST_CHECK_EQUAL(pool.MappedFiles(), 2U);
+    BOOST_CHECK_EQUAL(pool.MappedBytes(), 2 * map0->size());
+    BOOST_CHECK(pool.Get(0) != map0);
+    CSpanReader reader2(SER_DISK, CLIENT_VERSION, map0->data(), map0->size());
+    reader2 >> tx;
+    BOOST_CHECK(tx.GetHash() == tx0.GetHash());
+
+    pool.Drop(0);
+    BOOST_CHECK_EQUAL(pool.MappedFiles(), 1U);
+    // Moving the last block file back forgets the files that are no longer final
+    pool.SetLastBlockFile(0);
+    BOOST_CHECK_EQUAL(pool.MappedFiles(), 0U);
+    BOOST_CHECK(!pool.Get(0));
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilemap_raw_block, TestChain100Setup)
+{
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = chainActive.Tip();
+    }
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, pindex, Params().GetConsensus()));
+    CDataStream expected(SER_NETWORK, PROTOCOL_VERSION);
+    expected << block;
+
+    std::vector<uint8_t> raw;
+    BOOST_REQUIRE(ReadRawBlockFromDisk(raw, pindex, Params().MessageStart()));
+    BOOST_CHECK(raw == std::vector<uint8_t>(expected.begin(), expected.end()));
+
+#ifndef WIN32
+    // The same bytes come from the mapping, here of the file blocks are still appended to
+    pblockfilemaps.reset(new CBlockFileMapPool(GetDataDir() / "blocks", 1));
+    pblockfilemaps->SetLastBlockFile(pindex->nFile + 1);
+    std::vector<uint8_t> mapped;
+    BOOST_CHECK(ReadRawBlockFromDisk(mapped, pindex, Params().MessageStart()));
+    BOOST_CHECK_EQUAL(pblockfilemaps->MappedFiles(), 1U);
+    BOOST_CHECK(mapped == raw);
+    CBlock blockMapped;
+    BOOST_CHECK(ReadBlockFromDisk(blockMapped, pindex, Params().GetConsensus()));
+    BOOST_CHECK(blockMapped.GetHash() == block.GetHash());
+#endif
+
+    // A position that isn't preceded by the magic is refused
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    pos.nPos += 1;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, pos, Params().MessageStart()));
+    pblockfilemaps.reset();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
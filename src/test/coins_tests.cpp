@@ -5,6 +5,7 @@
 #include <coins.h>
 #include <script/standard.h>
 #include <uint256.h>
+#include <txdb.h>
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_fabcoin.h>
@@ -859,4 +860,56 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+
+BOOST_FIXTURE_TEST_CASE(coins_background_flush, TestingSetup)
+{
+    CCoinsViewBackgroundFlush flusher(pcoinsdbview);
+    flusher.Start();
+    CCoinsViewCache cache(&flusher);
+    std::map<COutPoint, CTxOut> unspent;
+    std::vector<COutPoint> spent;
+    uint256 hashBlock;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 1000; i++) {
+            COutPoint outpoint(InsecureRand256(), InsecureRandRange(4));
+            CTxOut txout(InsecureRandRange(1000) + 1, CScript() << OP_TRUE);
+            cache.AddCoin(outpoint, Coin(CTxOut(txout), round + 1, false), false);
+            unspent[outpoint] = txout;
+        }
+        // Spend coins of earlier rounds, which may be in the write in flight.
+        for (int i = 0; i < 100; i++) {
+            auto it = unspent.begin();
+            std::advance(it, InsecureRandRange(unspent.size()));
+            BOOST_CHECK(cache.SpendCoin(it->first));
+            spent.push_back(it->first);
+            unspent.erase(it);
+        }
+        hashBlock = InsecureRand256();
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+        BOOST_CHECK(flusher.GetBestBlock() == hashBlock);
+
+        // Whether or not the write completed, the coins read back are the ones flushed.
+        CCoinsViewCache view(&flusher);
+        for (const auto& coin : unspent)
+            BOOST_CHECK(view.AccessCoin(coin.first).out == coin.second);
+        for (const COutPoint& outpoint : spent)
+            BOOST_CHECK(!view.HaveCoin(outpoint));
+    }
+
+    BOOST_CHECK(flusher.Wait());
+    BOOST_CHECK(!flusher.IsWriting());
+    BOOST_CHECK_EQUAL(flusher.DynamicMemoryUsage(), 0U);
+    flusher.Stop();
+
+    BOOST_CHECK(pcoinsdbview->GetBestBlock() == hashBlock);
+    for (const auto& coin : unspent) {
+        Coin coinDB;
+        BOOST_CHECK(pcoinsdbview->GetCoin(coin.first, coinDB) && coinDB.out == coin.second);
+    }
+    for (const COutPoint& outpoint : spent)
+        BOOST_CHECK(!pcoinsdbview->HaveCoin(outpoint));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
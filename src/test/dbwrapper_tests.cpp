@@ -2,6 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/fabcoin-config.h>
+#endif
+
 #include <dbwrapper.h>
 #include <uint256.h>
 #include <random.h>
@@ -121,6 +125,36 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+// Test that databases on disk are reported by GetLevelDBInfo while open
+BOOST_AUTO_TEST_CASE(dbwrapper_info)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    auto find = [&ph]() {
+        std::vector<LevelDBInfo> vInfo = GetLevelDBInfo();
+        return std::find_if(vInfo.begin(), vInfo.end(), [&ph](const LevelDBInfo& info) { return info.name == ph.string(); }) != vInfo.end();
+    };
+    {
+        CDBWrapper dbw(ph, (1 << 20), false, false, false);
+        for (int i = 0; i < 100; i++)
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        uint256 res;
+        BOOST_CHECK(dbw.Read(0, res));
+
+        std::vector<LevelDBInfo> vInfo = GetLevelDBInfo();
+        auto it = std::find_if(vInfo.begin(), vInfo.end(), [&ph](const LevelDBInfo& info) { return info.name == ph.string(); });
+        BOOST_REQUIRE(it != vInfo.end());
+        BOOST_CHECK_EQUAL(it->nCacheSize, (size_t)(1 << 20));
+        BOOST_CHECK(it->nCacheUsage <= it->nCacheSize / 2);
+        BOOST_CHECK(!it->strStats.empty());
+    }
+    BOOST_CHECK(!find());
+    fs::remove_all(ph);
+
+    // In-memory databases are not reported
+    CDBWrapper dbwMemory(ph, (1 << 20), true, false, false);
+    BOOST_CHECK(!find());
+}
+
 // Test that we do not obfuscation if there is existing data.
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
@@ -323,4 +357,81 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_compression_parsing)
+{
+    std::string strError;
+    BOOST_CHECK(SetDBCompression("none", strError));
+    BOOST_CHECK(SetDBCompression("evmstate:none", strError));
+    BOOST_CHECK(GetDBCompression("evmstate") == leveldb::kNoCompression);
+
+    // Unknown codecs and databases are rejected and leave the setting alone
+    BOOST_CHECK(!SetDBCompression("bogus", strError));
+    BOOST_CHECK_EQUAL(strError, "Unsupported database compression: 'bogus'");
+    BOOST_CHECK(!SetDBCompression("evmstate:lz4", strError));
+    BOOST_CHECK_EQUAL(strError, "Unsupported database compression: 'lz4'");
+    BOOST_CHECK(!SetDBCompression("wallet:none", strError));
+    BOOST_CHECK_EQUAL(strError, "Unknown database for compression: 'wallet'");
+    BOOST_CHECK(GetDBCompression("evmstate") == leveldb::kNoCompression);
+    BOOST_CHECK(GetDBCompression("wallet") == leveldb::kNoCompression);
+
+#ifdef USE_SNAPPY
+    BOOST_CHECK(SetDBCompression("snappy", strError));
+    BOOST_CHECK(GetDBCompression("blockindex") == leveldb::kSnappyCompression);
+    BOOST_CHECK(GetDBCompression("receipts") == leveldb::kSnappyCompression);
+#else
+    BOOST_CHECK(!SetDBCompression("snappy", strError));
+#endif
+#ifdef USE_ZSTD
+    BOOST_CHECK(SetDBCompression("receipts:zstd", strError));
+    BOOST_CHECK(GetDBCompression("receipts") == leveldb::kZstdCompression);
+    BOOST_CHECK(GetDBCompression("evmstate") != leveldb::kZstdCompression);
+#else
+    BOOST_CHECK(!SetDBCompression("receipts:zstd", strError));
+#endif
+
+    BOOST_CHECK(SetDBCompression("none", strError));
+}
+
+// Tables written with each codec read back, also once the codec of new tables is changed.
+BOOST_AUTO_TEST_CASE(dbwrapper_compression_roundtrip)
+{
+    std::vector<leveldb::CompressionType> codecs = {leveldb::kNoCompression};
+#ifdef USE_SNAPPY
+    codecs.push_back(leveldb::kSnappyCompression);
+#endif
+#ifdef USE_ZSTD
+    codecs.push_back(leveldb::kZstdCompression);
+#endif
+
+    for (leveldb::CompressionType compression : codecs) {
+        fs::path ph = fs::temp_directory_path() / fs::unique_path();
+        std::vector<std::string> values;
+        for (int i = 0; i < 1000; i++)
+            values.push_back(std::string(512, 'a' + i % 26) + std::to_string(i));
+        {
+            CDBWrapper dbw(ph, (1 << 20), false, true, false, compression);
+            for (int i = 0; i < 1000; i++)
+                BOOST_CHECK(dbw.Write(i, values[i]));
+            // Push everything out of the memtable into compressed tables
+            dbw.CompactRange(0, 999);
+            for (int i = 0; i < 1000; i++) {
+                std::string res;
+                BOOST_CHECK(dbw.Read(i, res));
+                BOOST_CHECK_EQUAL(res, values[i]);
+            }
+            if (compression != leveldb::kNoCompression)
+                BOOST_CHECK(dbw.EstimateSize(0, 1000) < 1000 * 512 / 2);
+        }
+        {
+            CDBWrapper dbw(ph, (1 << 20), false, false, false, leveldb::kNoCompression);
+            for (int i = 0; i < 1000; i++) {
+                std::string res;
+                BOOST_CHECK(dbw.Read(i, res));
+                BOOST_CHECK_EQUAL(res, values[i]);
+            }
+        }
+        fs::remove_all(ph);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -378,4 +378,43 @@ BOOST_AUTO_TEST_CASE(bytecodeexec_contract_create_contracts){
     BOOST_CHECK(result.second.valueTransfers.size() == 0);
 }
 
+BOOST_AUTO_TEST_CASE(bytecodeexec_storage_iteration){
+    initState();
+    FascTransaction txEthCreate = createFascTransaction(CODE[3], 0, GASLIMIT, dev::u256(1), HASHTX, dev::Address());
+    executeBC(std::vector<FascTransaction>(1, txEthCreate));
+    dev::Address newAddress(createFascTokenAddress(txEthCreate.getHashWith(), txEthCreate.getNVout()));
+    std::vector<FascTransaction> txsCall;
+    for(size_t i = 0; i < 20; i++){
+        txsCall.push_back(createFascTransaction(valtype(ParseHex("3f811b80")), 0, GASLIMIT, dev::u256(1), HASHTX, newAddress, i));
+    }
+    executeBC(txsCall);
+
+    typedef std::map<dev::h256, std::pair<dev::u256, dev::u256> > StorageMap;
+    auto collect = [&](const dev::h256& begin, size_t limit) {
+        StorageMap result;
+        globalState->forEachStorage(newAddress, begin, [&](const dev::h256& hashedKey, const dev::u256& key, const dev::u256& value) {
+            result[hashedKey] = std::make_pair(key, value);
+            return result.size() < limit;
+        });
+        return result;
+    };
+
+    StorageMap storage = globalState->storage(newAddress);
+    size_t size = storage.size();
+    BOOST_REQUIRE(size > 15);
+    BOOST_CHECK(collect(dev::h256(), storage.size() + 1) == storage);
+
+    // Seek into the middle and stop after a few entries.
+    auto from = std::next(storage.begin(), 10);
+    BOOST_CHECK(collect(from->first, 5) == StorageMap(from, std::next(from, 5)));
+    BOOST_CHECK(collect(dev::h256(~dev::u256(0)), 5).empty());
+
+    // Uncommitted writes are merged over the trie.
+    globalState->setStorage(newAddress, dev::u256(1000), dev::u256(7));
+    globalState->setStorage(newAddress, from->second.first, dev::u256(0));
+    storage = globalState->storage(newAddress);
+    BOOST_CHECK(storage.size() == size);
+    BOOST_CHECK(collect(dev::h256(), storage.size() + 1) == storage);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
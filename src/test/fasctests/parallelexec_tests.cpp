@@ -0,0 +1,146 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascparallel.h>
+
+void avoidCompilerWarningsDefinedButNotUsedParallelExecTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+const dev::u256 PAR_GASLIMIT = dev::u256(500000);
+const dev::h256 PAR_HASHTX = dev::h256(ParseHex("bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"));
+
+struct ExecutionOutcome {
+    dev::h256 stateRoot;
+    dev::h256 utxoRoot;
+    std::vector<ResultExecute> results;
+};
+
+/** Execute every transaction on its own, in order, the way ConnectBlock does. */
+ExecutionOutcome executeSequentially(const std::vector<FascTransaction>& txs)
+{
+    ExecutionOutcome outcome;
+    for (const FascTransaction& tx : txs) {
+        auto res = executeBC(std::vector<FascTransaction>(1, tx));
+        for (const ResultExecute& r : res.first)
+            outcome.results.push_back(r);
+    }
+    outcome.stateRoot = globalState->rootHash();
+    outcome.utxoRoot = globalState->rootHashUTXO();
+    return outcome;
+}
+
+/** Same, with every transaction executed ahead of time through ParallelContractExecution. */
+ExecutionOutcome executeInParallel(const std::vector<FascTransaction>& txs, int& nAppliedOut)
+{
+    LOCK(cs_main);
+    CBlock block(generateBlock());
+    FascDGP fascDGP(globalState.get(), fGettingValuesDGP);
+    uint64_t blockGasLimit = fascDGP.getBlockGasLimit(chainActive.Tip()->nHeight + 1);
+    dev::eth::EVMSchedule schedule = fascDGP.getGasSchedule(chainActive.Tip()->nHeight + 1);
+
+    ParallelContractExecution parallelExec(block, blockGasLimit, schedule);
+    for (const FascTransaction& tx : txs) {
+        parallelExec.AddCandidate(h256Touint(tx.getHashWith()), std::vector<FascTransaction>(1, tx));
+    }
+    parallelExec.Run();
+
+    ExecutionOutcome outcome;
+    for (const FascTransaction& tx : txs) {
+        ByteCodeExec exec(block, std::vector<FascTransaction>(1, tx), blockGasLimit);
+        exec.setParallelExecution(&parallelExec);
+        exec.performByteCode();
+        std::vector<ResultExecute> res = exec.getResult();
+        ByteCodeExecResult bceExecRes;
+        exec.processingResults(bceExecRes);
+        globalState->db().commit();
+        globalState->dbUtxo().commit();
+        for (const ResultExecute& r : res)
+            outcome.results.push_back(r);
+    }
+    outcome.stateRoot = globalState->rootHash();
+    outcome.utxoRoot = globalState->rootHashUTXO();
+    nAppliedOut = parallelExec.AppliedCount();
+    return outcome;
+}
+
+void checkSameOutcome(const ExecutionOutcome& sequential, const ExecutionOutcome& parallel)
+{
+    BOOST_CHECK(sequential.stateRoot == parallel.stateRoot);
+    BOOST_CHECK(sequential.utxoRoot == parallel.utxoRoot);
+    BOOST_CHECK(sequential.results.size() == parallel.results.size());
+    for (size_t i = 0; i < sequential.results.size() && i < parallel.results.size(); i++) {
+        const ResultExecute& s = sequential.results[i];
+        const ResultExecute& p = parallel.results[i];
+        BOOST_CHECK(s.execRes.excepted == p.execRes.excepted);
+        BOOST_CHECK(s.execRes.gasUsed == p.execRes.gasUsed);
+        BOOST_CHECK(s.execRes.newAddress == p.execRes.newAddress);
+        BOOST_CHECK(s.execRes.output == p.execRes.output);
+        BOOST_CHECK(s.txRec.stateRoot() == p.txRec.stateRoot());
+        BOOST_CHECK(s.txRec.utxoRoot() == p.txRec.utxoRoot());
+        BOOST_CHECK(s.txRec.log().size() == p.txRec.log().size());
+        BOOST_CHECK(s.tx.GetHash() == p.tx.GetHash());
+    }
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(parallelexec_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(parallelexec_independent_creates){
+    initState();
+    globalSealEngine->setFascSchedule(FascDGP(globalState.get(), fGettingValuesDGP).getGasSchedule(chainActive.Tip()->nHeight + 1));
+    std::vector<FascTransaction> txs;
+    dev::h256 hash(PAR_HASHTX);
+    for (size_t i = 0; i < 4; i++) {
+        txs.push_back(createFascTransaction(CODE_TEMP, 0, PAR_GASLIMIT, dev::u256(1), hash, dev::Address()));
+        ++hash;
+    }
+    dev::h256 stateRoot = globalState->rootHash();
+    dev::h256 utxoRoot = globalState->rootHashUTXO();
+
+    ExecutionOutcome sequential = executeSequentially(txs);
+
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    int nApplied = 0;
+    ExecutionOutcome parallel = executeInParallel(txs, nApplied);
+
+    checkSameOutcome(sequential, parallel);
+    BOOST_CHECK(nApplied == 4);
+}
+
+BOOST_AUTO_TEST_CASE(parallelexec_conflicting_calls){
+    initState();
+    globalSealEngine->setFascSchedule(FascDGP(globalState.get(), fGettingValuesDGP).getGasSchedule(chainActive.Tip()->nHeight + 1));
+    FascTransaction txCreate = createFascTransaction(CODE_FACTORY, 0, PAR_GASLIMIT, dev::u256(1), PAR_HASHTX, dev::Address());
+    executeBC(std::vector<FascTransaction>(1, txCreate));
+    dev::Address factory(createFascTokenAddress(txCreate.getHashWith(), txCreate.getNVout()));
+
+    // Every call appends to the same storage array, so each one depends on the previous.
+    std::vector<FascTransaction> txs;
+    dev::h256 hash(PAR_HASHTX);
+    for (size_t i = 0; i < 3; i++) {
+        ++hash;
+        txs.push_back(createFascTransaction(valtype(ParseHex("3f811b80")), 0, PAR_GASLIMIT, dev::u256(1), hash, factory));
+    }
+    // An unrelated creation in between can still be applied.
+    ++hash;
+    txs.insert(txs.begin() + 1, createFascTransaction(CODE_TEMP, 0, PAR_GASLIMIT, dev::u256(1), hash, dev::Address()));
+    dev::h256 stateRoot = globalState->rootHash();
+    dev::h256 utxoRoot = globalState->rootHashUTXO();
+
+    ExecutionOutcome sequential = executeSequentially(txs);
+
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    int nApplied = 0;
+    ExecutionOutcome parallel = executeInParallel(txs, nApplied);
+
+    checkSameOutcome(sequential, parallel);
+    BOOST_CHECK(nApplied == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascpreexec.h>
+
+void avoidCompilerWarningsDefinedButNotUsedPreExecTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+const dev::u256 PREEXEC_GASLIMIT = dev::u256(500000);
+const dev::h256 PREEXEC_HASHTX = dev::h256(ParseHex("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"));
+
+dev::eth::EnvInfo buildEnvironment(const CBlock& block)
+{
+    FascDGP fascDGP(globalState.get(), fGettingValuesDGP);
+    ByteCodeExec exec(block, std::vector<FascTransaction>(), fascDGP.getBlockGasLimit(chainActive.Tip()->nHeight + 1));
+    return exec.BuildEVMEnvironment();
+}
+
+/** Execute txs on state the way the speculative executions do, recording them on top of hashTip. */
+std::shared_ptr<ContractExecutionRecord> recordExecution(FascState& state, const std::vector<FascTransaction>& txs, const dev::eth::EnvInfo& envInfo, const uint256& hashTip)
+{
+    std::vector<ResultExecute> results;
+    std::stringstream comments;
+    ContractExecutionRecorder recorder(state, txs, envInfo, hashTip);
+    for (const FascTransaction& tx : txs) {
+        results.push_back(state.execute(envInfo, *globalSealEngine, tx, dev::eth::Permanence::Committed, recorder.Tracer(), &comments));
+    }
+    globalSealEngine->deleteAddresses.clear();
+    return recorder.Finish(results, comments.str());
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(preexec_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(preexec_reuse_with_comments){
+    initState();
+    LOCK(cs_main);
+    globalSealEngine->setFascSchedule(FascDGP(globalState.get(), fGettingValuesDGP).getGasSchedule(chainActive.Tip()->nHeight + 1));
+    pcontractPreExecutor.reset(new ContractPreExecutor());
+
+    // A creation with value fails, and says why in the comments.
+    std::vector<FascTransaction> txs(1, createFascTransaction(CODE_TEMP, 1, PREEXEC_GASLIMIT, dev::u256(1), PREEXEC_HASHTX, dev::Address()));
+    CBlock block(generateBlock());
+    uint64_t blockGasLimit = FascDGP(globalState.get(), fGettingValuesDGP).getBlockGasLimit(chainActive.Tip()->nHeight + 1);
+    dev::h256 stateRoot = globalState->rootHash();
+    dev::h256 utxoRoot = globalState->rootHashUTXO();
+
+    std::stringstream commentsExecuted;
+    ByteCodeExec exec(block, txs, blockGasLimit);
+    BOOST_CHECK(exec.performByteCode(dev::eth::Permanence::Committed, &commentsExecuted));
+    std::vector<ResultExecute> executed = exec.getResult();
+    BOOST_CHECK(!commentsExecuted.str().empty());
+
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    std::stringstream commentsReused;
+    ByteCodeExec execAgain(block, txs, blockGasLimit);
+    BOOST_CHECK(pcontractPreExecutor->Reuse(txs, buildEnvironment(block)) != nullptr);
+    BOOST_CHECK(execAgain.performByteCode(dev::eth::Permanence::Committed, &commentsReused));
+    std::vector<ResultExecute> reused = execAgain.getResult();
+
+    BOOST_CHECK(commentsReused.str() == commentsExecuted.str());
+    BOOST_CHECK(reused.size() == executed.size());
+    for (size_t i = 0; i < reused.size() && i < executed.size(); i++) {
+        BOOST_CHECK(reused[i].execRes.excepted == executed[i].execRes.excepted);
+        BOOST_CHECK(reused[i].execRes.gasUsed == executed[i].execRes.gasUsed);
+        BOOST_CHECK(reused[i].txRec.stateRoot() == executed[i].txRec.stateRoot());
+    }
+    pcontractPreExecutor.reset();
+}
+
+BOOST_AUTO_TEST_CASE(preexec_overlay_and_stale_tip){
+    initState();
+    LOCK(cs_main);
+    globalSealEngine->setFascSchedule(FascDGP(globalState.get(), fGettingValuesDGP).getGasSchedule(chainActive.Tip()->nHeight + 1));
+    ContractPreExecutor preexec;
+
+    std::vector<FascTransaction> txs(1, createFascTransaction(CODE_TEMP, 0, PREEXEC_GASLIMIT, dev::u256(1), PREEXEC_HASHTX, dev::Address()));
+    dev::Address newAddress(createFascTokenAddress(PREEXEC_HASHTX, 0));
+    dev::eth::EnvInfo envInfo(buildEnvironment(generateBlock()));
+
+    // Executed on a private state whose overlay is never committed.
+    std::shared_ptr<FascState> overlay = std::make_shared<FascState>(dev::u256(0), globalState->db(), globalState->dbUtxo());
+    overlay->setRoot(globalState->rootHash());
+    overlay->setRootUTXO(globalState->rootHashUTXO());
+    std::shared_ptr<ContractExecutionRecord> record = recordExecution(*overlay, txs, envInfo, chainActive.Tip()->GetBlockHash());
+    record->overlay = overlay;
+    BOOST_CHECK(record->results.size() == 1 && record->results[0].execRes.excepted == dev::eth::TransactionException::None);
+    BOOST_CHECK(!globalState->db().exists(record->postStateRoot));
+
+    // Recorded on top of another tip: discarded.
+    std::shared_ptr<ContractExecutionRecord> stale = std::make_shared<ContractExecutionRecord>(*record);
+    stale->hashTip = uint256S("0x01");
+    preexec.Record(stale);
+    BOOST_CHECK(preexec.Reuse(txs, envInfo) == nullptr);
+    BOOST_CHECK(!globalState->db().exists(record->postStateRoot));
+
+    // Recorded on the tip: reused, and its post state copied from the overlay.
+    preexec.Record(record);
+    BOOST_CHECK(preexec.Reuse(txs, envInfo) == record);
+    BOOST_CHECK(globalState->db().exists(record->postStateRoot));
+    globalState->setRoot(record->postStateRoot);
+    globalState->setRootUTXO(record->postUTXORoot);
+    BOOST_CHECK(globalState->addressInUse(newAddress));
+    BOOST_CHECK(globalState->code(newAddress) == overlay->code(newAddress));
+
+    // The reused record only applies on top of the state it was made on.
+    BOOST_CHECK(preexec.Reuse(txs, envInfo) == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
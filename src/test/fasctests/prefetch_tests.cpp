@@ -0,0 +1,70 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascprefetch.h>
+
+void avoidCompilerWarningsDefinedButNotUsedPrefetchTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+/** A transaction creating a contract, spending a coin nobody has. */
+CTransactionRef createContractTx()
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(COutPoint(uint256S("0x01"), 0)));
+    valtype data(ParseHex("00"));
+    tx.vout.push_back(CTxOut(0, CScript() << CScriptNum(VersionVM::GetEVMDefault().toRaw()) << CScriptNum(500000) << CScriptNum(40) << data << OP_CREATE));
+    return MakeTransactionRef(tx);
+}
+
+CBlockHeader createHeader(const uint256& hashPrevBlock, uint32_t nTime)
+{
+    CBlockHeader header;
+    header.hashPrevBlock = hashPrevBlock;
+    header.nTime = nTime;
+    return header;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(prefetch_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(prefetch_queue_drops_oldest){
+    ContractStatePrefetcher prefetcher;
+    std::vector<CTransactionRef> txs(1, createContractTx());
+
+    // Blocks without contract transactions aren't queued
+    prefetcher.Prefetch(createHeader(uint256(), 0), std::vector<CTransactionRef>());
+    BOOST_CHECK(prefetcher.QueuedBlocks().empty());
+
+    std::vector<uint256> hashes;
+    for (uint32_t i = 0; i < MAX_CONTRACT_PREFETCH_QUEUE + 3; i++) {
+        CBlockHeader header = createHeader(uint256(), i);
+        prefetcher.Prefetch(header, txs);
+        hashes.push_back(header.GetHash());
+    }
+    std::vector<uint256> queued = prefetcher.QueuedBlocks();
+    BOOST_CHECK_EQUAL(queued.size(), MAX_CONTRACT_PREFETCH_QUEUE);
+    BOOST_CHECK(queued == std::vector<uint256>(hashes.begin() + 3, hashes.end()));
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_skips_stale_parent){
+    initState();
+    ContractStatePrefetcher prefetcher;
+    std::vector<CTransactionRef> txs(1, createContractTx());
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    prefetcher.Prefetch(createHeader(uint256S("0x02"), 0), txs);
+    prefetcher.Prefetch(createHeader(hashTip, 1), txs);
+    BOOST_CHECK(!prefetcher.PrefetchNext());
+    BOOST_CHECK(prefetcher.PrefetchNext());
+    BOOST_CHECK(!prefetcher.PrefetchNext());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
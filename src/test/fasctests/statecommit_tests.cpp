@@ -0,0 +1,73 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+
+#include <future>
+
+void avoidCompilerWarningsDefinedButNotUsedStateCommitTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+dev::eth::AccountMap storageWrites(unsigned accounts, unsigned slots)
+{
+    dev::eth::AccountMap cache;
+    for (unsigned i = 0; i < accounts; i++) {
+        dev::eth::Account& account = cache[dev::right160(dev::sha3(dev::h256(i)))];
+        account = dev::eth::Account(dev::u256(1), dev::u256(0));
+        for (unsigned j = 0; j < slots; j++)
+            account.setStorage(dev::u256(j), dev::u256(i * slots + j + 1));
+    }
+    return cache;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statecommit_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(statecommit_concurrent_storage_tries){
+    dev::eth::AccountMap cache = storageWrites(16, 64);
+
+    dev::OverlayDB serialDB;
+    std::unordered_map<dev::Address, dev::h256> serialRoots = dev::eth::commitStorage(cache, serialDB, false);
+    dev::OverlayDB concurrentDB;
+    std::unordered_map<dev::Address, dev::h256> concurrentRoots = dev::eth::commitStorage(cache, concurrentDB, true);
+
+    BOOST_CHECK(serialRoots.size() == cache.size());
+    BOOST_CHECK(concurrentRoots == serialRoots);
+    BOOST_CHECK(concurrentDB.get() == serialDB.get());
+
+    // Updating the tries again, on top of their roots, also gives the same result.
+    dev::eth::AccountMap updates;
+    for (const auto& root : serialRoots) {
+        dev::eth::Account& account = updates[root.first];
+        account = dev::eth::Account(dev::u256(1), dev::u256(0), root.second, dev::EmptySHA3, dev::eth::Account::Changed);
+        for (unsigned j = 0; j < 64; j += 2)
+            account.setStorage(dev::u256(j), dev::u256(0));
+    }
+    BOOST_CHECK(dev::eth::commitStorage(updates, concurrentDB, true) == dev::eth::commitStorage(updates, serialDB, false));
+    BOOST_CHECK(concurrentDB.get() == serialDB.get());
+}
+
+BOOST_AUTO_TEST_CASE(statecommit_on_pool_thread){
+    dev::eth::AccountMap cache = storageWrites(16, 64);
+
+    dev::OverlayDB serialDB;
+    std::unordered_map<dev::Address, dev::h256> serialRoots = dev::eth::commitStorage(cache, serialDB, false);
+
+    // A commit made by a task of the pool doesn't wait on the pool, which could be busy with its caller.
+    dev::OverlayDB pooledDB;
+    std::promise<std::unordered_map<dev::Address, dev::h256>> pooledRoots;
+    std::promise<bool> onPool;
+    dev::eth::postStorageCommitTask([&]() {
+        onPool.set_value(dev::eth::isStorageCommitThread());
+        pooledRoots.set_value(dev::eth::commitStorage(cache, pooledDB, true));
+    });
+    BOOST_CHECK(onPool.get_future().get() == (dev::eth::storageCommitThreads() > 0));
+    BOOST_CHECK(pooledRoots.get_future().get() == serialRoots);
+    BOOST_CHECK(pooledDB.get() == serialDB.get());
+    BOOST_CHECK(!dev::eth::isStorageCommitThread());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
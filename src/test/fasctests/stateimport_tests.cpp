@@ -0,0 +1,78 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascstateimport.h>
+
+void avoidCompilerWarningsDefinedButNotUsedStateImportTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+const dev::u256 IMPORT_GASLIMIT = dev::u256(500000);
+const dev::h256 IMPORT_HASHTX = dev::h256(ParseHex("eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee"));
+
+/** A contract state directory laid out like stateFasc. */
+std::unique_ptr<FascState> openStateDir(const fs::path& dir)
+{
+    const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+    std::unique_ptr<FascState> state(new FascState(dev::u256(0), FascState::openDB(dir.string(), hashDB, dev::WithExisting::Trust), dir.string(), dev::eth::BaseState::Empty));
+    state->setRootUTXO(dev::sha3(dev::rlp("")));
+    return state;
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(stateimport_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(stateimport_checked_copy){
+    // The state of another node: a factory and the contracts it created.
+    fs::path sourceDir = GetDataDir() / "sourceState";
+    globalState = openStateDir(sourceDir);
+    FascTransaction txCreate = createFascTransaction(CODE_FACTORY, 0, IMPORT_GASLIMIT, dev::u256(1), IMPORT_HASHTX, dev::Address());
+    executeBC(std::vector<FascTransaction>(1, txCreate));
+    dev::Address factory(createFascTokenAddress(txCreate.getHashWith(), txCreate.getNVout()));
+    std::vector<FascTransaction> txs;
+    for (size_t i = 0; i < 5; i++)
+        txs.push_back(createFascTransaction(valtype(ParseHex("3f811b80")), 0, IMPORT_GASLIMIT, dev::u256(1), IMPORT_HASHTX, factory, i));
+    executeBC(txs);
+
+    dev::h256 stateRoot = globalState->rootHash();
+    dev::h256 utxoRoot = globalState->rootHashUTXO();
+    std::string rawFactory = globalState->rawAccount(factory);
+    dev::bytes codeFactory = globalState->code(factory);
+    std::map<dev::h256, std::pair<dev::u256, dev::u256> > storage = globalState->storage(factory);
+    BOOST_REQUIRE(storage.size() > 0);
+    globalState->db().commit();
+    globalState->dbUtxo().commit();
+    globalState.reset();
+
+    globalState = openStateDir(GetDataDir() / "importedState");
+    std::string error;
+    BOOST_CHECK(!ImportContractState(GetDataDir() / "noState", stateRoot, utxoRoot, globalState->db(), globalState->dbUtxo(), error));
+    BOOST_CHECK(!ImportContractState(sourceDir, dev::sha3(std::string("no such root")), utxoRoot, globalState->db(), globalState->dbUtxo(), error));
+    BOOST_CHECK_MESSAGE(ImportContractState(sourceDir, stateRoot, utxoRoot, globalState->db(), globalState->dbUtxo(), error), error);
+
+    // The imported state is complete, and can be iterated.
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    BOOST_CHECK(globalState->rawAccount(factory) == rawFactory);
+    BOOST_CHECK(globalState->code(factory) == codeFactory);
+    BOOST_CHECK(globalState->storage(factory) == storage);
+    for (const auto& slot : storage)
+        BOOST_CHECK(globalState->storage(factory, slot.second.first) == slot.second.second);
+    globalState.reset();
+
+    // A node that doesn't match its hash fails the import.
+    dev::h256 storageRoot = dev::RLP(rawFactory)[2].toHash<dev::h256>();
+    {
+        const dev::h256 hashDB(dev::sha3(dev::rlp("")));
+        dev::OverlayDB sourceDB = FascState::openDB(sourceDir.string(), hashDB, dev::WithExisting::Trust);
+        BOOST_REQUIRE(sourceDB.db()->Put(ldb::WriteOptions(), ldb::Slice((const char*)storageRoot.data(), storageRoot.size), "corrupt node").ok());
+    }
+    globalState = openStateDir(GetDataDir() / "corruptState");
+    BOOST_CHECK(!ImportContractState(sourceDir, stateRoot, utxoRoot, globalState->db(), globalState->dbUtxo(), error));
+    BOOST_CHECK(error.find("doesn't match its hash") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
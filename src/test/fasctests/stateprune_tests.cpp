@@ -0,0 +1,111 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascDGP.h>
+#include <fasc/fascprune.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+
+void avoidCompilerWarningsDefinedButNotUsedStatePruneTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+const dev::u256 PRUNE_GASLIMIT = dev::u256(500000);
+const dev::h256 PRUNE_HASHTX = dev::h256(ParseHex("cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc"));
+
+bool nodeExists(ldb::DB* db, const dev::h256& hash)
+{
+    std::string node;
+    return db->Get(ldb::ReadOptions(), ldb::Slice((const char*)hash.data(), hash.size), &node).ok();
+}
+
+dev::h256 executeCreates()
+{
+    std::vector<FascTransaction> txs;
+    dev::h256 hash(PRUNE_HASHTX);
+    for (size_t i = 0; i < 3; i++) {
+        txs.push_back(createFascTransaction(CODE_TEMP, 0, PRUNE_GASLIMIT, dev::u256(1), hash, dev::Address()));
+        ++hash;
+    }
+    executeBC(txs);
+    return globalState->rootHash();
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(stateprune_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(stateprune_unreachable_nodes){
+    globalSealEngine->setFascSchedule(FascDGP(globalState.get(), fGettingValuesDGP).getGasSchedule(chainActive.Tip()->nHeight + 1));
+    dev::h256 stateRoot = globalState->rootHash();
+    dev::h256 utxoRoot = globalState->rootHashUTXO();
+    BOOST_REQUIRE(stateRoot == uintToh256(chainActive.Tip()->hashStateRoot));
+
+    // Executions on top of the tip that no block refers to.
+    dev::h256 orphanRoot = executeCreates();
+    ldb::DB* db = globalState->db().db();
+    BOOST_CHECK(orphanRoot != stateRoot);
+    BOOST_CHECK(nodeExists(db, orphanRoot));
+
+    StatePruner pruner(0);
+    BOOST_CHECK(pruner.Collect() > 0);
+    BOOST_CHECK(!nodeExists(db, orphanRoot));
+    BOOST_CHECK(nodeExists(db, stateRoot));
+
+    // The kept state is complete: executing the same transactions on it again gives the same state.
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    BOOST_CHECK(executeCreates() == orphanRoot);
+    BOOST_CHECK(nodeExists(db, orphanRoot));
+
+    // Nothing is left to collect from the kept state.
+    globalState->setRoot(stateRoot);
+    globalState->setRootUTXO(utxoRoot);
+    pruner.Collect();
+    BOOST_CHECK(pruner.Collect() == 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(stateprune_deep_reorg, TestChain100Setup){
+    unsigned int nPruneStateDepthOld = nPruneStateDepth;
+    nPruneStateDepth = 10;
+    CValidationState state;
+    CBlockIndex* pindexTip;
+    CBlockIndex* pindexInvalid;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+        int nHeight = pindexTip->nHeight;
+        // Counts from the tip at startup.
+        std::unique_ptr<StatePruner> prunerAtOldTip(new StatePruner(nPruneStateDepth));
+        BOOST_CHECK(CanRewindContractState(chainActive[nHeight - 10]));
+        BOOST_CHECK(!CanRewindContractState(chainActive[nHeight - 11]));
+
+        // Rewinding below the kept state is refused before anything is disconnected.
+        BOOST_CHECK(!InvalidateBlock(state, Params(), chainActive[nHeight - 10]));
+        BOOST_CHECK(chainActive.Tip() == pindexTip);
+        BOOST_CHECK(!(chainActive[nHeight - 10]->nStatus & BLOCK_FAILED_MASK));
+
+        // Down to the last kept state is fine.
+        state = CValidationState();
+        pindexInvalid = chainActive[nHeight - 9];
+        BOOST_CHECK(InvalidateBlock(state, Params(), pindexInvalid));
+        BOOST_CHECK_EQUAL(chainActive.Height(), nHeight - 10);
+        BOOST_CHECK(globalState->rootHash() == uintToh256(chainActive.Tip()->hashStateRoot));
+
+        // Further down from the lower tip, unless a collection ran at the old one.
+        BOOST_CHECK(CanRewindContractState(chainActive[nHeight - 12]));
+        BOOST_CHECK_EQUAL(prunerAtOldTip->LastCollectedHeight(), nHeight);
+        pstatePruner.swap(prunerAtOldTip);
+        BOOST_CHECK(!CanRewindContractState(chainActive[nHeight - 12]));
+        pstatePruner.reset();
+
+        ResetBlockFailureFlags(pindexInvalid);
+    }
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+    BOOST_CHECK(chainActive.Tip() == pindexTip);
+    nPruneStateDepth = nPruneStateDepthOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+#include <boost/test/unit_test.hpp>
+#include <test/test_fabcoin.h>
+#include <fasctests/test_utils.h>
+#include <fasc/fascsnapshot.h>
+
+void avoidCompilerWarningsDefinedButNotUsedStateSnapshotTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+const dev::u256 SNAPSHOT_GASLIMIT = dev::u256(500000);
+const dev::h256 SNAPSHOT_HASHTX = dev::h256(ParseHex("dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd"));
+
+/** Execute @a txs as a block on top of the current state and add its diff layer to @a snapshot. */
+dev::h256 connect(StateSnapshot& snapshot, const std::vector<FascTransaction>& txs)
+{
+    executeBC(txs);
+    dev::h256 base;
+    dev::eth::StateDiff diff = globalState->takeFlatDiff(base);
+    snapshot.AddLayer(base, globalState->rootHash(), std::move(diff));
+    return globalState->rootHash();
+}
+
+std::vector<FascTransaction> createContractCalls(const dev::Address& factory, size_t count)
+{
+    std::vector<FascTransaction> txs;
+    for (size_t i = 0; i < count; i++)
+        txs.push_back(createFascTransaction(valtype(ParseHex("3f811b80")), 0, SNAPSHOT_GASLIMIT, dev::u256(1), SNAPSHOT_HASHTX, factory, i));
+    return txs;
+}
+
+/** Check that the snapshot has the accounts and storage of the trie of @a root. */
+void checkSnapshot(const StateSnapshot& snapshot, const dev::h256& root, const std::vector<dev::Address>& addresses)
+{
+    globalState->setRoot(root);
+    for (const dev::Address& address : addresses) {
+        std::string rlp;
+        BOOST_CHECK(snapshot.account(root, address, rlp));
+        BOOST_CHECK(rlp == globalState->rawAccount(address));
+        for (const auto& slot : globalState->storage(address)) {
+            dev::u256 value;
+            BOOST_CHECK(snapshot.storage(root, address, slot.second.first, value));
+            BOOST_CHECK(value == slot.second.second);
+            BOOST_CHECK(globalState->storage(address, slot.second.first) == slot.second.second);
+        }
+    }
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(statesnapshot_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(statesnapshot_layers_and_reorg){
+    initState();
+    StateSnapshot snapshot(GetDataDir() / "stateSnapshot", 1 << 20, globalState->db());
+    dev::h256 genesisRoot = globalState->rootHash();
+    BOOST_REQUIRE(snapshot.Load(genesisRoot));
+    BOOST_CHECK(snapshot.DiskRoot() == genesisRoot);
+    globalState->setFlatStateReader(&snapshot);
+
+    FascTransaction txCreate = createFascTransaction(CODE_FACTORY, 0, SNAPSHOT_GASLIMIT, dev::u256(1), SNAPSHOT_HASHTX, dev::Address());
+    dev::h256 root1 = connect(snapshot, std::vector<FascTransaction>(1, txCreate));
+    dev::Address factory(createFascTokenAddress(txCreate.getHashWith(), txCreate.getNVout()));
+    dev::h256 root2 = connect(snapshot, createContractCalls(factory, 10));
+    BOOST_CHECK(snapshot.LayerCount() == 2);
+
+    // The factory, and an address that has no account.
+    std::vector<dev::Address> addresses{factory, dev::Address("0101010101010101010101010101010101010101")};
+    checkSnapshot(snapshot, root1, addresses);
+    checkSnapshot(snapshot, root2, addresses);
+    BOOST_CHECK(globalState->storage(factory).size() > 0);
+
+    // A reorganization: another block on top of root1. Both branches are known.
+    globalState->setRoot(root1);
+    dev::h256 root2b = connect(snapshot, createContractCalls(factory, 4));
+    BOOST_CHECK(root2b != root2);
+    BOOST_CHECK(snapshot.LayerCount() == 3);
+    checkSnapshot(snapshot, root2, addresses);
+    checkSnapshot(snapshot, root2b, addresses);
+
+    // Writing the new branch to disk drops the other one.
+    snapshot.Cap(root2b, 0);
+    BOOST_CHECK(snapshot.DiskRoot() == root2b);
+    BOOST_CHECK(snapshot.LayerCount() == 0);
+    std::string rlp;
+    BOOST_CHECK(!snapshot.account(root2, factory, rlp));
+    checkSnapshot(snapshot, root2b, addresses);
+
+    std::string strError;
+    BOOST_CHECK_MESSAGE(snapshot.Verify(root2b, strError), strError);
+
+    // States the snapshot no longer knows are read from the trie.
+    globalState->setRoot(root2);
+    std::map<dev::h256, std::pair<dev::u256, dev::u256> > storage = globalState->storage(factory);
+    BOOST_CHECK(storage.size() > 0);
+    for (const auto& slot : storage)
+        BOOST_CHECK(globalState->storage(factory, slot.second.first) == slot.second.second);
+
+    globalState->setFlatStateReader(nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(statesnapshot_load_checks_root){
+    initState();
+    fs::path path = GetDataDir() / "stateSnapshot";
+    dev::h256 root;
+    dev::Address factory;
+    {
+        StateSnapshot snapshot(path, 1 << 20, globalState->db());
+        BOOST_REQUIRE(snapshot.Load(globalState->rootHash()));
+        globalState->setFlatStateReader(&snapshot);
+        FascTransaction txCreate = createFascTransaction(CODE_FACTORY, 0, SNAPSHOT_GASLIMIT, dev::u256(1), SNAPSHOT_HASHTX, dev::Address());
+        connect(snapshot, std::vector<FascTransaction>(1, txCreate));
+        factory = createFascTokenAddress(txCreate.getHashWith(), txCreate.getNVout());
+        root = connect(snapshot, createContractCalls(factory, 3));
+        snapshot.Cap(root, 0);
+        globalState->setFlatStateReader(nullptr);
+    }
+    std::vector<dev::Address> addresses{factory};
+
+    // An intact snapshot is used as it is.
+    {
+        StateSnapshot snapshot(path, 1 << 20, globalState->db());
+        BOOST_CHECK(snapshot.Load(root));
+        BOOST_CHECK(snapshot.DiskRoot() == root);
+        checkSnapshot(snapshot, root, addresses);
+    }
+
+    // A snapshot whose entries don't hash to its root is generated again: here a storage slot
+    // of the factory is dropped behind its back, in the layout of the snapshot database.
+    globalState->setRoot(root);
+    std::map<dev::h256, std::pair<dev::u256, dev::u256> > storage = globalState->storage(factory);
+    BOOST_REQUIRE(storage.size() > 0);
+    {
+        CDBWrapper db(path, 1 << 20);
+        db.Erase(std::make_pair('s', std::make_pair(uint160(factory.asBytes()), u256Touint(storage.begin()->second.first))), true);
+    }
+    {
+        StateSnapshot snapshot(path, 1 << 20, globalState->db());
+        BOOST_CHECK(snapshot.Load(root));
+        checkSnapshot(snapshot, root, addresses);
+        std::string strError;
+        BOOST_CHECK_MESSAGE(snapshot.Verify(root, strError), strError);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
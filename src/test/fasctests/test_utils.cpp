@@ -4,6 +4,41 @@ void avoidCompilerWarningsDefinedButNotUsedTestUtils() {
     (void) FetchSCARShardPublicKeysInternalPointer;
 }
 
+/*
+    contract Temp {
+        function () payable {}
+    }
+*/
+const valtype CODE_TEMP(ParseHex("6060604052346000575b60398060166000396000f30060606040525b600b5b5b565b0000a165627a7a723058209cedb722bf57a30e3eb00eeefc392103ea791a2001deed29f5c3809ff10eb1dd0029"));
+
+/*
+    contract Factory {
+        bytes32[] Names;
+        address[] newContracts;
+
+        function createContract (bytes32 name) {
+            address newContract = new Contract(name);
+            newContracts.push(newContract);
+        }
+
+        function getName (uint i) {
+            Contract con = Contract(newContracts[i]);
+            Names[i] = con.Name();
+        }
+    }
+
+    contract Contract {
+        bytes32 public Name;
+
+        function Contract (bytes32 name) {
+            Name = name;
+        }
+
+        function () payable {}
+    }
+*/
+const valtype CODE_FACTORY(ParseHex("606060405234610000575b61034a806100196000396000f30060606040526000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680633f811b80146100495780636b8ff5741461006a575b610000565b3461000057610068600480803560001916906020019091905050610087565b005b3461000057610085600480803590602001909190505061015b565b005b60008160405160e18061023e833901808260001916600019168152602001915050604051809103906000f08015610000579050600180548060010182818154818355818115116101035781836000526020600020918201910161010291905b808211156100fe5760008160009055506001016100e6565b5090565b5b505050916000526020600020900160005b83909190916101000a81548173ffffffffffffffffffffffffffffffffffffffff021916908373ffffffffffffffffffffffffffffffffffffffff160217905550505b5050565b6000600182815481101561000057906000526020600020900160005b9054906101000a900473ffffffffffffffffffffffffffffffffffffffff1690508073ffffffffffffffffffffffffffffffffffffffff16638052474d6000604051602001526040518163ffffffff167c0100000000000000000000000000000000000000000000000000000000028152600401809050602060405180830381600087803b156100005760325a03f1156100005750505060405180519050600083815481101561000057906000526020600020900160005b5081600019169055505b50505600606060405234610000576040516020806100e1833981016040528080519060200190919050505b80600081600019169055505b505b609f806100426000396000f30060606040523615603d576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff1680638052474d146045575b60435b5b565b005b34600057604f606d565b60405180826000191660001916815260200191505060405180910390f35b600054815600a165627a7a72305820fe28ec2b77f3b306095bda73561b85d147a1026db2e5714aeeb2f29246cffcbb0029a165627a7a7230582086cf938db13cf2aa8bca8ad6e720861683ef2cc971ad66dad68708438a5e4a9b0029"));
+
 void initState(){
     boost::filesystem::path pathTemp;		
     pathTemp = fs::temp_directory_path() / strprintf("test_fasc_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
@@ -7,6 +7,11 @@
 
 extern std::unique_ptr<FascState> globalState;
 
+/** Contract with only a payable fallback. */
+extern const valtype CODE_TEMP;
+/** Factory contract: createContract(bytes32) (selector 3f811b80) deploys a contract and appends it to storage. */
+extern const valtype CODE_FACTORY;
+
 void initState();
 
 CBlock generateBlock();
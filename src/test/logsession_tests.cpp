@@ -0,0 +1,104 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <log_session.h>
+
+#include <test/test_fabcoin.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+void avoidCompilerWarningsDefinedButNotUsedLogSessionTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+// Turns the sessions on for the duration of a test.
+struct LogSessionSetup : public BasicTestingSetup {
+    bool previouslyTurnedOn;
+    LogSessionSetup() : previouslyTurnedOn(LogSession::flagLogsTurnedOn) {
+        LogSession::flagLogsTurnedOn = true;
+    }
+    ~LogSessionSetup() {
+        LogSession::flagLogsTurnedOn = previouslyTurnedOn;
+    }
+};
+
+std::vector<std::string> Lines(LogSession& session) {
+    session.flush();
+    return std::vector<std::string>(session.lines.begin(), session.lines.end());
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(logsession_tests, LogSessionSetup)
+
+BOOST_AUTO_TEST_CASE(logsession_interleaved_lines)
+{
+    // Lines being assembled for two sessions on one thread don't mix.
+    LogSession first("first", "");
+    LogSession second("second", "");
+    first << "first " << 1;
+    second << "second " << 2;
+    first << " end" << LogSession::endL;
+    second << " end" << LogSession::endL;
+    second << "second again" << LogSession::endL;
+    BOOST_CHECK(Lines(first) == std::vector<std::string>({"first 1 end"}));
+    BOOST_CHECK(Lines(second) == std::vector<std::string>({"second 2 end", "second again"}));
+}
+
+BOOST_AUTO_TEST_CASE(logsession_interleaved_threads)
+{
+    // Threads writing to both sessions at once: every line arrives whole, in the session it was
+    // written to, and the buffers of the threads are released once they exited and were flushed.
+    LogSession first("first", "");
+    LogSession second("second", "");
+    const int numberOfThreads = 4;
+    const int linesPerThread = 200; // less than a thread buffer: nothing is dropped without a flusher
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numberOfThreads; t++) {
+        threads.emplace_back([&first, &second, t, linesPerThread]() {
+            for (int i = 0; i < linesPerThread; i++) {
+                first << "thread " << t;
+                second << "thread " << t;
+                first << " line " << i << LogSession::endL;
+                second << " line " << i << LogSession::endL;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    first << "main" << LogSession::endL;
+
+    for (LogSession* session : {&first, &second}) {
+        std::vector<std::string> lines = Lines(*session);
+        BOOST_CHECK_EQUAL(session->numberOfDroppedLines, 0);
+        std::vector<int> nextLine(numberOfThreads, 0);
+        for (const std::string& line : lines) {
+            if (line == "main")
+                continue;
+            int t = -1, i = -1;
+            BOOST_CHECK_EQUAL(sscanf(line.c_str(), "thread %d line %d", &t, &i), 2);
+            BOOST_REQUIRE(t >= 0 && t < numberOfThreads);
+            // The lines of a thread keep their order
+            BOOST_CHECK_EQUAL(i, nextLine[t]);
+            nextLine[t] = i + 1;
+        }
+        for (int t = 0; t < numberOfThreads; t++) {
+            BOOST_CHECK_EQUAL(nextLine[t], linesPerThread);
+        }
+    }
+    BOOST_CHECK_EQUAL(first.lines.size(), (size_t) numberOfThreads * linesPerThread + 1);
+    // Only the buffers of this thread are left
+    BOOST_CHECK_EQUAL(first.buffers.size(), 1U);
+    BOOST_CHECK_EQUAL(second.buffers.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
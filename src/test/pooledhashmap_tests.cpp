@@ -0,0 +1,137 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <pooledhashmap.h>
+
+#include <test/test_fabcoin.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+void avoidCompilerWarningsDefinedButNotUsedPooledHashMapTests() {
+    (void) FetchSCARShardPublicKeysInternalPointer;
+}
+
+namespace {
+
+/** Few distinct hashes, so that keys share their groups and their control bytes */
+struct CollidingHasher
+{
+    size_t operator()(uint32_t key) const { return (key % 37) * 0x9e3779b97f4a7c15ULL; }
+};
+
+typedef pooledhashmap<uint32_t, std::string, CollidingHasher> testmap;
+
+void CheckEqual(const testmap& map, const std::unordered_map<uint32_t, std::string>& real)
+{
+    BOOST_CHECK_EQUAL(map.size(), real.size());
+    size_t count = 0;
+    for (testmap::const_iterator it = map.begin(); it != map.end(); ++it) {
+        auto itReal = real.find(it->first);
+        BOOST_REQUIRE(itReal != real.end());
+        BOOST_CHECK_EQUAL(it->second, itReal->second);
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, real.size());
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(pooledhashmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pooledhashmap_random)
+{
+    testmap map;
+    std::unordered_map<uint32_t, std::string> real;
+    for (int i = 0; i < 20000; i++) {
+        uint32_t key = InsecureRandRange(2000);
+        switch (InsecureRandRange(4)) {
+        case 0: {
+            std::string value = std::to_string(InsecureRand32());
+            auto inserted = map.emplace(key, std::string(value));
+            auto insertedReal = real.emplace(key, value);
+            BOOST_CHECK_EQUAL(inserted.second, insertedReal.second);
+            BOOST_CHECK_EQUAL(inserted.first->second, insertedReal.first->second);
+            break;
+        }
+        case 1:
+            map[key] += "x";
+            real[key] += "x";
+            break;
+        case 2:
+            BOOST_CHECK_EQUAL(map.erase(key), real.erase(key));
+            break;
+        case 3: {
+            testmap::iterator it = map.find(key);
+            BOOST_CHECK_EQUAL(it != map.end(), real.count(key) == 1);
+            if (it != map.end())
+                BOOST_CHECK_EQUAL(it->second, real[key]);
+            break;
+        }
+        }
+        if (i % 1000 == 0)
+            CheckEqual(map, real);
+    }
+    CheckEqual(map, real);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK_EQUAL(map.dynamic_usage(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(pooledhashmap_stable_references)
+{
+    testmap map;
+    std::vector<std::string*> values;
+    for (uint32_t key = 0; key < 1000; key++)
+        values.push_back(&map.emplace(key, std::to_string(key)).first->second);
+    // The table was rehashed several times, the entries didn't move
+    for (uint32_t key = 0; key < 1000; key++) {
+        BOOST_CHECK_EQUAL(&map.find(key)->second, values[key]);
+        BOOST_CHECK_EQUAL(*values[key], std::to_string(key));
+    }
+
+    // Nor do they when the maps are swapped
+    testmap other;
+    other.swap(map);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(other.size(), 1000U);
+    for (uint32_t key = 0; key < 1000; key++)
+        BOOST_CHECK_EQUAL(&other.find(key)->second, values[key]);
+}
+
+BOOST_AUTO_TEST_CASE(pooledhashmap_erase_while_iterating)
+{
+    testmap map;
+    for (uint32_t key = 0; key < 1000; key++)
+        map.emplace(key, std::to_string(key));
+
+    // Erase the odd keys like CCoinsViewCache::BatchWrite does, then the even ones with the returned iterator
+    size_t count = 0;
+    for (testmap::iterator it = map.begin(); it != map.end(); ) {
+        count++;
+        if (it->first % 2)
+            map.erase(it++);
+        else
+            ++it;
+    }
+    BOOST_CHECK_EQUAL(count, 1000U);
+    BOOST_CHECK_EQUAL(map.size(), 500U);
+    for (testmap::iterator it = map.begin(); it != map.end(); )
+        it = map.erase(it);
+    BOOST_CHECK(map.empty());
+
+    // Erased entries are reused before new chunks are allocated
+    size_t usage = map.dynamic_usage();
+    for (uint32_t key = 0; key < 1000; key++)
+        map.emplace(key, std::string());
+    BOOST_CHECK_EQUAL(map.dynamic_usage(), usage);
+    BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), usage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -347,4 +347,73 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_batch_order)
+{
+    // Replies come back in the order of the calls, whether they ran in parallel or not
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 200; i++) {
+        UniValue call(UniValue::VOBJ);
+        call.push_back(Pair("method", i % 7 == 3 ? "uptime" : (i % 2 ? "getblockcount" : "getbestblockhash")));
+        call.push_back(Pair("params", UniValue(UniValue::VARR)));
+        call.push_back(Pair("id", i));
+        batch.push_back(call);
+    }
+    auto checkReplies = [&batch]() {
+        UniValue replies;
+        BOOST_CHECK(replies.read(JSONRPCExecBatch(batch)));
+        BOOST_CHECK_EQUAL(replies.size(), batch.size());
+        for (size_t i = 0; i < replies.size(); i++) {
+            BOOST_CHECK_EQUAL(find_value(replies[i], "id").get_int(), (int)i);
+            BOOST_CHECK(find_value(replies[i], "error").isNull());
+            const UniValue& result = find_value(replies[i], "result");
+            if (i % 7 == 3)
+                BOOST_CHECK(result.isNum());
+            else if (i % 2)
+                BOOST_CHECK_EQUAL(result.get_int(), chainActive.Height());
+            else
+                BOOST_CHECK_EQUAL(result.get_str(), chainActive.Tip()->GetBlockHash().GetHex());
+        }
+    };
+
+    // Without the batch threads, the HTTP worker runs all the calls
+    checkReplies();
+
+    // With them, runs of getblockcount and getbestblockhash calls are shared with the threads
+    gArgs.ForceSetArg("-rpcbatchthreads", "4");
+    gArgs.ForceSetArg("-rpcbatchconcurrency", "4");
+    BOOST_CHECK(StartRPC());
+    for (int i = 0; i < 10; i++)
+        checkReplies();
+    InterruptRPC();
+    StopRPC();
+    gArgs.ForceSetArg("-rpcbatchthreads", std::to_string(DEFAULT_RPC_BATCH_THREADS));
+    gArgs.ForceSetArg("-rpcbatchconcurrency", std::to_string(DEFAULT_RPC_BATCH_CONCURRENCY));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_json_stream_writer)
+{
+    // Without an HTTP request, the result is built as a UniValue
+    JSONStreamWriter writer;
+    writer.BeginObject();
+    writer.KeyValue("hash", "00ff");
+    writer.Key("tx");
+    writer.BeginArray();
+    writer.Value(1);
+    writer.BeginObject();
+    writer.KeyValue("a", true);
+    writer.Key("b");
+    writer.BeginArray();
+    writer.End();
+    writer.End();
+    writer.End();
+    writer.KeyValue("time", 5);
+    writer.End();
+    BOOST_CHECK_EQUAL(writer.Finish().write(), "{\"hash\":\"00ff\",\"tx\":[1,{\"a\":true,\"b\":[]}],\"time\":5}");
+
+    JSONStreamWriter arrayWriter;
+    arrayWriter.BeginArray();
+    arrayWriter.End();
+    BOOST_CHECK_EQUAL(arrayWriter.Finish().write(), "[]");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -30,6 +30,7 @@ static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
 ////////////////////////////////////////// // fasc
 static const char DB_HEIGHTINDEX = 'h';
+static const char DB_IMPORTED_STATE = 'S';
 ////////////////////////////////////////// // fasc
 
 static const char DB_BEST_BLOCK = 'B';
@@ -62,7 +63,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, GetDBCompression("chainstate"))
 {
 }
 
@@ -114,7 +115,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    // The map is left as it is: CCoinsViewBackgroundFlush serves reads from it meanwhile, and
+    // erasing the pooled entries of the map as they are written would not free memory anyway.
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -124,8 +127,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -155,7 +156,162 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CCoinsViewBackgroundFlush::CCoinsViewBackgroundFlush(CCoinsView* viewIn) : CCoinsViewBacked(viewIn), fStarted(false), fStop(false), fWriting(false), fFailed(false), nWritingCoinsUsage(0) {}
+
+CCoinsViewBackgroundFlush::~CCoinsViewBackgroundFlush()
+{
+    Stop();
+}
+
+bool CCoinsViewBackgroundFlush::GetCoin(const COutPoint &outpoint, Coin &coin) const
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (fWriting) {
+            // The writer thread only reads the map too; it is released under the lock.
+            CCoinsMap::const_iterator it = mapWriting.find(outpoint);
+            if (it != mapWriting.end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    // Coins not being written are the same in the database before, during and after the write.
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewBackgroundFlush::HaveCoin(const COutPoint &outpoint) const
+{
+    Coin coin;
+    return GetCoin(outpoint, coin);
+}
+
+uint256 CCoinsViewBackgroundFlush::GetBestBlock() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (fWriting)
+        return hashWriting;
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewBackgroundFlush::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    std::unique_lock<std::mutex> lock(cs);
+    if (!fStarted) {
+        lock.unlock();
+        return base->BatchWrite(mapCoins, hashBlock);
+    }
+    if (fWriting) {
+        int64_t nStart = GetTimeMicros();
+        cond.wait(lock, [this]{ return !fWriting; });
+        LogPrint(BCLog::COINDB, "Waited %.2fms for the previous write of coins\n", 0.001 * (GetTimeMicros() - nStart));
+    }
+    if (fFailed)
+        return false;
+    // mapWriting is empty: the cache gets it in exchange.
+    mapWriting.swap(mapCoins);
+    hashWriting = hashBlock;
+    nWritingCoinsUsage = 0;
+    fWriting = true;
+    cond.notify_all();
+    return true;
+}
+
+void CCoinsViewBackgroundFlush::Start()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (fStarted)
+        return;
+    fStarted = true;
+    fStop = false;
+    thread = std::thread(&CCoinsViewBackgroundFlush::ThreadWrite, this);
+}
+
+void CCoinsViewBackgroundFlush::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!fStarted)
+            return;
+        fStop = true;
+        cond.notify_all();
+    }
+    thread.join();
+    std::lock_guard<std::mutex> lock(cs);
+    fStarted = false;
+}
+
+bool CCoinsViewBackgroundFlush::Wait()
+{
+    std::unique_lock<std::mutex> lock(cs);
+    cond.wait(lock, [this]{ return !fWriting; });
+    return !fFailed;
+}
+
+bool CCoinsViewBackgroundFlush::IsWriting() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return fWriting;
+}
+
+bool CCoinsViewBackgroundFlush::Failed() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return fFailed;
+}
+
+size_t CCoinsViewBackgroundFlush::DynamicMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (!fWriting)
+        return 0;
+    return memusage::DynamicUsage(mapWriting) + nWritingCoinsUsage;
+}
+
+void CCoinsViewBackgroundFlush::ThreadWrite()
+{
+    RenameThread("fabcoin-coinsflush");
+    std::unique_lock<std::mutex> lock(cs);
+    while (true) {
+        cond.wait(lock, [this]{ return fWriting || fStop; });
+        if (!fWriting)
+            break;
+        lock.unlock();
+
+        // Nothing else modifies mapWriting until fWriting is cleared.
+        size_t nCoinsUsage = 0;
+        for (CCoinsMap::const_iterator it = mapWriting.begin(); it != mapWriting.end(); ++it)
+            nCoinsUsage += it->second.coin.DynamicMemoryUsage();
+        lock.lock();
+        nWritingCoinsUsage = nCoinsUsage;
+        lock.unlock();
+
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = base->BatchWrite(mapWriting, hashWriting);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint(BCLog::COINDB, "Wrote %u coins at %s in the background in %.2fms\n", mapWriting.size(), hashWriting.ToString(), 0.001 * (GetTimeMicros() - nStart));
+
+        // Released outside of the lock, as freeing a large map takes a while.
+        CCoinsMap mapWritten;
+        lock.lock();
+        mapWritten.swap(mapWriting);
+        fWriting = false;
+        if (!fOk)
+            fFailed = true;
+        cond.notify_all();
+        lock.unlock();
+        mapWritten.clear();
+        lock.lock();
+    }
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, GetDBCompression("blockindex")) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -268,6 +424,14 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
 }
 
 /////////////////////////////////////////////////////// // fasc
+bool CBlockTreeDB::WriteImportedState(const uint256 &hashBlock) {
+    return Write(DB_IMPORTED_STATE, hashBlock);
+}
+
+bool CBlockTreeDB::ReadImportedState(uint256 &hashBlock) {
+    return Read(DB_IMPORTED_STATE, hashBlock);
+}
+
 bool CBlockTreeDB::WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const std::vector<uint256>& hash) {
     CDBBatch batch(*this);
     batch.Write(std::make_pair(DB_HEIGHTINDEX, heightIndex), hash);
@@ -10,8 +10,11 @@
 #include <dbwrapper.h>
 #include <chain.h>
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -44,6 +47,10 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -evmdbcache default (MiB), taken out of -dbcache for the contract state and receipt databases
+static const int64_t nDefaultEVMDBCache = 64;
+//! -backgroundflush default
+static const bool DEFAULT_BACKGROUND_FLUSH = true;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -112,6 +119,59 @@ private:
     friend class CCoinsViewDB;
 };
 
+/**
+ * CCoinsView between the coins cache and the coin database, which writes flushed coins in
+ * the background.
+ *
+ * Once started, BatchWrite takes the coins of the cache as they are, leaving the cache
+ * empty, and returns: a writer thread writes them to the base view while the cache fills
+ * up again. Until the write completes, the coins taken are an immutable layer from which
+ * reads are served. One write is in flight at a time, BatchWrite waits for the previous
+ * one. A failed write is reported by the next BatchWrite, by Wait and by Failed.
+ *
+ * The base view must write the coins without modifying the map, like CCoinsViewDB.
+ * Before Start and after Stop, BatchWrite writes synchronously.
+ */
+class CCoinsViewBackgroundFlush : public CCoinsViewBacked
+{
+public:
+    explicit CCoinsViewBackgroundFlush(CCoinsView* viewIn);
+    ~CCoinsViewBackgroundFlush();
+
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
+    bool HaveCoin(const COutPoint &outpoint) const override;
+    uint256 GetBestBlock() const override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+
+    //! Start the writer thread.
+    void Start();
+    //! Complete the write in flight and stop the writer thread.
+    void Stop();
+    //! Wait for the write in flight to complete. Returns false if a write failed.
+    bool Wait();
+    bool IsWriting() const;
+    bool Failed() const;
+    //! Memory used by the coins being written.
+    size_t DynamicMemoryUsage() const;
+
+private:
+    void ThreadWrite();
+
+    mutable std::mutex cs;
+    std::condition_variable cond;
+    std::thread thread;
+    bool fStarted;
+    bool fStop;
+
+    //! The coins being written, at hashWriting.
+    CCoinsMap mapWriting;
+    uint256 hashWriting;
+    bool fWriting;
+    bool fFailed;
+    //! Memory of the Coin objects of mapWriting, counted by the writer thread and set under cs.
+    size_t nWritingCoinsUsage;
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -133,6 +193,9 @@ public:
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 
 ////////////////////////////////////////////////////////////////////////////// // fasc
+    bool WriteImportedState(const uint256 &hashBlock);
+    bool ReadImportedState(uint256 &hashBlock);
+
     bool WriteHeightIndex(const CHeightTxIndexKey &heightIndex, const std::vector<uint256>& hash);
 
     /**
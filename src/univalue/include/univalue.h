@@ -48,8 +48,13 @@ public:
         std::string s(val_);
         setStr(s);
     }
+    UniValue(const UniValue&) = default;
+    UniValue(UniValue&&) = default;
     ~UniValue() {}
 
+    UniValue& operator=(const UniValue&) = default;
+    UniValue& operator=(UniValue&&) = default;
+
     void clear();
 
     bool setNull();
@@ -156,6 +161,7 @@ private:
     std::vector<UniValue> values;
 
     bool findKey(const std::string& key, size_t& retIdx) const;
+    void write(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeArray(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeObject(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
 
@@ -0,0 +1,49 @@
+// Copyright (c) 2018 FA Enterprise system
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#ifndef UNIVALUE_SCAN_H
+#define UNIVALUE_SCAN_H
+
+#include <stddef.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * Length of the run of characters at the start of [p, end) that stand for
+ * themselves in a JSON string: printable ASCII (0x20-0x7e) except '"' and '\\'.
+ * Most strings of RPC payloads (hex transactions and scripts, hashes, addresses)
+ * are one such run, which is copied as a whole when reading and writing instead
+ * of character by character. Scans 16 bytes at a time with SSE2.
+ */
+static inline size_t json_plain_run(const char *p, const char *end)
+{
+    const char *start = p;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i space = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+        __m128i chars = _mm_loadu_si128((const __m128i *)p);
+        // Compared as signed, both control characters and bytes over 0x7f are below ' '
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chars, quote), _mm_cmpeq_epi8(chars, backslash)),
+            _mm_or_si128(_mm_cmpeq_epi8(chars, del), _mm_cmplt_epi8(chars, space)));
+        int mask = _mm_movemask_epi8(special);
+        if (mask)
+            return (p - start) + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        unsigned char ch = *p;
+        if (ch < 0x20 || ch >= 0x7f || ch == '"' || ch == '\\')
+            break;
+        p++;
+    }
+    return p - start;
+}
+
+#endif // UNIVALUE_SCAN_H
@@ -45,6 +45,15 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII chars
+    void append(const char *s, size_t n)
+    {
+        if (state == 0)
+            str.append(s, n);
+        else
+            for (size_t i = 0; i < n; i++)
+                push_back(s[i]);
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint_)
     {
@@ -7,16 +7,23 @@
 #include <stdio.h>
 #include "univalue.h"
 #include "univalue_escapes.h"
+#include "univalue_scan.h"
 
 using namespace std;
 
-static string json_escape(const string& inS)
+static void json_escape(const string& inS, string& outS)
 {
-    string outS;
-    outS.reserve(inS.size() * 2);
+    const char *p = inS.data();
+    const char *end = p + inS.size();
 
-    for (unsigned int i = 0; i < inS.size(); i++) {
-        unsigned char ch = inS[i];
+    while (p < end) {
+        size_t run = json_plain_run(p, end);
+        outS.append(p, run);
+        p += run;
+        if (p == end)
+            break;
+
+        unsigned char ch = *p++;
         const char *escStr = escapes[ch];
 
         if (escStr)
@@ -24,8 +31,6 @@ static string json_escape(const string& inS)
         else
             outS += ch;
     }
-
-    return outS;
 }
 
 string UniValue::write(unsigned int prettyIndent,
@@ -34,6 +39,13 @@ string UniValue::write(unsigned int prettyIndent,
     string s;
     s.reserve(1024);
 
+    write(prettyIndent, indentLevel, s);
+
+    return s;
+}
+
+void UniValue::write(unsigned int prettyIndent, unsigned int indentLevel, string& s) const
+{
     unsigned int modIndent = indentLevel;
     if (modIndent == 0)
         modIndent = 1;
@@ -49,7 +61,9 @@ string UniValue::write(unsigned int prettyIndent,
         writeArray(prettyIndent, modIndent, s);
         break;
     case VSTR:
-        s += "\"" + json_escape(val) + "\"";
+        s += '"';
+        json_escape(val, s);
+        s += '"';
         break;
     case VNUM:
         s += val;
@@ -58,8 +72,6 @@ string UniValue::write(unsigned int prettyIndent,
         s += (val == "1" ? "true" : "false");
         break;
     }
-
-    return s;
 }
 
 static void indentStr(unsigned int prettyIndent, unsigned int indentLevel, string& s)
@@ -76,7 +88,7 @@ void UniValue::writeArray(unsigned int prettyIndent, unsigned int indentLevel, s
     for (unsigned int i = 0; i < values.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += values[i].write(prettyIndent, indentLevel + 1);
+        values[i].write(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1)) {
             s += ",";
         }
@@ -98,10 +110,12 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += "\"" + json_escape(keys[i]) + "\":";
+        s += '"';
+        json_escape(keys[i], s);
+        s += "\":";
         if (prettyIndent)
             s += " ";
-        s += values.at(i).write(prettyIndent, indentLevel + 1);
+        values.at(i).write(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1))
             s += ",";
         if (prettyIndent)
@@ -6,6 +6,7 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockfilemap.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -55,6 +56,11 @@
 #include <boost/thread.hpp>
 #include <aggregate_schnorr_signature.h>
 #include <encodings_crypto.h>
+#include <fasc/fascparallel.h>
+#include <fasc/fascpreexec.h>
+#include <fasc/fascprune.h>
+#include <fasc/fascsnapshot.h>
+#include <fasc/fascstateimport.h>
 
 #include <libethcore/ABI.h>
 #if defined(NDEBUG)
@@ -258,6 +264,8 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewDB *pcoinsdbview = nullptr;
+CCoinsViewBackgroundFlush *pcoinsflusher = nullptr;
+std::unique_ptr<CBlockFileMapPool> pblockfilemaps;
 CCoinsViewCache *pcoinsTip = nullptr;
 CBlockTreeDB *pblocktree = nullptr;
 StorageResults *pstorageresult = nullptr;
@@ -1464,14 +1472,22 @@ bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
+            std::shared_ptr<const CMappedFile> map = pblockfilemaps ? pblockfilemaps->Get(postx.nFile) : nullptr;
             CBlockHeader header;
             try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
+                if (map && postx.nPos < map->size()) {
+                    CSpanReader reader(SER_DISK, CLIENT_VERSION, map->data() + postx.nPos, map->size() - postx.nPos);
+                    reader >> header;
+                    reader.ignore(postx.nTxOffset);
+                    reader >> txOut;
+                } else {
+                    CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                    if (file.IsNull())
+                        return error("%s: OpenBlockFile failed", __func__);
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                }
             } catch (const std::exception& e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
@@ -1534,14 +1550,21 @@ bool ReadBlockFromDisk(Block& block, const CDiskBlockPos& pos, const Consensus::
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    // Finalized block files are deserialized in place from their mapping
+    std::shared_ptr<const CMappedFile> map = pblockfilemaps ? pblockfilemaps->Get(pos.nFile) : nullptr;
 
     // Read block
     try {
-        filein >> block;
+        if (map && pos.nPos < map->size()) {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, map->data() + pos.nPos, map->size() - pos.nPos);
+            reader >> block;
+        } else {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -1571,6 +1594,49 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+template <typename Stream>
+static void ReadRawBlock(Stream& s, std::vector<uint8_t>& block, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CMessageHeader::MessageStartChars blkStart;
+    unsigned int nSize;
+    s >> FLATDATA(blkStart) >> nSize;
+    if (memcmp(blkStart, messageStart, CMessageHeader::MESSAGE_START_SIZE))
+        throw std::ios_base::failure("block magic mismatch");
+    if (nSize > dgpMaxBlockSerSize)
+        throw std::ios_base::failure(strprintf("block size %u too large", nSize));
+    block.resize(nSize);
+    s.read((char*)block.data(), nSize);
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    // The magic and the size precede the block, as written by WriteBlockToDisk
+    if (pos.nPos < 8)
+        return error("ReadRawBlockFromDisk: no block header before %s", pos.ToString());
+    CDiskBlockPos hpos(pos.nFile, pos.nPos - 8);
+
+    std::shared_ptr<const CMappedFile> map = pblockfilemaps ? pblockfilemaps->Get(hpos.nFile) : nullptr;
+    try {
+        if (map && hpos.nPos < map->size()) {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, map->data() + hpos.nPos, map->size() - hpos.nPos);
+            ReadRawBlock(reader, block, messageStart);
+        } else {
+            CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadRawBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+            ReadRawBlock(filein, block, messageStart);
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Read error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    return ReadRawBlockFromDisk(block, pindex->GetBlockPos(), messageStart);
+}
+
 bool ReadFromDisk(CBlockHeader& block, unsigned int nFile, unsigned int nBlockPos)
 {
     return ReadBlockFromDisk(block, CDiskBlockPos(nFile, nBlockPos), Params().GetConsensus());
@@ -2208,8 +2274,10 @@ static DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex*
 
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
-    globalState->setRoot(uintToh256(pindex->pprev->hashStateRoot)); // fasc
-    globalState->setRootUTXO(uintToh256(pindex->pprev->hashUTXORoot)); // fasc
+    dev::h256 prevStateRoot, prevUTXORoot;
+    GetContractStateRoots(pindex->pprev, prevStateRoot, prevUTXORoot); // fasc
+    globalState->setRoot(prevStateRoot); // fasc
+    globalState->setRootUTXO(prevUTXORoot); // fasc
 
     if(pfClean == NULL && fLogEvents){
         pstorageresult->deleteResults(block.vtx);
@@ -2358,6 +2426,9 @@ struct SmartContractProcessor {
     int transactionIndex;
     dev::u256 gasUsed;
     std::vector<CTxOut> checkVouts;
+    ParallelContractExecution* parallelExec;
+    std::vector<TransactionReceiptInfo>* blockReceipts;
+    bool fSkipExecution;
     SmartContractProcessor() :
         block(nullptr), transaction(nullptr),
         state(nullptr), pindex(nullptr),
@@ -2369,7 +2440,10 @@ struct SmartContractProcessor {
         transactionFeeConsumed(0), transactionFeeAvailable(0),
         gasAllTxs(0), fNonZeroVersion(false),
         transactionIndex(- 1),
-        gasUsed(0)
+        gasUsed(0),
+        parallelExec(nullptr),
+        blockReceipts(nullptr),
+        fSkipExecution(false)
     {}
     bool ProcessSmartContract(std::stringstream* commentsOnFailure);
     bool PreprocessOneSmartContractResult(FascTransaction& qtx, std::stringstream* commentsOnFailure);
@@ -2477,6 +2551,7 @@ bool SmartContractProcessor::ProcessSmartContract(
         return this->state->DoS(100, error("ConnectBlock(): Contract execution has lower gas price than allowed"), REJECT_INVALID, "bad-tx-low-gas-price");
     }
     ByteCodeExec exec(*(this->block), resultConvertFascTX.first, *this->blockGasLimit);
+    exec.setParallelExecution(this->parallelExec);
     //validate VM version and other ETH params before execution
     //Reject anything unknown (could be changed later by DGP)
     //TODO evaluate if this should be relaxed for soft-fork purposes
@@ -2499,6 +2574,9 @@ bool SmartContractProcessor::ProcessSmartContract(
             return this->state->DoS(100, error("ConnectBlock(): Version 0 contract executions are not allowed unless created by the AAL "), REJECT_INVALID, "bad-tx-improper-version-0");
         }
     }
+    if (this->fSkipExecution) {
+        return true;
+    }
     if (!exec.performByteCode()) {
         if (commentsOnFailure != nullptr) {
             *commentsOnFailure << "Error during contract execution.\n";
@@ -2542,6 +2620,9 @@ bool SmartContractProcessor::ProcessSmartContract(
             });
         }
         pstorageresult->addResult(uintToh256(this->transaction->GetHash()), tri);
+        if (this->blockReceipts != nullptr) {
+            this->blockReceipts->insert(this->blockReceipts->end(), tri.begin(), tri.end());
+        }
     }
     *this->blockGasUsed += bcer.usedGas;
     if (*this->blockGasUsed > *this->blockGasLimit) {
@@ -2578,7 +2659,8 @@ bool SmartContractProcessor::ProcessSmartContract(
 static bool ConnectBlock(
     const CBlock& block, CValidationState& state, CBlockIndex* pindex,
     CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false,
-    std::stringstream* commentsOnFailure = nullptr
+    std::stringstream* commentsOnFailure = nullptr,
+    std::vector<TransactionReceiptInfo>* receiptsOut = nullptr
 ) {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2587,6 +2669,21 @@ static bool ConnectBlock(
            (*pindex->phashBlock == block.GetHash()));
     int64_t nTimeStart = GetTimeMicros();
     ///////////////////////////////////////////////// // fasc
+    // Contracts are not executed below an imported state (-assumevalidstate): connect on top of it instead.
+    bool fSkipContracts = pindex->phashBlock != nullptr && !fJustCheck && SkipContractExecution(pindex);
+    if (fSkipContracts) {
+        dev::h256 stateRoot, utxoRoot;
+        GetContractStateRoots(pindex, stateRoot, utxoRoot);
+        globalState->setRoot(stateRoot);
+        globalState->setRootUTXO(utxoRoot);
+    } else if (pindex->pprev != nullptr) {
+        dev::h256 prevStateRoot, prevUTXORoot;
+        GetContractStateRoots(pindex->pprev, prevStateRoot, prevUTXORoot);
+        if (prevStateRoot != uintToh256(pindex->pprev->hashStateRoot)) {
+            LogPrintf("%s: contract state of block %s is not available, it is below the imported state\n", __func__, pindex->pprev->GetBlockHash().ToString());
+            return state.Error("contract-state-unavailable");
+        }
+    }
     std::map<dev::Address, std::pair<CHeightTxIndexKey, std::vector<uint256> > > heightIndices;
     FascDGP fascDGP(globalState.get(), fGettingValuesDGP);
     dev::u256 minGasPrice = dev::u256(fascDGP.getMinGasPrice(pindex->nHeight + 1));
@@ -2736,6 +2833,12 @@ static bool ConnectBlock(
     dev::u256 gasRefunds(0);
     uint64_t nValueOut = 0;
     uint64_t nValueIn = 0;
+    std::unique_ptr<ParallelContractExecution> parallelExec;
+    if (fParallelContracts && nScriptCheckThreads && !fSkipContracts) {
+        parallelExec.reset(new ParallelContractExecution(block, blockGasLimit, q1_sch));
+        parallelExec->AddCandidates(view);
+        parallelExec->Run();
+    }
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction &tx = *(block.vtx[i]);
         nInputs += tx.vin.size();
@@ -2826,6 +2929,9 @@ static bool ConnectBlock(
         theProcessor.heightIndices = &heightIndices;
         theProcessor.fJustCheck = fJustCheck;
         theProcessor.transactionIndex = i;
+        theProcessor.parallelExec = parallelExec.get();
+        theProcessor.blockReceipts = receiptsOut;
+        theProcessor.fSkipExecution = fSkipContracts;
         if (!theProcessor.ProcessSmartContract(commentsOnFailure)) {
             if (commentsOnFailure != nullptr) {
                 *commentsOnFailure << "Failed to process smart contract.\n";
@@ -2878,7 +2984,7 @@ static bool ConnectBlock(
     checkBlock.hashUTXORoot = h256Touint(globalState->rootHashUTXO());
 
     //If this error happens, it probably means that something with AAL created transactions didn't match up to what is expected
-    if ((checkBlock.GetHash() != block.GetHash()) && !fJustCheck)
+    if ((checkBlock.GetHash() != block.GetHash()) && !fJustCheck && !fSkipContracts)
     {
         LogPrintf("Actual block data does not match block expected by AAL\n");
 
@@ -2998,6 +3104,60 @@ static bool ConnectBlock(
 
     if (fLogEvents)
         pstorageresult->commitResults();
+
+    if (pstateSnapshot && !fSkipContracts) {
+        dev::h256 baseStateRoot;
+        dev::eth::StateDiff diff = globalState->takeFlatDiff(baseStateRoot);
+        pstateSnapshot->AddLayer(baseStateRoot, globalState->rootHash(), std::move(diff));
+        pstateSnapshot->Cap(globalState->rootHash(), STATE_SNAPSHOT_LAYERS);
+    } else if (pstateSnapshot && uintToh256(block.hashStateRoot) == globalState->rootHash() && pstateSnapshot->DiskRoot() != globalState->rootHash()) {
+        // The imported state is reached: the snapshot continues from it.
+        pstateSnapshot->Regenerate(globalState->rootHash());
+    }
+    return true;
+}
+
+/**
+ * Sync the contract state and receipt databases, which are written as blocks are connected,
+ * and mark them with the block the chainstate is about to be flushed at: they are never
+ * behind the chainstate after a crash, even one during a write in the background.
+ */
+static bool WriteContractFlushMarkers(const uint256& hashBlock)
+{
+    if (!globalState || !pstorageresult)
+        return true;
+    return writeFlushedBlock(globalState->db().db(), hashBlock) &&
+        writeFlushedBlock(globalState->dbUtxo().db(), hashBlock) &&
+        pstorageresult->writeFlushedBlock(hashBlock);
+}
+
+bool CheckContractFlushMarkers(std::string& strError)
+{
+    LOCK(cs_main);
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    if (!pindexTip)
+        return true;
+    std::vector<std::pair<std::string, uint256> > vFlushed;
+    uint256 hashFlushed;
+    // Databases written before the markers have none.
+    if (readFlushedBlock(globalState->db().db(), hashFlushed))
+        vFlushed.emplace_back("contract state", hashFlushed);
+    if (readFlushedBlock(globalState->dbUtxo().db(), hashFlushed))
+        vFlushed.emplace_back("contract UTXO", hashFlushed);
+    if (pstorageresult->readFlushedBlock(hashFlushed))
+        vFlushed.emplace_back("receipt", hashFlushed);
+    for (const auto& flushed : vFlushed) {
+        BlockMap::const_iterator it = mapBlockIndex.find(flushed.second);
+        if (it == mapBlockIndex.end()) {
+            LogPrintf("%s: the %s database was synced at unknown block %s\n", __func__, flushed.first, flushed.second.ToString());
+            continue;
+        }
+        const CBlockIndex* pindexFlushed = it->second;
+        if (pindexFlushed != pindexTip && pindexTip->GetAncestor(pindexFlushed->nHeight) == pindexFlushed) {
+            strError = strprintf("The %s database was synced at height %d, below the chainstate's %d", flushed.first, pindexFlushed->nHeight, pindexTip->nHeight);
+            return false;
+        }
+    }
     return true;
 }
 
@@ -3046,17 +3206,22 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         if (nLastSetChain == 0) {
             nLastSetChain = nNow;
         }
+        if (pcoinsflusher && pcoinsflusher->Failed())
+            return AbortNode(state, "Failed to write to coin database");
+        // Coins being written in the background take memory until the write completes.
+        bool fFlushing = pcoinsflusher && pcoinsflusher->IsWriting();
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+        int64_t cacheSize = (pcoinsTip->DynamicMemoryUsage() + (pcoinsflusher ? pcoinsflusher->DynamicMemoryUsage() : 0)) * DB_PEAK_USAGE_FACTOR;
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
-        bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
+        // Written in the background, the cache is taken at half of the space, and fills up again while it is written.
+        bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && !fFlushing && cacheSize > (pcoinsflusher ? nTotalSpace / 2 : std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024));
         // The cache is over the limit, we have to write now.
         bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nTotalSpace;
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
         bool fPeriodicWrite = mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
-        bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
+        bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && !fFlushing && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
         fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
         // Write blocks and block index to disk.
@@ -3098,9 +3263,15 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
+            if (!WriteContractFlushMarkers(pcoinsTip->GetBestBlock()))
+                return AbortNode(state, "Failed to write to contract database");
             // Flush the chainstate (which may refer to block index entries).
+            // With -backgroundflush, the coins are written while validation continues, unless
+            // they have to be on disk on return, or before block files are pruned.
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            if (pcoinsflusher && (mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && !pcoinsflusher->Wait())
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
     }
@@ -3874,11 +4045,41 @@ void LastHashes::clear()
 
 bool ByteCodeExec::performByteCode(dev::eth::Permanence type, std::stringstream* commentsNullForNone)
 {
+    std::unique_ptr<ContractExecutionRecorder> recorder;
+    std::stringstream comments;
+    OnOpFunc onOp;
+    if (type == dev::eth::Permanence::Committed && (pcontractPreExecutor || parallelExec) && !txs.empty() &&
+        chainActive.Height() >= Params().ContractReuseHeight()) {
+        if (parallelExec && parallelExec->Apply(txs, result, commentsNullForNone)) {
+            return true;
+        }
+        dev::eth::EnvInfo envInfo(BuildEVMEnvironment());
+        if (pcontractPreExecutor) {
+            std::shared_ptr<const ContractExecutionRecord> reused = pcontractPreExecutor->Reuse(txs, envInfo);
+            if (reused) {
+                // Copied then moved, since a ResultExecute holds a CTransaction and cannot be assigned
+                result = std::vector<ResultExecute>(reused->results);
+                if (commentsNullForNone != nullptr) {
+                    *commentsNullForNone << reused->comments;
+                }
+                globalState->setRoot(reused->postStateRoot);
+                globalState->setRootUTXO(reused->postUTXORoot);
+                if (parallelExec) {
+                    parallelExec->NoteExecuted(reused->access);
+                }
+                return true;
+            }
+        }
+        recorder.reset(new ContractExecutionRecorder(*globalState, txs, envInfo, chainActive.Tip()->GetBlockHash()));
+        if (pcontractPreExecutor) {
+            onOp = recorder->Tracer();
+        }
+    }
     for (FascTransaction& tx : txs) {
         //validate VM version
         if (tx.getVersion().toRaw() != VersionVM::GetEVMDefault().toRaw()) {
             if (commentsNullForNone != nullptr) {
-                *commentsNullForNone << "Bad EVM version: " << tx.getVersion().toRaw() << "\n";
+                *commentsNullForNone << comments.str() << "Bad EVM version: " << tx.getVersion().toRaw() << "\n";
             }
             return false;
         }
@@ -3889,11 +4090,24 @@ bool ByteCodeExec::performByteCode(dev::eth::Permanence type, std::stringstream*
             result.push_back(ResultExecute{execRes, FascTransactionReceipt(dev::h256(), dev::u256(), dev::u256(), dev::eth::LogEntries()), CTransaction()});
             continue;
         }
-        result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, OnOpFunc(), commentsNullForNone));
+        result.push_back(globalState->execute(envInfo, *globalSealEngine.get(), tx, type, onOp, recorder ? &comments : commentsNullForNone));
     }
     globalState->db().commit();
     globalState->dbUtxo().commit();
     globalSealEngine.get()->deleteAddresses.clear();
+    if (recorder) {
+        // Recorded for the reuse path, which writes them the same way.
+        if (commentsNullForNone != nullptr) {
+            *commentsNullForNone << comments.str();
+        }
+        std::shared_ptr<ContractExecutionRecord> record = recorder->Finish(result, comments.str());
+        if (parallelExec) {
+            parallelExec->NoteExecuted(record->access);
+        }
+        if (pcontractPreExecutor) {
+            pcontractPreExecutor->Record(record);
+        }
+    }
     return true;
 }
 
@@ -4142,6 +4356,7 @@ struct PerBlockConnectTrace {
     CBlockIndex* pindex = nullptr;
     std::shared_ptr<const CBlock> pblock;
     std::shared_ptr<std::vector<CTransactionRef>> conflictedTxs;
+    std::shared_ptr<std::vector<TransactionReceiptInfo>> receipts; // fasc
     PerBlockConnectTrace() : conflictedTxs(std::make_shared<std::vector<CTransactionRef>>()) {}
 };
 /**
@@ -4174,12 +4389,13 @@ public:
         pool.NotifyEntryRemoved.disconnect(boost::bind(&ConnectTrace::NotifyEntryRemoved, this, ph::_1, ph::_2));
     }
 
-    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock) {
+    void BlockConnected(CBlockIndex* pindex, std::shared_ptr<const CBlock> pblock, std::shared_ptr<std::vector<TransactionReceiptInfo>> receipts) {
         assert(!blocksConnected.back().pindex);
         assert(pindex);
         assert(pblock);
         blocksConnected.back().pindex = pindex;
         blocksConnected.back().pblock = std::move(pblock);
+        blocksConnected.back().receipts = std::move(receipts);
         blocksConnected.emplace_back();
     }
 
@@ -4228,11 +4444,12 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    std::shared_ptr<std::vector<TransactionReceiptInfo>> receipts = std::make_shared<std::vector<TransactionReceiptInfo>>(); // fasc
     {
         CCoinsViewCache view(pcoinsTip);
         dev::h256 oldHashStateRoot(globalState->rootHash()); // fasc 
         dev::h256 oldHashUTXORoot(globalState->rootHashUTXO()); // fasc
-        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
+        bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams, false, nullptr, receipts.get());
         GetMainSignals().BlockChecked(blockConnecting, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -4264,7 +4481,7 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
 
-    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
+    connectTrace.BlockConnected(pindexNew, std::move(pthisBlock), std::move(receipts));
     return true;
 }
 
@@ -4342,12 +4559,30 @@ static void PruneBlockIndexCandidates() {
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either nullptr or a pointer to a CBlock corresponding to pindexMostWork.
  */
+bool CanRewindContractState(const CBlockIndex* pindexFork)
+{
+    AssertLockHeld(cs_main);
+    if (!nPruneStateDepth || !pindexFork)
+        return true;
+    // Collections keep the roots of the nPruneStateDepth blocks below the tip they ran at, and
+    // everything written since.
+    int nKeptHeight = std::max(chainActive.Height(), pstatePruner ? pstatePruner->LastCollectedHeight() : 0);
+    return pindexFork->nHeight >= nKeptHeight - (int)nPruneStateDepth;
+}
+
 static bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace)
 {
     AssertLockHeld(cs_main);
     const CBlockIndex *pindexOldTip = chainActive.Tip();
     const CBlockIndex *pindexFork = chainActive.FindFork(pindexMostWork);
 
+    // Check before disconnecting anything: a rewind that reaches pruned state can't be completed.
+    if (!CanRewindContractState(pindexFork)) {
+        return AbortNode(state, strprintf("Reorganization to %s forks off at height %d, deeper than the %u blocks of contract state kept by -prunestate",
+                                          pindexMostWork->GetBlockHash().ToString(), pindexFork->nHeight, nPruneStateDepth),
+                         _("Error: A chain reorganization is deeper than the contract state kept by -prunestate. Restart with -reindex-chainstate."));
+    }
+
     // Disconnect active blocks which are no longer in the best chain.
     bool fBlocksDisconnected = false;
     DisconnectedBlockTransactions disconnectpool;
@@ -4463,6 +4698,8 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
         if (ShutdownRequested())
             break;
 
+        ImportTrustedContractState();
+
         const CBlockIndex *pindexFork;
         bool fInitialDownload;
         {
@@ -4494,6 +4731,9 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
             for (const PerBlockConnectTrace& trace : connectTrace.GetBlocksConnected()) {
                 assert(trace.pblock && trace.pindex);
                 GetMainSignals().BlockConnected(trace.pblock, trace.pindex, *trace.conflictedTxs);
+                if (!trace.receipts->empty()) {
+                    GetMainSignals().ContractReceiptsConnected(trace.pindex, *trace.receipts);
+                }
             }
         }
         // When we reach this point, we switched to a new tip (stored in pindexNewTip).
@@ -4554,6 +4794,9 @@ bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, C
 {
     AssertLockHeld(cs_main);
 
+    if (chainActive.Contains(pindex) && !CanRewindContractState(pindex->pprev))
+        return state.Error(strprintf("the contract state below height %d was deleted by -prunestate", chainActive.Height() - (int)nPruneStateDepth));
+
     // We first disconnect backwards and then mark the blocks as invalid.
     // This prevents a case where pruned nodes may fail to invalidateblock
     // and be left unable to start as they have no tip candidates (as there
@@ -4764,6 +5007,8 @@ static bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned i
         }
         FlushBlockFile(!fKnown);
         nLastBlockFile = nFile;
+        if (pblockfilemaps)
+            pblockfilemaps->SetLastBlockFile(nLastBlockFile);
     }
 
     vinfoBlockFile[nFile].AddBlock(nHeight, nTime);
@@ -5465,6 +5710,8 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        if (pblockfilemaps)
+            pblockfilemaps->Drop(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -5682,6 +5929,8 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
+    if (pblockfilemaps)
+        pblockfilemaps->SetLastBlockFile(nLastBlockFile);
     vinfoBlockFile.resize(nLastBlockFile + 1);
     LogPrintf("%s: last block file = %i\n", __func__, nLastBlockFile);
     for (int nFile = 0; nFile <= nLastBlockFile; nFile++) {
@@ -6009,6 +6258,9 @@ bool RewindBlockIndex(const CChainParams& params)
     // nHeight is now the height of the first insufficiently-validated block, or tipheight + 1
     CValidationState state;
     CBlockIndex* pindex = chainActive.Tip();
+    if (nHeight <= chainActive.Height() && !CanRewindContractState(chainActive[nHeight - 1])) {
+        return error("RewindBlockIndex: the contract state below height %i was deleted by -prunestate", chainActive.Height() - (int)nPruneStateDepth);
+    }
     while (chainActive.Height() >= nHeight) {
         if (fPruneMode && !(chainActive.Tip()->nStatus & BLOCK_HAVE_DATA)) {
             // If pruning, don't try rewinding past the HAVE_DATA point;
@@ -6099,6 +6351,8 @@ void UnloadBlockIndex()
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
+    if (pblockfilemaps)
+        pblockfilemaps->SetLastBlockFile(0);
     nBlockSequenceId = 1;
     setDirtyBlockIndex.clear();
     g_failed_blocks.clear();
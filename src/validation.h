@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -48,10 +49,12 @@ extern bool fGettingValuesDGP;
 struct EthTransactionParams;
 using valtype = std::vector<unsigned char>;
 using ExtractFascTX = std::pair<std::vector<FascTransaction>, std::vector<EthTransactionParams> >;
+class CBlockFileMapPool;
 class CBlockIndex;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewBackgroundFlush;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
@@ -598,6 +601,9 @@ void InitScriptExecutionCache();
 template <typename Block>
 bool ReadBlockFromDisk(Block& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized block as stored, which is its network serialization with witnesses, after checking the magic and size that precede it */
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadFromDisk(CBlockHeader& block, unsigned int nFile, unsigned int nBlockPos);
 bool ReadFromDisk(CMutableTransaction& tx, CDiskTxPos& txindex, CBlockTreeDB& txdb, COutPoint prevout);
 
@@ -641,12 +647,18 @@ public:
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
+/** Check that the contract databases were synced at least up to the chainstate's block before the last shutdown or crash. */
+bool CheckContractFlushMarkers(std::string& strError);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
 /** Mark a block as precious and reorganize. */
 bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIndex *pindex);
 
+/** Whether the chain can be rewound to pindexFork without reaching contract state deleted by -prunestate. */
+bool CanRewindContractState(const CBlockIndex* pindexFork);
+
 /** Mark a block as invalid. */
 bool InvalidateBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex);
 
@@ -659,6 +671,12 @@ extern CChain chainActive;
 /** Global variable that points to the coins database (protected by cs_main) */
 extern CCoinsViewDB *pcoinsdbview;
 
+/** Global variable that points to the layer writing the coins in the background, if -backgroundflush (protected by cs_main) */
+extern CCoinsViewBackgroundFlush *pcoinsflusher;
+
+/** Read-only mappings of the finalized block files that ReadBlockFromDisk reads from, if -blockmapfiles is not 0 */
+extern std::unique_ptr<CBlockFileMapPool> pblockfilemaps;
+
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
@@ -799,11 +817,13 @@ private:
     dev::h256s m_lastHashes;
 };
 
+class ParallelContractExecution;
+
 class ByteCodeExec {
 
 public:
 
-    ByteCodeExec(const CBlock& _block, std::vector<FascTransaction> _txs, const dev::u256& _blockGasLimit) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit) {}
+    ByteCodeExec(const CBlock& _block, std::vector<FascTransaction> _txs, const dev::u256& _blockGasLimit) : txs(_txs), block(_block), blockGasLimit(_blockGasLimit), parallelExec(nullptr) {}
 
     bool performByteCode(dev::eth::Permanence type = dev::eth::Permanence::Committed, std::stringstream* commentsNullForNone = nullptr);
 
@@ -812,10 +832,13 @@ public:
 
     std::vector<ResultExecute>& getResult(){ return result; }
 
-private:
+    /** Take the results from an ahead-of-time parallel execution of the block when possible. */
+    void setParallelExecution(ParallelContractExecution* _parallelExec){ parallelExec = _parallelExec; }
 
     dev::eth::EnvInfo BuildEVMEnvironment();
 
+private:
+
     dev::Address EthAddrFromScript(const CScript& scriptIn);
 
     std::vector<FascTransaction> txs;
@@ -827,6 +850,8 @@ private:
     const uint64_t blockGasLimit;
 
     LastHashes lastHashes;
+
+    ParallelContractExecution* parallelExec;
 };
 ////////////////////////////////////////////////////////
 #endif // FABCOIN_VALIDATION_H
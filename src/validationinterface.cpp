@@ -21,6 +21,7 @@ struct MainSignalsInstance {
     boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
     boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
     boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
+    boost::signals2::signal<void (const CBlockIndex *, const std::vector<TransactionReceiptInfo> &)> ContractReceiptsConnected;
     boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
     boost::signals2::signal<void (const uint256 &)> Inventory;
     boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
@@ -64,6 +65,7 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, ph::_1));
     g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, ph::_1, ph::_2, ph::_3));
     g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, ph::_1));
+    g_signals.m_internals->ContractReceiptsConnected.connect(boost::bind(&CValidationInterface::ContractReceiptsConnected, pwalletIn, ph::_1, ph::_2));
     g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, ph::_1));
     g_signals.m_internals->Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, ph::_1));
     g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, ph::_1, ph::_2));
@@ -83,6 +85,7 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, ph::_1));
     g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, ph::_1, ph::_2, ph::_3));
     g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, ph::_1));
+    g_signals.m_internals->ContractReceiptsConnected.disconnect(boost::bind(&CValidationInterface::ContractReceiptsConnected, pwalletIn, ph::_1, ph::_2));
     g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, ph::_1, ph::_2, ph::_3));
     g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, ph::_1, ph::_2));
 }
@@ -97,6 +100,7 @@ void UnregisterAllValidationInterfaces() {
     g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
     g_signals.m_internals->BlockConnected.disconnect_all_slots();
     g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
+    g_signals.m_internals->ContractReceiptsConnected.disconnect_all_slots();
     g_signals.m_internals->UpdatedBlockTip.disconnect_all_slots();
     g_signals.m_internals->NewPoWValidBlock.disconnect_all_slots();
 }
@@ -117,6 +121,10 @@ void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock
     m_internals->BlockDisconnected(pblock);
 }
 
+void CMainSignals::ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts) {
+    m_internals->ContractReceiptsConnected(pindex, receipts);
+}
+
 void CMainSignals::SetBestChain(const CBlockLocator &locator) {
     m_internals->SetBestChain(locator);
 }
@@ -21,6 +21,7 @@ class CValidationInterface;
 class CValidationState;
 class uint256;
 class CScheduler;
+struct TransactionReceiptInfo;
 
 // These functions dispatch to one or all registered wallets
 
@@ -44,6 +45,11 @@ protected:
     virtual void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) {}
     /** Notifies listeners of a block being disconnected */
     virtual void BlockDisconnected(const std::shared_ptr<const CBlock> &block) {}
+    /**
+     * Notifies listeners of the contract receipts of a block connected to the active chain,
+     * in block order, once they have been committed. Only sent when -logevents is set.
+     */
+    virtual void ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlockIndex *pindex, int posInBlock) {}
     virtual void UpdatedTransaction(const uint256 &hash) {}
     /** Notifies listeners of the new active block chain on-disk. */
@@ -94,6 +100,7 @@ public:
     void TransactionAddedToMempool(const CTransactionRef &);
     void BlockConnected(const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef> &);
     void BlockDisconnected(const std::shared_ptr<const CBlock> &);
+    void ContractReceiptsConnected(const CBlockIndex *, const std::vector<TransactionReceiptInfo> &);
     void SetBestChain(const CBlockLocator &);
     void Inventory(const uint256 &);
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
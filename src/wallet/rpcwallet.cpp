@@ -2092,6 +2092,15 @@ void AcentryToJSON(const CAccountingEntry& acentry, const std::string& strAccoun
     }
 }
 
+/** The entries of a wallet transaction or accounting entry, as listed by listtransactions */
+static void ListTxItem(CWallet* const pwallet, const CWallet::TxPair& item, const std::string& strAccount, const isminefilter& filter, UniValue& ret)
+{
+    if (item.first)
+        ListTransactions(pwallet, *item.first, strAccount, 0, true, ret, filter);
+    if (item.second)
+        AcentryToJSON(*item.second, strAccount, ret);
+}
+
 UniValue listtransactions(const JSONRPCRequest& request)
 {
     CWallet* const pwallet = GetWalletForJSONRPCRequest(request);
@@ -2179,45 +2188,40 @@ UniValue listtransactions(const JSONRPCRequest& request)
     if (nFrom < 0)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
-    UniValue ret(UniValue::VARR);
-
     const CWallet::TxItems& txOrdered = pwallet->wtxOrdered;
 
-    // iterate backwards until we have nCount items to return:
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it) {
-        CWalletTx* const pwtx = (*it).second.first;
-        if (pwtx != 0)
-            ListTransactions(pwallet, *pwtx, strAccount, 0, true, ret, filter);
-        CAccountingEntry* const pacentry = (*it).second.second;
-        if (pacentry != 0)
-            AcentryToJSON(*pacentry, strAccount, ret);
-
-        if ((int)ret.size() >= (nCount + nFrom)) break;
+    // The entries are numbered from the newest; only the window [nFrom, nFrom + nCount) is returned.
+    // Find the items it spans first, then build their entries again, one item at a time, as they
+    // are written from oldest to newest: the entries are never all held at once.
+    struct ItemEntries {
+        CWallet::TxItems::const_reverse_iterator it;
+        int nFirst;
+        int nCount;
+    };
+    std::vector<ItemEntries> vItems;
+    int nEntries = 0;
+    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend() && nEntries < nFrom + nCount; ++it) {
+        UniValue entries(UniValue::VARR);
+        ListTxItem(pwallet, it->second, strAccount, filter, entries);
+        if (entries.size() && nEntries + (int)entries.size() > nFrom)
+            vItems.push_back({it, nEntries, (int)entries.size()});
+        nEntries += entries.size();
+    }
+
+    // Return oldest to newest
+    JSONStreamWriter writer(request);
+    writer.BeginArray();
+    for (auto item = vItems.rbegin(); item != vItems.rend(); ++item) {
+        UniValue entries(UniValue::VARR);
+        ListTxItem(pwallet, item->it->second, strAccount, filter, entries);
+        for (int i = item->nCount - 1; i >= 0; i--) {
+            int nEntry = item->nFirst + i;
+            if (nEntry >= nFrom && nEntry < nFrom + nCount)
+                writer.Value(entries[i]);
+        }
     }
-    // ret is newest to oldest
-
-    if (nFrom > (int)ret.size())
-        nFrom = ret.size();
-    if ((nFrom + nCount) > (int)ret.size())
-        nCount = ret.size() - nFrom;
-
-    std::vector<UniValue> arrTmp = ret.getValues();
-
-    std::vector<UniValue>::iterator first = arrTmp.begin();
-    std::advance(first, nFrom);
-    std::vector<UniValue>::iterator last = arrTmp.begin();
-    std::advance(last, nFrom + nCount);
-
-    if (last != arrTmp.end()) arrTmp.erase(last, arrTmp.end());
-    if (first != arrTmp.begin()) arrTmp.erase(arrTmp.begin(), first);
-
-    std::reverse(arrTmp.begin(), arrTmp.end()); // Return oldest to newest
-
-    ret.clear();
-    ret.setArray();
-    ret.push_backV(arrTmp);
-
-    return ret;
+    writer.End();
+    return writer.Finish();
 }
 
 UniValue listaccounts(const JSONRPCRequest& request)
@@ -20,3 +20,8 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyReceipts(const CBlockIndex * /*CBlockIndex*/, const std::vector<TransactionReceiptInfo> &/*receipts*/)
+{
+    return true;
+}
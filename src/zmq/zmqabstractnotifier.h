@@ -7,8 +7,11 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <vector>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+struct TransactionReceiptInfo;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
@@ -34,6 +37,7 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    virtual bool NotifyReceipts(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts);
 
 protected:
     void *psocket;
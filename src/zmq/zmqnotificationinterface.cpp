@@ -39,6 +39,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubreceipt"] = CZMQAbstractNotifier::Create<CZMQPublishReceiptNotifier>;
+    factories["pubcontractlog"] = CZMQAbstractNotifier::Create<CZMQPublishContractLogNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -180,3 +182,20 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
         TransactionAddedToMempool(ptx);
     }
 }
+
+void CZMQNotificationInterface::ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyReceipts(pindex, receipts))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
@@ -29,6 +29,7 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void ContractReceiptsConnected(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts) override;
 
 private:
     CZMQNotificationInterface();
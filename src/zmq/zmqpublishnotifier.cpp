@@ -16,6 +16,8 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_RECEIPT     = "receipt";
+static const char *MSG_CONTRACTLOG = "contractlog";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -195,3 +197,57 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+template <unsigned N>
+static void WriteFixedHash(CDataStream& ss, const dev::FixedHash<N>& hash)
+{
+    ss.write((const char*)hash.data(), N);
+}
+
+static void WriteLogEntry(CDataStream& ss, const dev::eth::LogEntry& log)
+{
+    WriteFixedHash(ss, log.address);
+    WriteCompactSize(ss, log.topics.size());
+    for (const dev::h256& topic : log.topics)
+        WriteFixedHash(ss, topic);
+    ss << log.data;
+}
+
+bool CZMQPublishReceiptNotifier::NotifyReceipts(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish %u receipts of block %s\n", (unsigned) receipts.size(), pindex->GetBlockHash().GetHex());
+    for (const TransactionReceiptInfo& receipt : receipts)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << receipt.blockHash << receipt.blockNumber << receipt.transactionHash << receipt.transactionIndex << receipt.outputIndex;
+        WriteFixedHash(ss, receipt.from);
+        WriteFixedHash(ss, receipt.to);
+        WriteFixedHash(ss, receipt.contractAddress);
+        ss << receipt.cumulativeGasUsed << receipt.gasUsed << uint32_t(receipt.excepted);
+        WriteFixedHash(ss, receipt.stateRoot);
+        WriteFixedHash(ss, receipt.utxoRoot);
+        WriteCompactSize(ss, receipt.logs.size());
+        for (const dev::eth::LogEntry& log : receipt.logs)
+            WriteLogEntry(ss, log);
+        if (!SendMessage(MSG_RECEIPT, &(*ss.begin()), ss.size()))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishContractLogNotifier::NotifyReceipts(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish contract logs of block %s\n", pindex->GetBlockHash().GetHex());
+    for (const TransactionReceiptInfo& receipt : receipts)
+    {
+        for (uint32_t i = 0; i < receipt.logs.size(); i++)
+        {
+            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << receipt.blockHash << receipt.blockNumber << receipt.transactionHash << receipt.outputIndex << i;
+            WriteLogEntry(ss, receipt.logs[i]);
+            if (!SendMessage(MSG_CONTRACTLOG, &(*ss.begin()), ss.size()))
+                return false;
+        }
+    }
+    return true;
+}
@@ -52,4 +52,18 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+/* One message per contract execution receipt; see doc/zmq.md for the body layout. */
+class CZMQPublishReceiptNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyReceipts(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts) override;
+};
+
+/* One message per contract event log entry; see doc/zmq.md for the body layout. */
+class CZMQPublishContractLogNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyReceipts(const CBlockIndex *pindex, const std::vector<TransactionReceiptInfo> &receipts) override;
+};
+
 #endif // FABCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
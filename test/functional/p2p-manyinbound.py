@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 FA Enterprise system
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the epoll socket handler with more inbound connections than select() can handle.
+
+- Start a node with -socketevents=epoll and a -maxconnections above FD_SETSIZE (1024)
+- Connect a mininode peer and complete the handshake
+- Open INBOUND_CONNECTIONS plain TCP connections that never send anything
+- Check the node accepted all of them and still answers the mininode peer
+- Close them and check the node notices the hang ups
+"""
+
+import resource
+import socket
+import sys
+
+from test_framework.mininode import *
+from test_framework.test_framework import FabcoinTestFramework, SkipTest
+from test_framework.util import *
+
+INBOUND_CONNECTIONS = 2000
+
+class ManyInboundTest(FabcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-socketevents=epoll", "-maxconnections=3000"]]
+
+    def setup_network(self):
+        if not sys.platform.startswith('linux'):
+            raise SkipTest("epoll is only available on linux.")
+        # Room for the test's own ends of the connections
+        soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+        if hard != resource.RLIM_INFINITY and hard < INBOUND_CONNECTIONS + 1000:
+            raise SkipTest("RLIMIT_NOFILE hard limit %d is too low." % hard)
+        resource.setrlimit(resource.RLIMIT_NOFILE, (max(soft, INBOUND_CONNECTIONS + 1000), hard))
+        super().setup_network()
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        # The mininode peer is connected first: asyncore select()s on its socket
+        peer = NodeConnCB()
+        peer.add_connection(NodeConn('127.0.0.1', p2p_port(0), node, peer))
+        NetworkThread().start()
+        peer.wait_for_verack()
+
+        self.log.info("Open %d inbound connections" % INBOUND_CONNECTIONS)
+        sockets = []
+        for _ in range(INBOUND_CONNECTIONS):
+            s = socket.create_connection(('127.0.0.1', p2p_port(0)))
+            sockets.append(s)
+        wait_until(lambda: node.getconnectioncount() == INBOUND_CONNECTIONS + 1, timeout=60)
+
+        # The peer connected before them is still served
+        peer.sync_with_ping()
+        assert_equal(len(node.getpeerinfo()), INBOUND_CONNECTIONS + 1)
+
+        self.log.info("Close them")
+        for s in sockets:
+            s.close()
+        wait_until(lambda: node.getconnectioncount() == 1, timeout=60)
+        peer.sync_with_ping()
+
+if __name__ == '__main__':
+    ManyInboundTest().main()
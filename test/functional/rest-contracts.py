@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 FA Enterprise system
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the contract endpoints of the REST API.
+
+/rest/receipt, /rest/logs, /rest/account and /rest/storage must give the same
+data as gettransactionreceipt, searchlogs, getaccountinfo and getstorage, the
+hex format must be the binary one encoded, and invalid requests must be
+rejected, including /rest/logs ranges of more than MAX_LOGS_BLOCKS blocks.
+"""
+
+from test_framework.test_framework import FabcoinTestFramework
+from test_framework.fabcoinconfig import COINBASE_MATURITY
+from test_framework.util import *
+
+from decimal import Decimal
+import binascii
+import http.client
+import json
+import urllib.parse
+
+MAX_LOGS_BLOCKS = 2000
+MAX_STORAGE_ENTRIES = 10000
+
+# Stores 13 in slot 0 when created; 5b9af12b emits two logs with LOG_TOPIC.
+CONTRACT_CODE = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+LOG_TOPIC = "c5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f2"
+OTHER_TOPIC = "35c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f2"
+
+class RESTContractsTest(FabcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+        self.extra_args = [["-logevents"]]
+
+    def get(self, path, status=200):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', path)
+        response = conn.getresponse()
+        assert_equal(response.status, status)
+        return response.read()
+
+    def get_json(self, path):
+        path, sep, query = path.partition('?')
+        return json.loads(self.get(path + '.json' + sep + query).decode('utf-8'), parse_float=Decimal)
+
+    def check_hex(self, path):
+        binary = self.get(path + '.bin')
+        assert_equal(self.get(path + '.hex').decode('utf-8').strip(), binascii.hexlify(binary).decode('utf-8'))
+        return binary
+
+    def run_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 100)
+        contract = node.createcontract(CONTRACT_CODE)['address']
+        node.generate(1)
+        txid = node.sendtocontract(contract, "5b9af12b")['txid']
+        node.generate(1)
+        height = node.getblockcount()
+
+        self.log.info("Receipts")
+        assert_equal(self.get_json('/rest/receipt/' + txid), node.gettransactionreceipt(txid))
+        assert(len(self.check_hex('/rest/receipt/' + txid)) > 0)
+        self.get('/rest/receipt/' + '00' * 32 + '.json', 404)
+        self.get('/rest/receipt/' + txid[:10] + '.json', 400)
+
+        self.log.info("Logs")
+        logs = self.get_json('/rest/logs/%d/%d' % (height, height))
+        assert_equal(len(logs), 1)
+        assert_equal(logs, node.searchlogs(height, height))
+        assert_equal(self.get_json('/rest/logs/%d/latest?addresses=%s&topics=%s' % (height - 1, contract, LOG_TOPIC)),
+                     node.searchlogs(height - 1, height, {"addresses": [contract]}, {"topics": [LOG_TOPIC]}))
+        assert_equal(self.get_json('/rest/logs/%d/latest?topics=%s' % (height, OTHER_TOPIC)), [])
+        assert_equal(self.get_json('/rest/logs/%d/latest?minconf=1' % height), [])
+        node.generate(1)
+        assert_equal(self.get_json('/rest/logs/%d/latest?minconf=1' % height), logs)
+        self.check_hex('/rest/logs/%d/%d' % (height, height))
+
+        self.get('/rest/logs/%d.json' % height, 400)
+        self.get('/rest/logs/%d/%d.json' % (height, height - 1), 400)
+        self.get('/rest/logs/%d/latest.json?addresses=%s' % (height, contract[:10]), 400)
+        self.get('/rest/logs/%d/latest.json?topics=%s' % (height, LOG_TOPIC[:10]), 400)
+        self.get('/rest/logs/%d/latest.json?minconf=-1' % height, 400)
+
+        # The range is bounded whatever the height of the tip; the last allowed block may be beyond it.
+        self.get_json('/rest/logs/%d/%d' % (height, height + MAX_LOGS_BLOCKS - 1))
+        self.get('/rest/logs/%d/%d.json' % (height, height + MAX_LOGS_BLOCKS), 400)
+        self.get('/rest/logs/0/%d.json' % MAX_LOGS_BLOCKS, 400)
+
+        self.log.info("Accounts")
+        account = self.get_json('/rest/account/' + contract)
+        info = node.getaccountinfo(contract)
+        assert_equal(account['address'], contract)
+        assert_equal(account['nonce'], 0)
+        assert_equal(account['balance'], info['balance'])
+        assert_equal(account['code'], info['code'])
+        assert(len(self.check_hex('/rest/account/' + contract)) > 0)
+        self.get('/rest/account/' + '00' * 20 + '.json', 404)
+        self.get('/rest/account/' + contract[:10] + '.json', 400)
+
+        self.log.info("Storage")
+        storage = self.get_json('/rest/storage/' + contract)
+        assert_equal(storage['storage'], node.getstorage(contract))
+        assert('next' not in storage)
+        assert_equal(len(storage['storage']), 1)
+        assert_equal(self.get_json('/rest/storage/%s?limit=1' % contract), storage)
+        self.check_hex('/rest/storage/' + contract)
+        self.get('/rest/storage/%s.json?limit=0' % contract, 400)
+        self.get('/rest/storage/%s.json?limit=%d' % (contract, MAX_STORAGE_ENTRIES + 1), 400)
+        self.get('/rest/storage/%s.json?start=%s' % (contract, LOG_TOPIC[:10]), 400)
+        self.get('/rest/storage/' + '00' * 20 + '.json', 404)
+
+if __name__ == '__main__':
+    RESTContractsTest().main()
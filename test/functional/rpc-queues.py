@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 FA Enterprise system
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the limits of the RPC work queues and methods.
+
+Node 0 allows one waitfornewblock call at once (-rpcmethodlimit): a second
+one is rejected while the first waits, and accepted again once it returned.
+Node 1 serves long polls with one thread and a long-poll queue of depth one
+(-rpclongpollqueue): a third waitfornewblock call is rejected, while other
+calls, queued apart with their own -rpcworkqueue depth, still go through.
+"""
+
+from test_framework.test_framework import FabcoinTestFramework
+from test_framework.util import *
+
+import http.client
+import json
+import threading
+import urllib.parse
+
+RPC_MISC_ERROR = -1
+WAIT_TIMEOUT_MS = 60000
+
+class RPCQueuesTest(FabcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 2
+        self.extra_args = [["-rpcmethodlimit=waitfornewblock:1"],
+                           ["-rpclongpollthreads=1", "-rpclongpollqueue=1"]]
+
+    def wait_for_new_block(self, i, timeout, results):
+        """Call waitfornewblock on its own connection, in the background."""
+        proxy = get_rpc_proxy(self.nodes[i].url, i, timeout=WAIT_TIMEOUT_MS // 1000 + 30)
+        thread = threading.Thread(target=lambda: results.append(proxy.waitfornewblock(timeout)))
+        thread.start()
+        return thread
+
+    def queue_info(self, i, name):
+        return [q for q in self.nodes[i].getrpcqueueinfo()['queues'] if q['name'] == name][0]
+
+    def post(self, i, method, params):
+        url = urllib.parse.urlparse(self.nodes[i].url)
+        headers = {"Authorization": "Basic " + str_to_b64str(url.username + ':' + url.password)}
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.request('POST', '/', json.dumps({"method": method, "params": params, "id": 1}), headers)
+        response = conn.getresponse()
+        body = response.read()
+        conn.close()
+        return response.status, body
+
+    def run_test(self):
+        self.log.info("Method limit")
+        node = self.nodes[0]
+        assert_equal(node.getrpcqueueinfo()['methodlimits'], {"waitfornewblock": {"limit": 1, "running": 0}})
+        results = []
+        waiting = self.wait_for_new_block(0, WAIT_TIMEOUT_MS, results)
+        wait_until(lambda: node.getrpcqueueinfo()['methodlimits']['waitfornewblock']['running'] == 1, timeout=30)
+        assert_raises_rpc_error(RPC_MISC_ERROR, "Too many concurrent waitfornewblock calls", node.waitfornewblock, 1)
+        # Other methods aren't limited
+        node.getblockcount()
+
+        node.generate(1)
+        waiting.join()
+        assert_equal(results[0]['hash'], node.getbestblockhash())
+        wait_until(lambda: node.getrpcqueueinfo()['methodlimits']['waitfornewblock']['running'] == 0, timeout=30)
+        assert_equal(node.waitfornewblock(1)['hash'], node.getbestblockhash())
+        self.sync_all()
+
+        self.log.info("Long-poll queue depth")
+        node = self.nodes[1]
+        longpoll = self.queue_info(1, "long-poll")
+        assert_equal(longpoll['threads'], 1)
+        assert_equal(longpoll['maxdepth'], 1)
+        assert_equal(self.queue_info(1, "work")['maxdepth'], 16)
+
+        results = []
+        running = self.wait_for_new_block(1, WAIT_TIMEOUT_MS, results)
+        wait_until(lambda: self.queue_info(1, "long-poll")['processed'] == longpoll['processed'] + 1, timeout=30)
+        # Returns at once when its turn comes, after the running call
+        queued = self.wait_for_new_block(1, 1, results)
+        wait_until(lambda: self.queue_info(1, "long-poll")['depth'] == 1, timeout=30)
+
+        status, body = self.post(1, "waitfornewblock", [1])
+        assert_equal(status, 500)
+        assert(b"Work queue depth exceeded" in body)
+        assert_equal(self.queue_info(1, "long-poll")['rejected'], longpoll['rejected'] + 1)
+        # The general queue is unaffected
+        status, body = self.post(1, "getblockcount", [])
+        assert_equal(status, 200)
+        assert_equal(self.queue_info(1, "work")['rejected'], 0)
+
+        self.nodes[0].generate(1)
+        self.sync_all()
+        running.join()
+        queued.join()
+        assert_equal([result['hash'] for result in results], [node.getbestblockhash()] * 2)
+
+if __name__ == '__main__':
+    RPCQueuesTest().main()
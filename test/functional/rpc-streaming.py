@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 FA Enterprise system
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test results streamed in chunks by the RPC server.
+
+Results larger than one chunk (64 KiB) are sent with chunked transfer encoding.
+Check that such a reply is a complete JSON-RPC reply, with the same result as
+when it is produced inside a batch, which is never streamed, and that the
+count/from window of listtransactions is the same on both paths.
+"""
+
+from test_framework.test_framework import FabcoinTestFramework
+from test_framework.util import *
+
+from decimal import Decimal
+import http.client
+import json
+import urllib.parse
+
+JSON_STREAM_CHUNK_SIZE = 64 * 1024
+
+class RPCStreamingTest(FabcoinTestFramework):
+    def set_test_params(self):
+        self.num_nodes = 1
+
+    def call(self, method, params):
+        url = urllib.parse.urlparse(self.nodes[0].url)
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + str_to_b64str(authpair)}
+        conn = http.client.HTTPConnection(url.hostname, url.port)
+        conn.connect()
+        conn.request('POST', '/', json.dumps({"method": method, "params": params, "id": 1}), headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        chunked = response.getheader('Transfer-Encoding') == 'chunked'
+        body = response.read()
+        conn.close()
+        reply = json.loads(body.decode('utf-8'), parse_float=Decimal)
+        assert_equal(reply['error'], None)
+        assert_equal(reply['id'], 1)
+        return reply['result'], len(body), chunked
+
+    def batch(self, method, params):
+        reply = self.nodes[0]._batch([{"method": method, "params": params, "id": 1}])
+        assert_equal(reply[0]['error'], None)
+        return reply[0]['result']
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        # Enough wallet entries for listtransactions to span several chunks
+        address = node.getnewaddress()
+        for i in range(150):
+            node.sendtoaddress(address, 1)
+        node.generate(1)
+
+        self.log.info("Stream a result larger than one chunk")
+        streamed, size, chunked = self.call("listtransactions", ["*", 10000])
+        assert_greater_than(size, JSON_STREAM_CHUNK_SIZE)
+        assert(chunked)
+        assert_equal(streamed, self.batch("listtransactions", ["*", 10000]))
+
+        self.log.info("Check the count/from windows of a streamed listtransactions")
+        total = len(streamed)
+        for count, skip in [(1, 0), (10, 5), (37, 100), (total, 20), (10, total - 3), (10, total + 10), (total - 40, 40)]:
+            expected = streamed[max(0, total - skip - count):max(0, total - skip)]
+            result = self.call("listtransactions", ["*", count, skip])[0]
+            assert_equal(result, expected)
+            assert_equal(result, self.batch("listtransactions", ["*", count, skip]))
+
+        self.log.info("Send a result under one chunk as a whole")
+        result, size, chunked = self.call("listtransactions", ["*", 1])
+        assert_equal(len(result), 1)
+        assert(not chunked)
+
+if __name__ == '__main__':
+    RPCStreamingTest().main()
@@ -81,17 +81,21 @@ BASE_SCRIPTS= [
     # vv Tests less than 30s vv
     'keypool-topup.py',
     'zmq_test.py',
+    'zmq_receipts.py',
     'fabcoin_cli.py',
     'mempool_resurrect_test.py',
     'txn_doublespend.py --mineblock',
 
     'getchaintips.py',
     'rest.py',
+    'rest-contracts.py',
     'mempool_spendcoinbase.py',
     'mempool_reorg.py',
     'mempool_persist.py',
     'multiwallet.py',
     'httpbasics.py',
+    'rpc-streaming.py',
+    'rpc-queues.py',
     'multi_rpc.py',
     'proxy_test.py',
     'signrawtransactions.py',
@@ -169,6 +173,7 @@ EXTENDED_SCRIPTS = [
     'bip68-sequence.py',
     'getblocktemplate_longpoll.py',
     'p2p-timeouts.py',
+    'p2p-manyinbound.py',
     # Version <4 blocks are never allowed in regtest on fabcoin
     'bipdersig-p2p.py',
     'bip65-cltv-p2p.py',
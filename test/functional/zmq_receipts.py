@@ -0,0 +1,172 @@
+#!/usr/bin/env python3
+# Copyright (c) 2018 FA Enterprise system
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the receipt and contractlog ZMQ notifications.
+
+A contract is created, then called to emit two event logs. Each execution
+must be published as a receipt matching gettransactionreceipt, and each log
+as a contractlog, with the body layout of doc/zmq.md.
+"""
+import configparser
+import io
+import os
+import struct
+
+from test_framework.test_framework import FabcoinTestFramework, SkipTest
+from test_framework.fabcoinconfig import COINBASE_MATURITY
+from test_framework.mininode import deser_compact_size, deser_string
+from test_framework.util import (assert_equal,
+                                 bytes_to_hex_str,
+                                )
+
+# Stores 13 in slot 0 when created; 5b9af12b emits two logs with LOG_TOPIC.
+CONTRACT_CODE = "6060604052600d600055341561001457600080fd5b61017e806100236000396000f30060606040526004361061004c576000357c0100000000000000000000000000000000000000000000000000000000900463ffffffff168063027c1aaf1461004e5780635b9af12b14610058575b005b61005661008f565b005b341561006357600080fd5b61007960048080359060200190919050506100a1565b6040518082815260200191505060405180910390f35b60026000808282540292505081905550565b60007fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a17fc5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f282600054016000548460405180848152602001838152602001828152602001935050505060405180910390a1816000540160008190555060005490509190505600a165627a7a7230582015732bfa66bdede47ecc05446bf4c1e8ed047efac25478cb13b795887df70f290029"
+LOG_TOPIC = "c5c442325655248f6bccf5c6181738f8755524172cea2a8bd1e38e43f833e7f2"
+
+def read_hash(f):
+    # Block and transaction hashes come in serialization order
+    return bytes_to_hex_str(f.read(32)[::-1])
+
+def read_uint32(f):
+    return struct.unpack('<I', f.read(4))[0]
+
+def read_uint64(f):
+    return struct.unpack('<Q', f.read(8))[0]
+
+def read_log(f):
+    log = {'address': bytes_to_hex_str(f.read(20))}
+    log['topics'] = [bytes_to_hex_str(f.read(32)) for i in range(deser_compact_size(f))]
+    log['data'] = bytes_to_hex_str(deser_string(f))
+    return log
+
+def parse_receipt(body):
+    f = io.BytesIO(body)
+    receipt = {}
+    receipt['blockHash'] = read_hash(f)
+    receipt['blockNumber'] = read_uint32(f)
+    receipt['transactionHash'] = read_hash(f)
+    receipt['transactionIndex'] = read_uint32(f)
+    receipt['outputIndex'] = read_uint32(f)
+    receipt['from'] = bytes_to_hex_str(f.read(20))
+    receipt['to'] = bytes_to_hex_str(f.read(20))
+    receipt['contractAddress'] = bytes_to_hex_str(f.read(20))
+    receipt['cumulativeGasUsed'] = read_uint64(f)
+    receipt['gasUsed'] = read_uint64(f)
+    receipt['excepted'] = read_uint32(f)
+    receipt['stateRoot'] = bytes_to_hex_str(f.read(32))
+    receipt['utxoRoot'] = bytes_to_hex_str(f.read(32))
+    receipt['log'] = [read_log(f) for i in range(deser_compact_size(f))]
+    assert_equal(f.read(), b"")
+    return receipt
+
+def parse_contract_log(body):
+    f = io.BytesIO(body)
+    entry = {}
+    entry['blockHash'] = read_hash(f)
+    entry['blockNumber'] = read_uint32(f)
+    entry['transactionHash'] = read_hash(f)
+    entry['outputIndex'] = read_uint32(f)
+    entry['logIndex'] = read_uint32(f)
+    entry['log'] = read_log(f)
+    assert_equal(f.read(), b"")
+    return entry
+
+class ZMQReceiptsTest(FabcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def setup_nodes(self):
+        # Try to import python3-zmq. Skip this test if the import fails.
+        try:
+            import zmq
+        except ImportError:
+            raise SkipTest("python3-zmq module not available.")
+
+        # Check that fabcoin has been built with ZMQ enabled
+        config = configparser.ConfigParser()
+        if not self.options.configfile:
+            self.options.configfile = os.path.dirname(__file__) + "/../config.ini"
+        config.read_file(open(self.options.configfile))
+
+        if not config["components"].getboolean("ENABLE_ZMQ"):
+            raise SkipTest("fabcoind has not been built with zmq enabled.")
+
+        self.zmqContext = zmq.Context()
+        self.zmqSubSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqSubSocket.set(zmq.RCVTIMEO, 60000)
+        self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"receipt")
+        self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"contractlog")
+        ip_address = "tcp://127.0.0.1:28333"
+        self.zmqSubSocket.connect(ip_address)
+        self.extra_args = [['-logevents', '-zmqpubreceipt=%s' % ip_address, '-zmqpubcontractlog=%s' % ip_address]]
+        self.add_nodes(self.num_nodes, self.extra_args)
+        self.start_nodes()
+
+    def receive(self, count):
+        """The next count messages, by topic, with their sequence numbers."""
+        messages = {}
+        for i in range(count):
+            msg = self.zmqSubSocket.recv_multipart()
+            sequence = struct.unpack('<I', msg[-1])[-1]
+            messages.setdefault(msg[0], []).append((msg[1], sequence))
+        return messages
+
+    def check_receipt(self, body, txid):
+        receipt = parse_receipt(body)
+        expected = self.nodes[0].gettransactionreceipt(txid)[0]
+        for key in ['blockHash', 'blockNumber', 'transactionHash', 'transactionIndex', 'from', 'to',
+                    'contractAddress', 'cumulativeGasUsed', 'gasUsed', 'log']:
+            assert_equal(receipt[key], expected[key])
+        assert_equal(receipt['excepted'], 0)
+        assert_equal(receipt['outputIndex'], 0)
+        return receipt
+
+    def run_test(self):
+        try:
+            self._zmq_test()
+        finally:
+            # Destroy the zmq context
+            self.log.debug("Destroying zmq context")
+            self.zmqContext.destroy(linger=None)
+
+    def _zmq_test(self):
+        node = self.nodes[0]
+        node.generate(COINBASE_MATURITY + 100)
+
+        self.log.info("Receipt of a contract creation")
+        created = node.createcontract(CONTRACT_CODE)
+        node.generate(1)
+        messages = self.receive(1)
+        assert_equal(list(messages.keys()), [b"receipt"])
+        body, sequence = messages[b"receipt"][0]
+        assert_equal(sequence, 0)
+        receipt = self.check_receipt(body, created['txid'])
+        assert_equal(receipt['contractAddress'], created['address'])
+        assert_equal(receipt['log'], [])
+
+        self.log.info("Receipt and logs of a contract call")
+        txid = node.sendtocontract(created['address'], "5b9af12b")['txid']
+        blockhash = node.generate(1)[0]
+        messages = self.receive(3)
+        assert_equal(len(messages[b"receipt"]), 1)
+        body, sequence = messages[b"receipt"][0]
+        assert_equal(sequence, 1)
+        receipt = self.check_receipt(body, txid)
+        assert_equal(len(receipt['log']), 2)
+
+        assert_equal(len(messages[b"contractlog"]), 2)
+        for i, (body, sequence) in enumerate(messages[b"contractlog"]):
+            assert_equal(sequence, i)
+            entry = parse_contract_log(body)
+            assert_equal(entry['blockHash'], blockhash)
+            assert_equal(entry['blockNumber'], node.getblockcount())
+            assert_equal(entry['transactionHash'], txid)
+            assert_equal(entry['outputIndex'], 0)
+            assert_equal(entry['logIndex'], i)
+            assert_equal(entry['log'], receipt['log'][i])
+            assert_equal(entry['log']['topics'][0], LOG_TOPIC)
+
+if __name__ == '__main__':
+    ZMQReceiptsTest().main()